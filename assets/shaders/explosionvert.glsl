@@ -2,8 +2,14 @@
 
 layout(location = 0) in vec4 pos;
 
-uniform mat4 persp;
-uniform mat4 view;
+//Camera and lighting of the frame (see gfx::updateFrameData)
+layout (std140) uniform FrameData {
+	mat4 persp;
+	mat4 view;
+	vec3 camerapos;
+	vec3 lightdir;
+};
+
 uniform mat4 transform;
 uniform float time;
 uniform float scale;
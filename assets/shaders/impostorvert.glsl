@@ -0,0 +1,40 @@
+#version 330 core
+
+/*
+	A vertex shader for tree impostors, the lighting is already baked into
+	the impostor texture so it is not applied again here and the trees are
+	too far away for the wind animation to be noticeable
+*/
+
+layout(location = 0) in vec4 pos;
+layout(location = 1) in vec2 texcoord;
+layout(location = 2) in vec3 norm;
+layout(location = 3) in vec3 offset;
+
+//Camera and lighting of the frame (see gfx::updateFrameData)
+layout (std140) uniform FrameData {
+	mat4 persp;
+	mat4 view;
+	vec3 camerapos;
+	vec3 lightdir;
+};
+
+uniform mat4 transform;
+
+out float lighting;
+
+out vec3 fragpos;
+out vec3 normal;
+
+out vec2 tc;
+
+void main()
+{
+	vec4 transformed = transform * pos;
+	transformed += vec4(offset, 0.0);
+	gl_Position = persp * view * transformed;
+	fragpos = transformed.xyz;
+	lighting = 1.0;
+	tc = texcoord;
+	normal = norm;
+}
@@ -6,11 +6,16 @@ layout(location = 1) in vec3 norm;
 uniform int range;
 uniform float scale;
 
-uniform mat4 persp;
-uniform mat4 view;
+//Camera and lighting of the frame (see gfx::updateFrameData)
+layout (std140) uniform FrameData {
+	mat4 persp;
+	mat4 view;
+	vec3 camerapos;
+	vec3 lightdir;
+};
+
 uniform mat4 transform;
 
-uniform vec3 lightdir;
 out float lighting;
 
 out vec3 fragpos;
@@ -2,14 +2,20 @@
 
 layout(location = 0) in vec4 pos;
 
-uniform mat4 persp;
-uniform mat4 view;
+//Camera and lighting of the frame (see gfx::updateFrameData)
+layout (std140) uniform FrameData {
+	mat4 persp;
+	mat4 view;
+	vec3 camerapos;
+	vec3 lightdir;
+};
 
 out vec3 fragpos;
 
 void main()
 {
-	vec4 p = persp * view * pos;
+	//The skybox does not move with the camera
+	vec4 p = persp * mat4(mat3(view)) * pos;
 	gl_Position = p.xyww;
 	fragpos = pos.xyz;
 }
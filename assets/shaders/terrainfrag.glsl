@@ -4,6 +4,14 @@ layout (std140) uniform GlobalVals {
 	float viewdist;
 };
 
+//Camera and lighting of the frame (see gfx::updateFrameData)
+layout (std140) uniform FrameData {
+	mat4 persp;
+	mat4 view;
+	vec3 camerapos;
+	vec3 lightdir;
+};
+
 out vec4 color;
 
 in float lighting;
@@ -11,15 +19,14 @@ in float height;
 in vec3 fragpos;
 
 uniform float time;
-uniform vec3 lightdir;
-uniform vec3 camerapos;
 
 uniform sampler2D terraintexture;
 
 const float FOG_DIST = 10000.0;
 const float WATER_FOG_DIST = 128.0;
 
-uniform vec2 center;
+//Each level of detail is only drawn where the distance from the camera
+//is in [minrange, maxrange), a negative maxrange has no upper limit
 uniform float minrange;
 uniform float maxrange;
 uniform vec3 testcolor;
@@ -73,10 +80,10 @@ void main()
 {
 	float d = length(fragpos - camerapos);
 
-	float range = max(abs(fragpos.x - center.x), abs(fragpos.z - center.y));
-	//We discard fragments that are beyond a certain range to prevent overlap
-	//with terrain of lower level of detail
-	if((range > maxrange && maxrange > 0.0) || range < minrange)
+	float range = max(abs(fragpos.x - camerapos.x), abs(fragpos.z - camerapos.z));
+	//The ranges of neighbouring levels of detail meet exactly so that
+	//each part of the terrain is only drawn once
+	if((range >= maxrange && maxrange > 0.0) || range < minrange)
 		discard;
 
 	color = getcolor() * lighting;
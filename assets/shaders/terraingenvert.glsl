@@ -0,0 +1,158 @@
+#version 330 core
+
+//Generates the vertices of a chunk, one vertex per invocation, the output
+//is captured with transform feedback. This follows
+//infworld::sampleChunkHeights and infworld::createChunkElementArray
+
+//Permutation tables for every octave, 256 values each
+uniform isamplerBuffer permutations;
+uniform int octaves;
+uniform int prec;
+uniform float frequency;
+uniform ivec2 chunkpos;
+uniform float chunkscale;
+uniform float maxheight;
+
+//Same layout as infworld::ChunkVertex
+flat out uint vertexdata;
+
+const vec2 GRADIENTS[4] = vec2[4](
+	vec2(1.0, 0.0),
+	vec2(-1.0, 0.0),
+	vec2(0.0, 1.0),
+	vec2(0.0, -1.0)
+);
+
+int permutation(int octave, uint i)
+{
+	return texelFetch(permutations, octave * 256 + int(i % 256u)).x;
+}
+
+//See perlin::gradient
+vec2 gradient(int x, int y, int octave)
+{
+	uint a = uint(x), b = uint(y);
+	a *= 3284157443u;
+	b ^= a << 16u | a >> 16u;
+	b *= 1911520717u;
+	a ^= b << 16u | b >> 16u;
+	a *= 2048419325u;
+
+	int index = permutation(octave, uint(permutation(octave, uint(permutation(octave, a)) + b)));
+	return GRADIENTS[index % 4];
+}
+
+float smoothcurve(float x)
+{
+	return (3.0 - x * 2.0) * x * x;
+}
+
+float smoothcurveslope(float x)
+{
+	return 6.0 * x * (1.0 - x);
+}
+
+//See perlin::noiseWithDerivative, returns the noise value and the
+//partial derivatives
+vec3 noise(vec2 p, int octave)
+{
+	ivec2 lower = ivec2(floor(p));
+	vec2
+		lowerleftgrad = gradient(lower.x, lower.y, octave),
+		lowerrightgrad = gradient(lower.x + 1, lower.y, octave),
+		upperleftgrad = gradient(lower.x, lower.y + 1, octave),
+		upperrightgrad = gradient(lower.x + 1, lower.y + 1, octave);
+	vec2 d = p - vec2(lower);
+	float
+		lowerleft = dot(lowerleftgrad, d),
+		lowerright = dot(lowerrightgrad, d - vec2(1.0, 0.0)),
+		upperleft = dot(upperleftgrad, d - vec2(0.0, 1.0)),
+		upperright = dot(upperrightgrad, d - vec2(1.0, 1.0));
+	float su = smoothcurve(d.x), sv = smoothcurve(d.y);
+	float
+		lerpedlower = (lowerright - lowerleft) * su + lowerleft,
+		lerpedupper = (upperright - upperleft) * su + upperleft;
+	float value = (lerpedupper - lerpedlower) * sv + lerpedlower;
+
+	vec2
+		lowergrad = lowerleftgrad + (lowerrightgrad - lowerleftgrad) * su,
+		uppergrad = upperleftgrad + (upperrightgrad - upperleftgrad) * su;
+	lowergrad.x += (lowerright - lowerleft) * smoothcurveslope(d.x);
+	uppergrad.x += (upperright - upperleft) * smoothcurveslope(d.x);
+	vec2 grad = lowergrad + (uppergrad - lowergrad) * sv;
+	grad.y += (lerpedupper - lerpedlower) * smoothcurveslope(d.y);
+	return vec3(value, grad);
+}
+
+//See infworld::remapHeight and infworld::remapHeightSlope, returns the
+//remapped height and the slope of the remapping
+vec2 remap(float height)
+{
+	vec4 section;
+	if(height < -0.1)
+		section = vec4(-1.0, -0.1, -1.0, 0.003);
+	else if(height < 0.0)
+		section = vec4(-0.1, 0.0, 0.003, 0.03);
+	else if(height < 0.15)
+		section = vec4(0.0, 0.15, 0.03, 0.12);
+	else
+		section = vec4(0.15, 1.0, 0.12, 1.0);
+	float slope = (section.w - section.z) / (section.y - section.x);
+	return vec2((height - section.x) * slope + section.z, slope);
+}
+
+//See gfx::octahedralEncode
+vec2 octahedralencode(vec3 n)
+{
+	n /= abs(n.x) + abs(n.y) + abs(n.z);
+	if(n.y < 0.0) {
+		return (1.0 - abs(n.zx)) * vec2(
+			n.x >= 0.0 ? 1.0 : -1.0,
+			n.z >= 0.0 ? 1.0 : -1.0
+		);
+	}
+	return n.xz;
+}
+
+void main()
+{
+	int i = gl_VertexID / (prec + 1), j = gl_VertexID % (prec + 1);
+	float spacing = chunkscale * 2.0 / float(prec);
+	vec2 p = vec2(
+		float(chunkpos.x * prec - prec / 2 + i),
+		float(chunkpos.y * prec - prec / 2 + j)
+	) * spacing;
+
+	float height = 0.0;
+	vec2 derivative = vec2(0.0);
+	float freq = frequency;
+	float amplitude = 1.0;
+	for(int octave = 0; octave < octaves; octave++) {
+		vec3 n = noise(p / freq, octave);
+		height += n.x * amplitude;
+		derivative += n.yz * (amplitude / freq);
+		freq /= 2.0;
+		amplitude /= 2.0;
+	}
+	vec2 remapped = remap(height);
+	height = remapped.x;
+	derivative *= remapped.y;
+
+	//See infworld::terrainHeight, terrain that gets pushed away from the
+	//water level is flat
+	float h = height * maxheight;
+	if(h <= 0.0)
+		h = min(-0.007, h);
+	else
+		h = max(0.007, h);
+	vec2 slope = derivative * maxheight;
+	if(h != height * maxheight)
+		slope = vec2(0.0);
+	vec3 normal = normalize(vec3(-slope.x, 1.0, -slope.y));
+
+	//See infworld::packChunkVertex
+	int quantized = int(round(clamp(h / maxheight, -1.0, 1.0) * 32767.0));
+	vec2 n = octahedralencode(normal) * 0.5 + 0.5;
+	uint nx = uint(round(n.x * 255.0)), nz = uint(round(n.y * 255.0));
+	vertexdata = (uint(quantized) & 0xffffu) | (nx << 16u) | (nz << 24u);
+}
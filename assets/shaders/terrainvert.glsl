@@ -1,34 +1,106 @@
 #version 330 core
 
-layout(location = 0) in float y;
-layout(location = 1) in vec2 norm;
+//Lower 16 bits are the height, upper 16 bits are the octahedral
+//encoded normal (see infworld::ChunkVertex)
+layout(location = 0) in uint vertexdata;
+
+//Camera and lighting of the frame (see gfx::updateFrameData)
+layout (std140) uniform FrameData {
+	mat4 persp;
+	mat4 view;
+	vec3 camerapos;
+	vec3 lightdir;
+};
 
-uniform mat4 persp;
-uniform mat4 view;
 uniform mat4 transform;
 
-uniform vec3 lightdir;
 uniform float maxheight;
 uniform float chunksz;
 uniform int prec;
+//Position of each chunk in chunk coordinates
+uniform isamplerBuffer chunkpositions;
+//The same data as vertexdata, used to read the neighbouring vertices
+uniform usamplerBuffer chunkvertices;
+//Vertices start morphing towards the next level of detail at morphstart
+//and are fully morphed at morphend (distances from the camera), set
+//morphend to a negative value to disable morphing
+uniform float morphstart;
+uniform float morphend;
 
 out float lighting;
 out float height;
 out vec3 fragpos;
 
+float decodeheight(uint data)
+{
+	//Sign extend the height
+	return float(int(data << 16u) >> 16) / 32767.0;
+}
+
+vec3 decodenormal(uint data)
+{
+	vec2 octnorm = vec2(
+		float((data >> 16u) & 0xffu),
+		float(data >> 24u)
+	) / 255.0 * 2.0 - 1.0;
+	vec3 normal = vec3(octnorm.x, 1.0 - abs(octnorm.x) - abs(octnorm.y), octnorm.y);
+	if(normal.y < 0.0) {
+		normal.xz = (1.0 - abs(normal.zx)) * vec2(
+			normal.x >= 0.0 ? 1.0 : -1.0,
+			normal.z >= 0.0 ? 1.0 : -1.0
+		);
+	}
+	return normalize(normal);
+}
+
 void main()
 {
-	int ix = gl_VertexID - int(gl_VertexID / (prec + 1)) * (prec + 1);
-	int iz = int(gl_VertexID / (prec + 1));
+	//Every chunk is stored in the same buffer so gl_VertexID includes
+	//the offset of the chunk
+	int vertex = gl_VertexID % ((prec + 1) * (prec + 1));
+	int chunk = gl_VertexID / ((prec + 1) * (prec + 1));
+	int ix = vertex - int(vertex / (prec + 1)) * (prec + 1);
+	int iz = int(vertex / (prec + 1));
+
+	float y = decodeheight(vertexdata);
+	vec3 normal = decodenormal(vertexdata);
 
 	float halfinc = chunksz / float(prec + 1);
 	float vx = -chunksz + float(ix) / float(prec + 1) * 2.0 * chunksz + halfinc;
 	float vz = -chunksz + float(iz) / float(prec + 1) * 2.0 * chunksz + halfinc;
-	vec4 pos = vec4(vx, y * maxheight, vz, 1.0);
-	height = pos.y / maxheight;
+	ivec2 chunkpos = texelFetch(chunkpositions, chunk).xy;
+	vec2 offset = vec2(chunkpos.y, chunkpos.x) * chunksz * 2.0 * float(prec) / float(prec + 1);
+	vec4 pos = vec4(vx + offset.x, 0.0, vz + offset.y, 1.0);
+
+	//The next level of detail only has the vertices where ix and iz are
+	//both even, the other vertices lie on one of its edges or on the
+	//diagonal of one of its quads (see generateChunkIndices) so they are
+	//morphed to the midpoint of that edge. Odd vertices are never on the
+	//edge of a chunk so both of their neighbours are in the same chunk.
+	vec3 worldpos = (transform * pos).xyz;
+	float range = max(abs(worldpos.x - camerapos.x), abs(worldpos.z - camerapos.z));
+	float morph = clamp((range - morphstart) / (morphend - morphstart), 0.0, 1.0);
+	bool oddx = ix % 2 == 1, oddz = iz % 2 == 1;
+	if(morphend > 0.0 && (oddx || oddz)) {
+		int neighbour;
+		if(oddx && oddz)
+			neighbour = prec;
+		else if(oddx)
+			neighbour = 1;
+		else
+			neighbour = prec + 1;
+		uint a = texelFetch(chunkvertices, gl_VertexID + neighbour).x;
+		uint b = texelFetch(chunkvertices, gl_VertexID - neighbour).x;
+		float coarsey = (decodeheight(a) + decodeheight(b)) * 0.5;
+		vec3 coarsenormal = normalize(decodenormal(a) + decodenormal(b));
+		y = mix(y, coarsey, morph);
+		normal = normalize(mix(normal, coarsenormal, morph));
+	}
+
+	pos.y = y * maxheight;
+	height = y;
 	gl_Position = persp * view * transform * pos;
 	fragpos = (transform * pos).xyz;
 
-	vec3 normal = vec3(cos(norm.y) * cos(norm.x), sin(norm.y), cos(norm.y) * sin(norm.x));
 	lighting = max(-dot(lightdir, normal), 0.0) * 0.6 + 0.4;
 }
@@ -4,6 +4,14 @@ layout (std140) uniform GlobalVals {
 	float viewdist;
 };
 
+//Camera and lighting of the frame (see gfx::updateFrameData)
+layout (std140) uniform FrameData {
+	mat4 persp;
+	mat4 view;
+	vec3 camerapos;
+	vec3 lightdir;
+};
+
 uniform sampler2D tex;
 
 out vec4 color;
@@ -13,8 +21,6 @@ in vec3 normal;
 
 in vec3 fragpos;
 
-uniform vec3 camerapos;
-uniform vec3 lightdir;
 //How strong the specular effect is
 uniform float specularfactor;
 
@@ -39,7 +45,7 @@ void main()
 
 	//Specular lighting
 	vec3 reflected = normalize(reflect(lightdir, normal));
-	float spec = pow(dot(reflected, normalize(camerapos - fragpos)), 16.0) * specularfactor;
+	float spec = pow(max(dot(reflected, normalize(camerapos - fragpos)), 0.0), 16.0) * specularfactor;
 	color += vec4(1.0, 1.0, 1.0, 0.0) * spec;
 	color = clamp(color, 0.0, 1.0);
 
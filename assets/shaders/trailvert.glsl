@@ -3,16 +3,24 @@
 layout(location = 0) in vec4 pos;
 layout(location = 1) in vec2 texcoord;
 layout(location = 2) in vec3 norm;
+//Per bullet values (see gfx::InstanceData), each bullet is drawn
+//TRAIL_LENGTH times to make the trail
+layout(location = 4) in mat4 transform;
+layout(location = 8) in mat3 normalmat;
+//velocity (xyz) and time (w)
+layout(location = 11) in vec4 trail;
 
-uniform float time;
-uniform vec3 velocity;
+//Must be the same as TRAIL_LENGTH in game.hpp
+const int TRAIL_LENGTH = 32;
 
-uniform mat4 persp;
-uniform mat4 view;
-uniform mat4 transform;
-uniform mat3 normalmat;
+//Camera and lighting of the frame (see gfx::updateFrameData)
+layout (std140) uniform FrameData {
+	mat4 persp;
+	mat4 view;
+	vec3 camerapos;
+	vec3 lightdir;
+};
 
-uniform vec3 lightdir;
 out float lighting;
 
 out vec3 fragpos;
@@ -21,7 +29,9 @@ out vec3 normal;
 
 void main()
 {
-	float t = min(0.003 * gl_InstanceID, time);
+	float time = trail.w;
+	vec3 velocity = trail.xyz;
+	float t = min(0.003 * float(gl_InstanceID % TRAIL_LENGTH), time);
 	vec4 transformed = pos;
 	transformed *= 1.0 / (1.0 + 40.0 * t);
 	transformed.w = 1.0;
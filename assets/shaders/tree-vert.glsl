@@ -12,13 +12,18 @@ layout(location = 3) in vec3 offset;
 
 uniform float time;
 
-uniform mat4 persp;
-uniform mat4 view;
+//Camera and lighting of the frame (see gfx::updateFrameData)
+layout (std140) uniform FrameData {
+	mat4 persp;
+	mat4 view;
+	vec3 camerapos;
+	vec3 lightdir;
+};
+
 uniform mat4 transform;
 
 uniform float windstrength;
 
-uniform vec3 lightdir;
 out float lighting;
 
 out vec3 fragpos;
@@ -3,13 +3,18 @@
 layout(location = 0) in vec4 pos;
 layout(location = 1) in vec2 texcoord;
 layout(location = 2) in vec3 norm;
+//Per instance values (see gfx::InstanceData)
+layout(location = 4) in mat4 transform;
+layout(location = 8) in mat3 normalmat;
 
-uniform mat4 persp;
-uniform mat4 view;
-uniform mat4 transform;
-uniform mat3 normalmat;
+//Camera and lighting of the frame (see gfx::updateFrameData)
+layout (std140) uniform FrameData {
+	mat4 persp;
+	mat4 view;
+	vec3 camerapos;
+	vec3 lightdir;
+};
 
-uniform vec3 lightdir;
 out float lighting;
 
 out vec3 fragpos;
@@ -4,6 +4,14 @@ layout (std140) uniform GlobalVals {
 	float viewdist;
 };
 
+//Camera and lighting of the frame (see gfx::updateFrameData)
+layout (std140) uniform FrameData {
+	mat4 persp;
+	mat4 view;
+	vec3 camerapos;
+	vec3 lightdir;
+};
+
 out vec4 color;
 
 in vec3 fragpos;
@@ -16,8 +24,6 @@ in vec3 fragpos;
 uniform sampler2D watermaps;
 
 uniform float time;
-uniform vec3 lightdir;
-uniform vec3 camerapos;
 
 const float FOG_DIST = 10000.0;
 const float WATER_FOG_DIST = 128.0;
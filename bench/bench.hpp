@@ -0,0 +1,86 @@
+/*
+ * Helper functions shared by the benchmarks
+ * */
+
+#pragma once
+
+#include "../src/infworld.hpp"
+#include "../src/jobsystem.hpp"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <vector>
+
+//Same values as the ones used by the game (see game.hpp)
+constexpr unsigned int MAX_LOD = 5;
+constexpr float LOD_SCALE = 2.0f;
+constexpr unsigned int RANGE = 4;
+constexpr unsigned int CHUNK_UPLOAD_BUDGET = 4;
+
+struct Result {
+	std::string name;
+	int seed;
+	unsigned int threads;
+	size_t items;
+	double seconds;
+	//Sum of the output so that runs can be compared with each other
+	double checksum;
+	//Any other values that should be reported
+	std::vector<std::pair<std::string, double>> extra;
+};
+
+//Runs func `repeat` times and returns the fastest time in seconds
+inline double timeBest(unsigned int repeat, const std::function<void()> &func)
+{
+	double best = -1.0;
+	for(unsigned int i = 0; i < repeat; i++) {
+		auto starttime = std::chrono::steady_clock::now();
+		func();
+		auto endtime = std::chrono::steady_clock::now();
+		std::chrono::duration<double> duration = endtime - starttime;
+		if(best < 0.0 || duration.count() < best)
+			best = duration.count();
+	}
+	return best;
+}
+
+inline std::vector<int> parseList(const char *str)
+{
+	std::vector<int> values;
+	std::string s = str;
+	size_t start = 0;
+	while(start < s.size()) {
+		size_t end = s.find(',', start);
+		if(end == std::string::npos)
+			end = s.size();
+		values.push_back(atoi(s.substr(start, end - start).c_str()));
+		start = end + 1;
+	}
+	return values;
+}
+
+inline void printResults(const std::vector<Result> &results)
+{
+	printf("{\n");
+	printf("\t\"hardware_threads\": %u,\n", std::thread::hardware_concurrency());
+	printf("\t\"results\": [\n");
+	for(size_t i = 0; i < results.size(); i++) {
+		const Result &r = results.at(i);
+		printf("\t\t{ ");
+		printf("\"name\": \"%s\", ", r.name.c_str());
+		printf("\"seed\": %d, ", r.seed);
+		printf("\"threads\": %u, ", r.threads);
+		printf("\"items\": %zu, ", r.items);
+		printf("\"seconds\": %.9f, ", r.seconds);
+		printf("\"items_per_second\": %.3f, ", double(r.items) / r.seconds);
+		printf("\"checksum\": %.9g", r.checksum);
+		for(const auto &value : r.extra)
+			printf(", \"%s\": %.9g", value.first.c_str(), value.second);
+		printf(" }%s\n", i + 1 < results.size() ? "," : "");
+	}
+	printf("\t]\n");
+	printf("}\n");
+}
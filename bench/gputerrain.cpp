@@ -0,0 +1,203 @@
+/*
+ * Checks that the chunks generated on the GPU by infworld::GPUChunkGenerator
+ * match the chunks built on the CPU and compares how long each takes. This
+ * needs an OpenGL context and opens a hidden window, on a machine without a
+ * GPU it can be run with software rendering (Mesa llvmpipe):
+ *
+ * LIBGL_ALWAYS_SOFTWARE=1 xvfb-run -a ./gputerrain
+ *
+ * The program exits with 1 if the chunks do not match.
+ *
+ * usage: ./gputerrain [-s seed,seed,...]
+ * */
+
+#include "bench.hpp"
+#include <GLFW/glfw3.h>
+#include <math.h>
+
+//Heights may be off by a few steps of the packed format (maxheight / 32767)
+constexpr int HEIGHT_TOLERANCE = 4;
+//Normals may be off by a few degrees
+constexpr float NORMAL_TOLERANCE = 3.0f;
+//Normals change abruptly where the terrain is flattened near the water and
+//where infworld::remapHeight changes slope, a sample right on one of those
+//edges can land on a different side on the GPU so a small fraction of the
+//normals is allowed to be outside of the tolerance
+constexpr double MAX_NORMAL_OUTLIERS = 0.001;
+
+int unpackHeight(infworld::ChunkVertex v)
+{
+	return int16_t(v & 0xffff);
+}
+
+glm::vec3 unpackNormal(infworld::ChunkVertex v)
+{
+	glm::vec2 e = glm::vec2(float((v >> 16) & 0xff), float(v >> 24)) / 255.0f * 2.0f - 1.0f;
+	glm::vec3 n(e.x, 1.0f - fabsf(e.x) - fabsf(e.y), e.y);
+	if(n.y < 0.0f) {
+		n = glm::vec3(
+			(1.0f - fabsf(e.y)) * (e.x >= 0.0f ? 1.0f : -1.0f),
+			n.y,
+			(1.0f - fabsf(e.x)) * (e.y >= 0.0f ? 1.0f : -1.0f)
+		);
+	}
+	return glm::normalize(n);
+}
+
+Result checkSeed(int seed, const infworld::worldseed &permutations)
+{
+	unsigned int size = 2 * RANGE + 1;
+	unsigned int count = size * size * MAX_LOD;
+	std::vector<infworld::ChunkPos> positions;
+	std::vector<float> scales;
+	float scale = CHUNK_SZ;
+	for(unsigned int lod = 0; lod < MAX_LOD; lod++) {
+		for(int x = -int(RANGE); x <= int(RANGE); x++) {
+			for(int z = -int(RANGE); z <= int(RANGE); z++) {
+				positions.push_back({ x, z });
+				scales.push_back(scale);
+			}
+		}
+		scale *= LOD_SCALE;
+	}
+
+	//CPU
+	std::vector<infworld::ChunkVertex> cpuvertices;
+	cpuvertices.reserve(count * CHUNK_VERTICES);
+	auto starttime = std::chrono::steady_clock::now();
+	for(unsigned int i = 0; i < count; i++) {
+		mesh::ElementArrayBuffer<infworld::ChunkVertex> chunk = infworld::createChunkElementArray(
+			permutations,
+			positions[i].x,
+			positions[i].z,
+			HEIGHT,
+			scales[i]
+		);
+		const auto &vertices = chunk.mesh.vertices;
+		cpuvertices.insert(cpuvertices.end(), vertices.begin(), vertices.end());
+	}
+	auto endtime = std::chrono::steady_clock::now();
+	std::chrono::duration<double> cputime = endtime - starttime;
+
+	//GPU
+	infworld::GPUChunkGenerator generator(permutations, "../assets/shaders/terraingenvert.glsl");
+	unsigned int buffer;
+	glGenBuffers(1, &buffer);
+	glBindBuffer(GL_ARRAY_BUFFER, buffer);
+	glBufferData(
+		GL_ARRAY_BUFFER,
+		count * CHUNK_VERTICES * infworld::CHUNK_VERT_SZ_BYTES,
+		nullptr,
+		GL_DYNAMIC_DRAW
+	);
+	//Run once so that the shader is ready before timing
+	generator.generate(buffer, 0, positions[0], scales[0], HEIGHT);
+	glFinish();
+	starttime = std::chrono::steady_clock::now();
+	for(unsigned int i = 0; i < count; i++) {
+		generator.generate(
+			buffer,
+			i * CHUNK_VERTICES * infworld::CHUNK_VERT_SZ_BYTES,
+			positions[i],
+			scales[i],
+			HEIGHT
+		);
+	}
+	glFinish();
+	endtime = std::chrono::steady_clock::now();
+	std::chrono::duration<double> gputime = endtime - starttime;
+
+	std::vector<infworld::ChunkVertex> gpuvertices(count * CHUNK_VERTICES);
+	glBindBuffer(GL_ARRAY_BUFFER, buffer);
+	glGetBufferSubData(
+		GL_ARRAY_BUFFER,
+		0,
+		gpuvertices.size() * infworld::CHUNK_VERT_SZ_BYTES,
+		&gpuvertices[0]
+	);
+	glDeleteBuffers(1, &buffer);
+
+	//Compare
+	int maxheighterror = 0;
+	float maxnormalerror = 0.0f;
+	size_t normaloutliers = 0;
+	double checksum = 0.0;
+	for(size_t i = 0; i < gpuvertices.size(); i++) {
+		int cpuheight = unpackHeight(cpuvertices[i]), gpuheight = unpackHeight(gpuvertices[i]);
+		maxheighterror = std::max(maxheighterror, abs(cpuheight - gpuheight));
+		checksum += gpuheight;
+
+		float d = glm::dot(unpackNormal(cpuvertices[i]), unpackNormal(gpuvertices[i]));
+		float angle = acosf(std::min(d, 1.0f)) * 180.0f / M_PI;
+		if(angle > NORMAL_TOLERANCE)
+			normaloutliers++;
+		else
+			maxnormalerror = std::max(maxnormalerror, angle);
+	}
+	double outlierfraction = double(normaloutliers) / double(gpuvertices.size());
+	bool consistent =
+		maxheighterror <= HEIGHT_TOLERANCE &&
+		outlierfraction <= MAX_NORMAL_OUTLIERS;
+
+	Result result = {
+		"infworld::GPUChunkGenerator::generate",
+		seed,
+		1,
+		count,
+		gputime.count(),
+		checksum
+	};
+	result.extra = {
+		{ "cpu_seconds", cputime.count() },
+		{ "max_height_error", double(maxheighterror) * HEIGHT / 32767.0 },
+		{ "max_normal_error_degrees", maxnormalerror },
+		{ "normal_outliers", double(normaloutliers) },
+		{ "consistent", consistent ? 1.0 : 0.0 },
+	};
+	return result;
+}
+
+int main(int argc, char **argv)
+{
+	std::vector<int> seeds = { 1, 2, 3 };
+
+	for(int i = 1; i < argc; i++) {
+		if(strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+			seeds = parseList(argv[++i]);
+		else {
+			fprintf(stderr, "usage: %s [-s seeds]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	if(!glfwInit()) {
+		fprintf(stderr, "Failed to init glfw!\n");
+		return 1;
+	}
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	GLFWwindow *window = glfwCreateWindow(64, 64, "gputerrain", nullptr, nullptr);
+	if(!window) {
+		fprintf(stderr, "Failed to create an OpenGL context!\n");
+		glfwTerminate();
+		return 1;
+	}
+	glfwMakeContextCurrent(window);
+	if(!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+		fprintf(stderr, "Failed to init glad!\n");
+		glfwTerminate();
+		return 1;
+	}
+
+	std::vector<Result> results;
+	bool consistent = true;
+	for(int seed : seeds) {
+		infworld::worldseed permutations = infworld::makePermutations(seed, 9);
+		results.push_back(checkSeed(seed, permutations));
+		consistent = consistent && results.back().extra.back().second != 0.0;
+	}
+	printResults(results);
+
+	glfwDestroyWindow(window);
+	glfwTerminate();
+	return consistent ? 0 : 1;
+}
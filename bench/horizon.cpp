@@ -0,0 +1,267 @@
+/*
+ * Checks that infworld::HorizonMap never hides a box that can be seen and
+ * measures how many boxes it hides. Random boxes are placed on the terrain
+ * around a few cameras and every box that is reported as occluded is
+ * checked by marching rays from points on its top to several positions
+ * the camera can move to before the map is rebuilt. The rays are tested
+ * against the lowest vertex near each point of the chunk that is drawn
+ * there, so a box only counts as hidden if the terrain that is actually
+ * drawn hides it. This does not open a window.
+ *
+ * The program exits with 1 if a visible box is reported as occluded.
+ *
+ * usage: ./horizon [-s seed,seed,...] [-c cameras] [-b boxes]
+ * */
+
+#include "bench.hpp"
+#include <math.h>
+#include <limits>
+
+//Same as ZFAR in game.hpp
+constexpr float HORIZON_MAXDIST = 20000.0f;
+//Points sampled along each side of the top of a box
+constexpr int BOX_SAMPLES = 5;
+
+//Keeps the height of every vertex of the chunk in each slot
+class HeightRecordingBackend : public infworld::ChunkBackend {
+public:
+	std::vector<infworld::ChunkPos> slots;
+	std::vector<std::vector<float>> heights;
+
+	void init(unsigned int count)
+	{
+		slots = std::vector<infworld::ChunkPos>(count);
+		heights = std::vector<std::vector<float>>(count);
+	}
+
+	void destroy()
+	{
+		slots.clear();
+		heights.clear();
+	}
+
+	void addChunk(unsigned int index, const infworld::ChunkData &chunk)
+	{
+		slots.at(index) = chunk.position;
+		std::vector<float> &h = heights.at(index);
+		h.clear();
+		//Decoded the same way as in the terrain shader
+		for(infworld::ChunkVertex v : chunk.chunkmesh.mesh.vertices)
+			h.push_back(float(int16_t(v & 0xffff)) / 32767.0f * HEIGHT * SCALE);
+	}
+
+	void updateChunk(unsigned int index, const infworld::ChunkData &chunk)
+	{
+		addChunk(index, chunk);
+	}
+
+	void draw(ShaderProgram &shader, const std::vector<unsigned int> &visible) {}
+};
+
+struct Terrain {
+	infworld::ChunkTable chunktables[MAX_LOD];
+	std::shared_ptr<HeightRecordingBackend> backends[MAX_LOD];
+};
+
+//Lowest height that the drawn terrain can have at a point as seen from
+//`eye`, the vertices are morphed towards their neighbours so the vertices
+//around the quad are included. Returns -infinity if nothing is drawn.
+float drawnHeight(Terrain &terrain, float x, float z, const glm::vec3 &eye)
+{
+	float range = std::max(fabsf(x - eye.x), fabsf(z - eye.z));
+	unsigned int lod = 0;
+	while(lod < MAX_LOD - 1 && range >= terrain.chunktables[lod].lodRange())
+		lod++;
+
+	const HeightRecordingBackend &backend = *terrain.backends[lod];
+	float chunkwidth = terrain.chunktables[lod].scale() * 2.0f * float(PREC) / float(PREC + 1) * SCALE;
+	int chunkx = int(floorf(z / chunkwidth + 0.5f)), chunkz = int(floorf(x / chunkwidth + 0.5f));
+	for(unsigned int i = 0; i < backend.slots.size(); i++) {
+		infworld::ChunkPos pos = backend.slots.at(i);
+		if(pos.x != chunkx || pos.z != chunkz)
+			continue;
+
+		//Position of the point in vertices from the corner of the chunk
+		float vx = ((x - float(chunkz) * chunkwidth) / (chunkwidth * 0.5f) + 1.0f) * float(PREC) * 0.5f;
+		float vz = ((z - float(chunkx) * chunkwidth) / (chunkwidth * 0.5f) + 1.0f) * float(PREC) * 0.5f;
+		int ix = int(floorf(vx)), iz = int(floorf(vz));
+		float lowest = std::numeric_limits<float>::infinity();
+		for(int j = std::max(iz - 1, 0); j <= std::min(iz + 2, int(PREC)); j++)
+			for(int k = std::max(ix - 1, 0); k <= std::min(ix + 2, int(PREC)); k++)
+				lowest = std::min(lowest, backend.heights.at(i).at(j * (PREC + 1) + k));
+		return lowest;
+	}
+	return -std::numeric_limits<float>::infinity();
+}
+
+//Returns false if the terrain is above the line between the eye and the
+//point anywhere, the steps grow with the distance but stay much shorter
+//than the sectors of the horizon map
+bool visible(Terrain &terrain, const glm::vec3 &eye, const glm::vec3 &point)
+{
+	glm::vec3 diff = point - eye;
+	float dist = glm::length(glm::vec2(diff.x, diff.z));
+	for(float d = 1.0f; d < dist; d += std::max(1.0f, d * 0.04f)) {
+		glm::vec3 p = eye + diff * (d / dist);
+		if(drawnHeight(terrain, p.x, p.z, eye) > p.y)
+			return false;
+	}
+	return true;
+}
+
+//Returns true if any point on the top of the box can be seen from any of
+//the positions the camera can move to before the map is rebuilt
+bool boxVisible(
+	Terrain &terrain,
+	const glm::vec3 &camera,
+	const glm::vec3 &lower,
+	const glm::vec3 &upper
+) {
+	const float d = infworld::HORIZON_REBUILD_DISTANCE * 0.99f;
+	const glm::vec3 eyes[] = {
+		camera,
+		camera + glm::vec3(d, 0.0f, 0.0f),
+		camera + glm::vec3(-d, 0.0f, 0.0f),
+		camera + glm::vec3(0.0f, 0.0f, d),
+		camera + glm::vec3(0.0f, 0.0f, -d),
+		camera + glm::vec3(0.0f, d, 0.0f),
+		camera + glm::vec3(0.0f, -d, 0.0f),
+	};
+	//A point that is hidden also hides everything directly below it
+	for(const glm::vec3 &eye : eyes) {
+		for(int i = 0; i < BOX_SAMPLES; i++) {
+			for(int j = 0; j < BOX_SAMPLES; j++) {
+				glm::vec3 point(
+					lower.x + (upper.x - lower.x) * float(i) / float(BOX_SAMPLES - 1),
+					upper.y,
+					lower.z + (upper.z - lower.z) * float(j) / float(BOX_SAMPLES - 1)
+				);
+				if(visible(terrain, eye, point))
+					return true;
+			}
+		}
+	}
+	return false;
+}
+
+Result checkHorizon(
+	int seed,
+	const infworld::worldseed &permutations,
+	unsigned int cameras,
+	unsigned int boxes
+) {
+	infworld::HeightCache heights(permutations);
+	Terrain terrain;
+	float scale = CHUNK_SZ;
+	for(unsigned int i = 0; i < MAX_LOD; i++) {
+		terrain.backends[i] = std::make_shared<HeightRecordingBackend>();
+		terrain.chunktables[i] = infworld::ChunkTable(RANGE, scale, HEIGHT, terrain.backends[i]);
+		terrain.chunktables[i].genBuffers();
+		scale *= LOD_SCALE;
+	}
+	infworld::buildChunks(
+		RANGE,
+		heights,
+		HEIGHT,
+		CHUNK_SZ,
+		MAX_LOD,
+		LOD_SCALE,
+		[&terrain](unsigned int lod, unsigned int index, const infworld::ChunkData &chunk) {
+			terrain.chunktables[lod].addChunk(index, chunk);
+		}
+	);
+
+	std::minstd_rand lcg(seed);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	//The camera stays in the center chunk of every table
+	float centerhalfwidth = CHUNK_SZ * float(PREC) / float(PREC + 1) * SCALE;
+	float limit = centerhalfwidth - infworld::HORIZON_REBUILD_DISTANCE * 2.0f;
+
+	double buildtime = 0.0, testtime = 0.0;
+	size_t tested = 0, rejected = 0, falserejections = 0;
+	for(unsigned int c = 0; c < cameras; c++) {
+		glm::vec3 camera((unit(lcg) * 2.0f - 1.0f) * limit, 0.0f, (unit(lcg) * 2.0f - 1.0f) * limit);
+		camera.y = std::max(infworld::getGroundHeight(heights, camera), 0.0f) + 5.0f + unit(lcg) * 250.0f;
+
+		infworld::HorizonMap horizon;
+		buildtime += timeBest(1, [&]() {
+			horizon.build(terrain.chunktables, MAX_LOD, camera, HORIZON_MAXDIST);
+		});
+
+		//Boxes about the size of trees and chunks resting on the ground
+		std::vector<glm::vec3> lowers, uppers;
+		for(unsigned int i = 0; i < boxes; i++) {
+			float dist = 40.0f * powf(HORIZON_MAXDIST * 0.5f / 40.0f, unit(lcg));
+			float angle = unit(lcg) * 2.0f * float(M_PI);
+			glm::vec3 center = camera + dist * glm::vec3(cosf(angle), 0.0f, sinf(angle));
+			float ground = infworld::getGroundHeight(heights, center);
+			float halfwidth = 4.0f + unit(lcg) * 200.0f;
+			lowers.push_back(glm::vec3(center.x - halfwidth, ground - unit(lcg) * 50.0f, center.z - halfwidth));
+			uppers.push_back(glm::vec3(center.x + halfwidth, ground + unit(lcg) * 60.0f, center.z + halfwidth));
+		}
+
+		std::vector<bool> occluded(boxes);
+		testtime += timeBest(1, [&]() {
+			for(unsigned int i = 0; i < boxes; i++)
+				occluded[i] = horizon.occluded(lowers[i], uppers[i]);
+		});
+
+		for(unsigned int i = 0; i < boxes; i++) {
+			tested++;
+			if(!occluded[i])
+				continue;
+			rejected++;
+			if(boxVisible(terrain, camera, lowers[i], uppers[i])) {
+				falserejections++;
+				fprintf(
+					stderr,
+					"visible box rejected: camera (%f, %f, %f) box (%f, %f, %f) - (%f, %f, %f)\n",
+					camera.x, camera.y, camera.z,
+					lowers[i].x, lowers[i].y, lowers[i].z,
+					uppers[i].x, uppers[i].y, uppers[i].z
+				);
+			}
+		}
+	}
+
+	for(unsigned int i = 0; i < MAX_LOD; i++)
+		terrain.chunktables[i].clearBuffers();
+
+	Result result = { "infworld::HorizonMap::occluded", seed, 1, tested, testtime, double(rejected) };
+	result.extra = {
+		{ "build_seconds", buildtime / double(cameras) },
+		{ "rejected_fraction", double(rejected) / double(tested) },
+		{ "false_rejections", double(falserejections) },
+	};
+	return result;
+}
+
+int main(int argc, char **argv)
+{
+	std::vector<int> seeds = { 1, 2, 3 };
+	unsigned int cameras = 8;
+	unsigned int boxes = 2000;
+
+	for(int i = 1; i < argc; i++) {
+		if(strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+			seeds = parseList(argv[++i]);
+		else if(strcmp(argv[i], "-c") == 0 && i + 1 < argc)
+			cameras = std::max(atoi(argv[++i]), 1);
+		else if(strcmp(argv[i], "-b") == 0 && i + 1 < argc)
+			boxes = std::max(atoi(argv[++i]), 1);
+		else {
+			fprintf(stderr, "usage: %s [-s seeds] [-c cameras] [-b boxes]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	std::vector<Result> results;
+	bool correct = true;
+	for(int seed : seeds) {
+		infworld::worldseed permutations = infworld::makePermutations(seed, 9);
+		results.push_back(checkHorizon(seed, permutations, cameras, boxes));
+		correct = correct && results.back().extra.back().second == 0.0;
+	}
+	printResults(results);
+	return correct ? 0 : 1;
+}
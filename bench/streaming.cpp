@@ -0,0 +1,147 @@
+/*
+ * Simulates a long flight over the terrain to measure chunk streaming, the
+ * chunks are passed to a RecordingChunkBackend instead of being uploaded so
+ * this runs without a window and much faster than real time. After the
+ * flight every table is checked to hold exactly the chunks around its
+ * center, the program exits with 1 if that is not the case.
+ *
+ * usage: ./streaming [-s seed,seed,...] [-t threads,threads,...] [-f frames] [-v speed]
+ * */
+
+#include "bench.hpp"
+
+constexpr float FRAME_TIME = 1.0f / 60.0f;
+
+//Returns true if the chunks in the table are the ones around its center
+bool checkTable(
+	infworld::ChunkTable &table,
+	const infworld::RecordingChunkBackend &backend
+) {
+	infworld::ChunkPos center = table.getCenter();
+	int range = table.range();
+	std::vector<bool> found((2 * range + 1) * (2 * range + 1), false);
+	for(unsigned int i = 0; i < table.count(); i++) {
+		infworld::ChunkPos pos = backend.slots.at(i);
+		infworld::ChunkPos tablepos = table.getPos(i);
+		if(pos.x != tablepos.x || pos.z != tablepos.z)
+			return false;
+		int x = pos.x - center.x + range, z = pos.z - center.z + range;
+		if(x < 0 || z < 0 || x > 2 * range || z > 2 * range)
+			return false;
+		if(found.at(x * (2 * range + 1) + z))
+			return false;
+		found.at(x * (2 * range + 1) + z) = true;
+	}
+	return true;
+}
+
+Result simulateFlight(
+	int seed,
+	const infworld::worldseed &permutations,
+	unsigned int threads,
+	unsigned int frames,
+	float speed
+) {
+	infworld::HeightCache heights(permutations);
+	std::vector<std::shared_ptr<infworld::RecordingChunkBackend>> backends;
+	infworld::ChunkTable chunktables[MAX_LOD];
+	float scale = CHUNK_SZ;
+	for(unsigned int i = 0; i < MAX_LOD; i++) {
+		backends.push_back(std::make_shared<infworld::RecordingChunkBackend>());
+		chunktables[i] = infworld::ChunkTable(RANGE, scale, HEIGHT, backends.back());
+		chunktables[i].genBuffers();
+		scale *= LOD_SCALE;
+	}
+	infworld::buildChunks(
+		RANGE,
+		heights,
+		HEIGHT,
+		CHUNK_SZ,
+		MAX_LOD,
+		LOD_SCALE,
+		[&chunktables](unsigned int lod, unsigned int index, const infworld::ChunkData &chunk) {
+			chunktables[lod].addChunk(index, chunk);
+		}
+	);
+
+	//Fly diagonally across the chunks and time how long the work that is
+	//done on the render thread takes each frame
+	double maxframe = 0.0;
+	size_t uploaded = 0;
+	glm::vec2 position(0.0f);
+	glm::vec2 direction = glm::normalize(glm::vec2(1.0f, 0.6f));
+	auto starttime = std::chrono::steady_clock::now();
+	for(unsigned int frame = 0; frame < frames; frame++) {
+		auto framestart = std::chrono::steady_clock::now();
+		position += direction * speed * FRAME_TIME;
+		unsigned int budget = CHUNK_UPLOAD_BUDGET;
+		for(unsigned int i = 0; i < MAX_LOD; i++) {
+			chunktables[i].generateNewChunks(position.x, position.y, heights);
+			unsigned int count = chunktables[i].uploadChunks(budget);
+			budget -= count;
+			uploaded += count;
+		}
+		auto frameend = std::chrono::steady_clock::now();
+		std::chrono::duration<double> duration = frameend - framestart;
+		maxframe = std::max(maxframe, duration.count());
+	}
+	auto endtime = std::chrono::steady_clock::now();
+	std::chrono::duration<double> duration = endtime - starttime;
+
+	//Finish streaming and check that every table ended up where it should be
+	bool consistent = true;
+	for(unsigned int i = 0; i < MAX_LOD; i++) {
+		chunktables[i].waitForChunks();
+		uploaded += chunktables[i].uploadChunks(~0u);
+		consistent = consistent && checkTable(chunktables[i], *backends.at(i));
+		chunktables[i].clearBuffers();
+	}
+
+	Result result = { "streaming", seed, threads, frames, duration.count(), double(uploaded) };
+	result.extra = {
+		{ "simulated_seconds", double(frames) * FRAME_TIME },
+		{ "max_frame_seconds", maxframe },
+		{ "chunks_uploaded", double(uploaded) },
+		{ "height_cache_bytes", double(heights.memoryUsed()) },
+		{ "consistent", consistent ? 1.0 : 0.0 },
+	};
+	return result;
+}
+
+int main(int argc, char **argv)
+{
+	std::vector<int> seeds = { 1, 2 };
+	std::vector<int> threadcounts = { 1, int(std::thread::hardware_concurrency()) };
+	unsigned int frames = 60 * 60;
+	float speed = 200.0f;
+
+	for(int i = 1; i < argc; i++) {
+		if(strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+			seeds = parseList(argv[++i]);
+		else if(strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+			threadcounts = parseList(argv[++i]);
+		else if(strcmp(argv[i], "-f") == 0 && i + 1 < argc)
+			frames = std::max(atoi(argv[++i]), 1);
+		else if(strcmp(argv[i], "-v") == 0 && i + 1 < argc)
+			speed = atof(argv[++i]);
+		else {
+			fprintf(stderr, "usage: %s [-s seeds] [-t threads] [-f frames] [-v speed]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	std::vector<Result> results;
+	bool consistent = true;
+	for(int seed : seeds) {
+		infworld::worldseed permutations = infworld::makePermutations(seed, 9);
+		for(int threads : threadcounts) {
+			if(threads <= 0)
+				continue;
+			JOBS->resize(threads);
+			results.push_back(simulateFlight(seed, permutations, threads, frames, speed));
+			consistent = consistent && results.back().extra.back().second != 0.0;
+		}
+	}
+	printResults(results);
+	return consistent ? 0 : 1;
+}
@@ -0,0 +1,207 @@
+/*
+ * Benchmarks for terrain generation, this does not open a window and does
+ * not make any OpenGL calls. Results are written to stdout as JSON.
+ *
+ * usage: ./terrain [-s seed,seed,...] [-t threads,threads,...] [-r repeat]
+ * */
+
+#include "bench.hpp"
+
+constexpr size_t NOISE_SAMPLES = 1 << 20;
+constexpr size_t HEIGHT_SAMPLES = 1 << 16;
+constexpr int CHUNK_COUNT = 64;
+//Kept separate from the range used by the game so that the results stay
+//comparable if that changes
+constexpr unsigned int BENCH_DECORATION_RANGE = 14;
+
+//Sample points spread across the area covered by the finest level of detail
+void samplePoints(std::vector<float> &xs, std::vector<float> &zs, size_t count)
+{
+	xs.resize(count);
+	zs.resize(count);
+	std::minstd_rand lcg(1);
+	std::uniform_real_distribution<float> dist(-CHUNK_SZ * 8.0f, CHUNK_SZ * 8.0f);
+	for(size_t i = 0; i < count; i++) {
+		xs[i] = dist(lcg);
+		zs[i] = dist(lcg);
+	}
+}
+
+void benchNoise(int seed, unsigned int repeat, std::vector<Result> &results)
+{
+	rng::permutation256 p;
+	rng::createPermutation(p, seed);
+	std::vector<float> xs, zs, out(NOISE_SAMPLES);
+	samplePoints(xs, zs, NOISE_SAMPLES);
+	for(size_t i = 0; i < NOISE_SAMPLES; i++) {
+		xs[i] /= FREQUENCY / 64.0f;
+		zs[i] /= FREQUENCY / 64.0f;
+	}
+
+	double checksum = 0.0;
+	double t = timeBest(repeat, [&]() {
+		checksum = 0.0;
+		for(size_t i = 0; i < NOISE_SAMPLES; i++)
+			checksum += perlin::noise(xs[i], zs[i], p);
+	});
+	results.push_back({ "perlin::noise", seed, 1, NOISE_SAMPLES, t, checksum });
+
+	t = timeBest(repeat, [&]() {
+		perlin::noise(xs.data(), zs.data(), out.data(), NOISE_SAMPLES, p);
+	});
+	checksum = 0.0;
+	for(float v : out)
+		checksum += v;
+	results.push_back({ "perlin::noise (batched)", seed, 1, NOISE_SAMPLES, t, checksum });
+}
+
+void benchHeight(
+	int seed,
+	const infworld::worldseed &permutations,
+	unsigned int repeat,
+	std::vector<Result> &results
+) {
+	std::vector<float> xs, zs, out(HEIGHT_SAMPLES);
+	samplePoints(xs, zs, HEIGHT_SAMPLES);
+
+	double checksum = 0.0;
+	double t = timeBest(repeat, [&]() {
+		checksum = 0.0;
+		for(size_t i = 0; i < HEIGHT_SAMPLES; i++)
+			checksum += infworld::getHeight(xs[i], zs[i], permutations);
+	});
+	results.push_back({ "infworld::getHeight", seed, 1, HEIGHT_SAMPLES, t, checksum });
+
+	t = timeBest(repeat, [&]() {
+		infworld::getHeights(xs.data(), zs.data(), out.data(), HEIGHT_SAMPLES, permutations);
+	});
+	checksum = 0.0;
+	for(float v : out)
+		checksum += v;
+	results.push_back({ "infworld::getHeights", seed, 1, HEIGHT_SAMPLES, t, checksum });
+}
+
+void benchChunks(
+	int seed,
+	const infworld::worldseed &permutations,
+	unsigned int repeat,
+	std::vector<Result> &results
+) {
+	double checksum = 0.0;
+	double t = timeBest(repeat, [&]() {
+		checksum = 0.0;
+		for(int i = 0; i < CHUNK_COUNT; i++) {
+			int x = i % 8 - 4, z = i / 8 - 4;
+			mesh::ElementArrayBuffer<infworld::ChunkVertex> chunk =
+				infworld::createChunkElementArray(permutations, x, z, HEIGHT, CHUNK_SZ);
+			checksum += chunk.mesh.vertices.at(0);
+		}
+	});
+	results.push_back({
+		"infworld::createChunkElementArray",
+		seed,
+		1,
+		CHUNK_COUNT,
+		t,
+		checksum
+	});
+}
+
+void benchDecorations(
+	int seed,
+	const infworld::worldseed &permutations,
+	unsigned int threads,
+	unsigned int repeat,
+	std::vector<Result> &results
+) {
+	double checksum = 0.0;
+	size_t count = 0;
+	double t = timeBest(repeat, [&]() {
+		infworld::DecorationTable decorations(BENCH_DECORATION_RANGE, CHUNK_SZ);
+		decorations.genDecorations(permutations);
+		checksum = 0.0;
+		count = 0;
+		for(unsigned int i = 0; i < decorations.count(); i++) {
+			for(const auto &decoration : decorations.getDecorations(i)) {
+				glm::vec3 pos = decoration.position;
+				checksum += pos.x + pos.y + pos.z;
+				count++;
+			}
+		}
+	});
+	results.push_back({
+		"infworld::DecorationTable::genDecorations",
+		seed,
+		threads,
+		count,
+		t,
+		checksum
+	});
+}
+
+void benchWorld(
+	int seed,
+	const infworld::worldseed &permutations,
+	unsigned int threads,
+	unsigned int repeat,
+	std::vector<Result> &results
+) {
+	double checksum = 0.0;
+	size_t count = 0;
+	double t = timeBest(repeat, [&]() {
+		//Start from an empty cache each time
+		infworld::HeightCache heights(permutations);
+		checksum = 0.0;
+		count = 0;
+		infworld::buildChunks(
+			RANGE,
+			heights,
+			HEIGHT,
+			CHUNK_SZ,
+			MAX_LOD,
+			LOD_SCALE,
+			[&](unsigned int lod, unsigned int index, const infworld::ChunkData &chunk) {
+				checksum += chunk.chunkmesh.mesh.vertices.at(0);
+				count++;
+			}
+		);
+	});
+	results.push_back({ "infworld::buildChunks", seed, threads, count, t, checksum });
+}
+
+int main(int argc, char **argv)
+{
+	std::vector<int> seeds = { 1, 2, 3 };
+	std::vector<int> threadcounts = { 1, 2, 4, int(std::thread::hardware_concurrency()) };
+	unsigned int repeat = 3;
+
+	for(int i = 1; i < argc; i++) {
+		if(strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+			seeds = parseList(argv[++i]);
+		else if(strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+			threadcounts = parseList(argv[++i]);
+		else if(strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+			repeat = std::max(atoi(argv[++i]), 1);
+		else {
+			fprintf(stderr, "usage: %s [-s seeds] [-t threads] [-r repeat]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	std::vector<Result> results;
+	for(int seed : seeds) {
+		infworld::worldseed permutations = infworld::makePermutations(seed, 9);
+		benchNoise(seed, repeat, results);
+		benchHeight(seed, permutations, repeat, results);
+		benchChunks(seed, permutations, repeat, results);
+		for(int threads : threadcounts) {
+			if(threads <= 0)
+				continue;
+			//Both of these are run on the job system
+			JOBS->resize(threads);
+			benchDecorations(seed, permutations, threads, repeat, results);
+			benchWorld(seed, permutations, threads, repeat, results);
+		}
+	}
+	printResults(results);
+}
@@ -16,6 +16,18 @@ namespace assets {
 		glBindTexture(info.target, info.id);
 	}
 
+	TextureInfo TextureManager::getTexture(const std::string &name)
+	{
+		if(!textures.count(name))
+			return { 0, GL_TEXTURE_2D };
+		return textures.at(name);
+	}
+
+	void TextureManager::add(const std::string &name, TextureInfo texture)
+	{
+		textures.insert({ name, texture });
+	}
+
 	TextureMetaData entryToTextureMetaData(const impfile::Entry &entry)
 	{
 		TextureMetaData texture;
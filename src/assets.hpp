@@ -58,7 +58,11 @@ namespace assets {
 	public:
 		static TextureManager* get();
 		void importFromFile(const char *path);
+		//Adds a texture that was created by the program
+		void add(const std::string &name, TextureInfo texture);
 		void bindTexture(const std::string &name, GLenum texturei);
+		//Returns a texture with an id of 0 if it does not exist
+		TextureInfo getTexture(const std::string &name);
 	};
 
 	class VaoManager {
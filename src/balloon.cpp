@@ -3,47 +3,42 @@
 namespace gobjs = gameobjects;
 
 namespace gameobjects {
-	void Enemy::updateBalloon(float dt)
+	void updateBalloons(Balloons &balloons, float dt)
 	{
-		if(transform.position.y > values.at("maxy")) {
-			transform.position.y = values.at("maxy");
-			values.at("direction") *= -1.0f;
+		for(size_t i = 0; i < balloons.size(); i++) {
+			glm::vec3 &position = balloons.transforms[i].position;
+			BalloonState &balloon = balloons.states[i];
+			if(position.y > balloon.maxy) {
+				position.y = balloon.maxy;
+				balloon.direction *= -1.0f;
+			}
+			else if(position.y < balloon.miny) {
+				position.y = balloon.miny;
+				balloon.direction *= -1.0f;
+			}
+
+			position.y += 16.0f * dt * balloon.direction;
 		}
-		else if(transform.position.y < values.at("miny")) {
-			transform.position.y = values.at("miny");
-			values.at("direction") *= -1.0f;
-		}
-
-		transform.position.y += 16.0f * dt * values.at("direction");
 	}
 
-	Enemy spawnBalloon(const glm::vec3 &position, const infworld::worldseed &permutations)
-	{
-		float h = infworld::getHeight(
-			position.z / SCALE * float(PREC + 1) / float(PREC),
-			position.x / SCALE * float(PREC + 1) / float(PREC),
-			permutations
-		) * HEIGHT * SCALE;
+	void spawnBalloon(
+		Balloons &balloons,
+		const glm::vec3 &position,
+		infworld::HeightCache &heights
+	) {
+		float h = infworld::getGroundHeight(heights, position);
 		float y = std::max(h, 0.0f) + HEIGHT;
 		glm::vec3 pos(position.x, y, position.z);
-		Enemy balloon = Enemy(pos, 5, 10);
-
-		float miny = y;
-		float maxy = y + HEIGHT;
-		float direction = 1.0f;	
-		balloon.setVal("miny", miny);
-		balloon.setVal("maxy", maxy);
-		balloon.setVal("direction", direction);
-		return balloon;
+		balloons.add(pos, 5, 10, BalloonState{ y, y + HEIGHT, 1.0f });
 	}
 }
 
 namespace game {
 	void spawnBalloons(
 		gobjs::Player &player,
-		std::vector<gobjs::Enemy> &balloons,
+		gobjs::Balloons &balloons,
 		std::minstd_rand0 &lcg,
-		const infworld::worldseed &permutations
+		infworld::HeightCache &heights
 	) {
 		if(balloons.size() >= 4)
 			return;
@@ -56,6 +51,6 @@ namespace game {
 		float dist = float(lcg() % 256) / 256.0f * CHUNK_SZ * 12.0f + CHUNK_SZ * 6.0f;
 		float angle = float(lcg() % 256) / 256.0f * glm::radians(360.0f);
 		glm::vec3 position = center + dist * glm::vec3(cosf(angle), 0.0f, sinf(angle));
-		balloons.push_back(gobjs::spawnBalloon(position, permutations));
+		gobjs::spawnBalloon(balloons, position, heights);
 	}
 }
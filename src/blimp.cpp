@@ -3,24 +3,24 @@
 namespace gobjs = gameobjects;
 
 namespace gameobjects {
-	void Enemy::updateBlimp(float dt)
+	void updateBlimps(Blimps &blimps, float dt)
 	{
-		transform.position += transform.direction() * 24.0f * dt;
+		for(auto &transform : blimps.transforms)
+			transform.position += transform.direction() * 24.0f * dt;
 	}
 
-	Enemy spawnBlimp(const glm::vec3 &position, float rotation)
+	void spawnBlimp(Blimps &blimps, const glm::vec3 &position, float rotation)
 	{
 		glm::vec3 pos(position.x, HEIGHT * SCALE * 1.1f, position.z);
-		Enemy blimp = Enemy(pos, 24, 60);
-		blimp.transform.rotation.y = rotation;
-		return blimp;
+		blimps.add(pos, 24, 60, BlimpState{});
+		blimps.transforms.back().rotation.y = rotation;
 	}
 }
 
 namespace game {
 	void spawnBlimps(
 		gobjs::Player &player,
-		std::vector<gobjs::Enemy> &blimps,
+		gobjs::Blimps &blimps,
 		std::minstd_rand0 &lcg
 	) {
 		if(blimps.size() >= 3)
@@ -35,8 +35,7 @@ namespace game {
 		float angle = float(lcg() % 256) / 256.0f * glm::radians(360.0f);
 		glm::vec3 position = center + dist * glm::vec3(cosf(angle), 0.0f, sinf(angle));
 		float rotation = float(lcg() % 256) / 256.0f * glm::radians(360.0f);
-		gobjs::Enemy blimp = gobjs::spawnBlimp(position, rotation);
-		blimp.transform.position.y += float(lcg() % 256) / 256.0f * 64.0f;
-		blimps.push_back(blimp);
+		gobjs::spawnBlimp(blimps, position, rotation);
+		blimps.transforms.back().position.y += float(lcg() % 256) / 256.0f * 64.0f;
 	}
 }
@@ -13,11 +13,12 @@ namespace game {
 		std::random_device rd;
 		int randSeed = rd();
 		infworld::worldseed permutations = infworld::makePermutations(randSeed, 9);
+		infworld::HeightCache heights(permutations);
 		infworld::ChunkTable chunktables[MAX_LOD];
-		generateChunks(permutations, chunktables, RANGE);
-		infworld::DecorationTable decorations = infworld::DecorationTable(14, CHUNK_SZ);
+		generateChunks(heights, chunktables, RANGE);
+		infworld::DecorationTable decorations = infworld::DecorationTable(DECORATION_RANGE, CHUNK_SZ);
 		decorations.genDecorations(permutations);
-		gfx::generateDecorationOffsets(decorations);
+		infworld::HorizonMap horizon;
 
 		bool paused = false;
 		bool stop = false;
@@ -29,6 +30,7 @@ namespace game {
 		float dt = 0.0f;
 		float totalTime = 0.0f;
 		unsigned int chunksPerSecond = 0; //Number of chunks drawn per second	
+		gfx::RenderQueue renderqueue;
 		updateCamera(player);
 		while(!glfwWindowShouldClose(state->getWindow()) && !stop) {
 			float start = glfwGetTime();
@@ -45,22 +47,23 @@ namespace game {
 
 			//Update perspective matrix
 			state->updatePerspectiveMat(FOVY, ZNEAR, ZFAR);
+			gfx::updateFrameData();
 
 			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 			//Draw terrain
-			unsigned int drawCount = gfx::displayTerrain(chunktables, MAX_LOD, LOD_SCALE);
-			chunksPerSecond += drawCount;
+			gfx::displayTerrain(renderqueue, chunktables, MAX_LOD, chunksPerSecond, &horizon);
 			//Display trees	
-			gfx::displayDecorations(decorations, totalTime);	
+			gfx::displayDecorations(renderqueue, decorations, totalTime);	
 			//Display plane
 			if(!player.crashed)
-				gfx::displayPlayerPlane(totalTime, player.transform);		
+				gfx::displayPlayerPlane(renderqueue, totalTime, player.transform);		
 			//Display water
-			gfx::displayWater(totalTime);	
+			gfx::displayWater(renderqueue, totalTime);	
 			//Draw skybox
-			gfx::displaySkybox();
+			gfx::displaySkybox(renderqueue);
 			//Display explosions
-			gfx::displayExplosions(explosions);
+			gfx::displayExplosions(renderqueue, explosions);
+			renderqueue.execute();
 			//User Interface
 			gui::displayFPSCounter(fps);
 			if(player.crashed && !paused && player.deathtimer > 2.5f)
@@ -97,7 +100,7 @@ namespace game {
 				//Update plane
 				player.update(dt);
 				bool justcrashed = player.crashed;
-				player.checkIfCrashed(dt, permutations);
+				player.checkIfCrashed(dt, heights);
 				justcrashed = player.crashed ^ justcrashed;
 				//Update explosions
 				if(justcrashed) {
@@ -108,7 +111,8 @@ namespace game {
 					explosion.update(dt);
 				//Update camera
 				updateCamera(player, dt);
-				generateNewChunks(permutations, chunktables, decorations);
+				generateNewChunks(heights, chunktables, decorations);
+				updateOcclusion(chunktables, horizon, decorations);
 			
 				totalTime += dt;
 			}
@@ -130,5 +134,6 @@ namespace game {
 		SNDSRC->stopAll();
 		for(int i = 0; i < MAX_LOD; i++)
 			chunktables[i].clearBuffers();
+		decorations.clearBuffers();
 	}
 }
@@ -0,0 +1,204 @@
+#include "infworld.hpp"
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace infworld {
+	//The indices are the same for every chunk so all tables share them
+	static unsigned int chunkElementBuffer = 0;
+	static unsigned int chunkElementBufferUsers = 0;
+
+	GLChunkBackend::GLChunkBackend(std::shared_ptr<GPUChunkGenerator> chunkgenerator)
+	{
+		generator = chunkgenerator;
+	}
+
+	void GLChunkBackend::init(unsigned int count)
+	{
+		if(chunkElementBufferUsers == 0) {
+			glGenBuffers(1, &chunkElementBuffer);
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, chunkElementBuffer);
+			glBufferData(
+				GL_ELEMENT_ARRAY_BUFFER,
+				CHUNK_INDICES.size() * sizeof(unsigned int),
+				&CHUNK_INDICES[0],
+				GL_STATIC_DRAW
+			);
+		}
+		chunkElementBufferUsers++;
+
+		glGenVertexArrays(1, &vao);
+		glGenBuffers(1, &vertexbuffer);
+		glBindVertexArray(vao);
+
+		glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
+		glBufferData(
+			GL_ARRAY_BUFFER,
+			count * CHUNK_VERTICES * CHUNK_VERT_SZ_BYTES,
+			nullptr,
+			GL_DYNAMIC_DRAW
+		);
+		//Packed height and normal, see ChunkVertex
+		glVertexAttribIPointer(
+			0,
+			1,
+			GL_UNSIGNED_INT,
+			CHUNK_VERT_SZ_BYTES,
+			(void*)0
+		);
+		glEnableVertexAttribArray(0);
+
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, chunkElementBuffer);
+		glBindVertexArray(0);
+
+		glGenTextures(1, &vertextexture);
+		glBindTexture(GL_TEXTURE_BUFFER, vertextexture);
+		glTexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, vertexbuffer);
+
+		//Chunk positions, 2 ints per slot
+		glGenBuffers(1, &positionbuffer);
+		glBindBuffer(GL_TEXTURE_BUFFER, positionbuffer);
+		glBufferData(
+			GL_TEXTURE_BUFFER,
+			count * 2 * sizeof(int),
+			nullptr,
+			GL_DYNAMIC_DRAW
+		);
+		glGenTextures(1, &positiontexture);
+		glBindTexture(GL_TEXTURE_BUFFER, positiontexture);
+		glTexBuffer(GL_TEXTURE_BUFFER, GL_RG32I, positionbuffer);
+		glBindTexture(GL_TEXTURE_BUFFER, 0);
+		glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+		counts = std::vector<int>(count, CHUNK_VERT_COUNT);
+		offsets = std::vector<void*>(count, nullptr);
+		basevertices.reserve(count);
+	}
+
+	void GLChunkBackend::destroy()
+	{
+		glDeleteVertexArrays(1, &vao);
+		glDeleteBuffers(1, &vertexbuffer);
+		glDeleteTextures(1, &positiontexture);
+		glDeleteTextures(1, &vertextexture);
+		glDeleteBuffers(1, &positionbuffer);
+		chunkElementBufferUsers--;
+		if(chunkElementBufferUsers == 0)
+			glDeleteBuffers(1, &chunkElementBuffer);
+	}
+
+	void GLChunkBackend::addChunk(unsigned int index, const ChunkData &chunk)
+	{
+		updateChunk(index, chunk);
+	}
+
+	void GLChunkBackend::updateChunk(unsigned int index, const ChunkData &chunk)
+	{
+		const std::vector<ChunkVertex> &vertices = chunk.chunkmesh.mesh.vertices;
+		glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
+		glBufferSubData(
+			GL_ARRAY_BUFFER,
+			index * CHUNK_VERTICES * CHUNK_VERT_SZ_BYTES,
+			vertices.size() * sizeof(ChunkVertex),
+			&vertices[0]
+		);
+		setPosition(index, chunk.position);
+	}
+
+	bool GLChunkBackend::generateChunk(
+		unsigned int index,
+		ChunkPos pos,
+		float chunkscale,
+		float maxheight
+	) {
+		if(!generator)
+			return false;
+		generator->generate(
+			vertexbuffer,
+			index * CHUNK_VERTICES * CHUNK_VERT_SZ_BYTES,
+			pos,
+			chunkscale,
+			maxheight
+		);
+		setPosition(index, pos);
+		return true;
+	}
+
+	void GLChunkBackend::setPosition(unsigned int index, ChunkPos pos)
+	{
+		int position[] = { pos.x, pos.z };
+		glBindBuffer(GL_TEXTURE_BUFFER, positionbuffer);
+		glBufferSubData(
+			GL_TEXTURE_BUFFER,
+			index * sizeof(position),
+			sizeof(position),
+			position
+		);
+		glBindBuffer(GL_TEXTURE_BUFFER, 0);
+	}
+
+	void GLChunkBackend::draw(ShaderProgram &shader, const std::vector<unsigned int> &visible)
+	{
+		if(visible.empty())
+			return;
+
+		basevertices.clear();
+		for(unsigned int index : visible)
+			basevertices.push_back(index * CHUNK_VERTICES);
+
+		//The chunks are offset in the shader using their positions,
+		//texture unit 0 is used by the terrain texture
+		glActiveTexture(GL_TEXTURE1);
+		glBindTexture(GL_TEXTURE_BUFFER, positiontexture);
+		glActiveTexture(GL_TEXTURE2);
+		glBindTexture(GL_TEXTURE_BUFFER, vertextexture);
+		glActiveTexture(GL_TEXTURE0);
+		shader.uniformInt("chunkpositions", 1);
+		shader.uniformInt("chunkvertices", 2);
+		shader.uniformMat4x4("transform", glm::scale(glm::mat4(1.0f), glm::vec3(SCALE)));
+
+		glBindVertexArray(vao);
+		glMultiDrawElementsBaseVertex(
+			GL_TRIANGLES,
+			&counts[0],
+			GL_UNSIGNED_INT,
+			&offsets[0],
+			basevertices.size(),
+			&basevertices[0]
+		);
+	}
+
+	void NullChunkBackend::init(unsigned int count) {}
+	void NullChunkBackend::destroy() {}
+	void NullChunkBackend::addChunk(unsigned int index, const ChunkData &chunk) {}
+	void NullChunkBackend::updateChunk(unsigned int index, const ChunkData &chunk) {}
+	void NullChunkBackend::draw(ShaderProgram &shader, const std::vector<unsigned int> &visible) {}
+
+	void RecordingChunkBackend::init(unsigned int count)
+	{
+		slots = std::vector<ChunkPos>(count);
+	}
+
+	void RecordingChunkBackend::destroy()
+	{
+		slots.clear();
+	}
+
+	void RecordingChunkBackend::addChunk(unsigned int index, const ChunkData &chunk)
+	{
+		slots.at(index) = chunk.position;
+		uploads.push_back({ index, chunk.position, false });
+	}
+
+	void RecordingChunkBackend::updateChunk(unsigned int index, const ChunkData &chunk)
+	{
+		slots.at(index) = chunk.position;
+		uploads.push_back({ index, chunk.position, true });
+	}
+
+	void RecordingChunkBackend::draw(
+		ShaderProgram &shader,
+		const std::vector<unsigned int> &visible
+	) {
+		drawcalls++;
+		chunksdrawn += visible.size();
+	}
+}
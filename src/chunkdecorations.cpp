@@ -1,9 +1,34 @@
 #include "infworld.hpp"
+#include "jobsystem.hpp"
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <algorithm>
+#include <limits.h>
+
+constexpr unsigned int MAX_PINE_TREES = 120;
+constexpr unsigned int MAX_TREES = 36;
 
 namespace infworld {
+	//Layout of the commands read by glMultiDrawElementsIndirect
+	struct DrawElementsIndirectCommand {
+		unsigned int count;
+		unsigned int instancecount;
+		unsigned int firstindex;
+		int basevertex;
+		unsigned int baseinstance;
+	};
+
+	unsigned int maxDecorations(DecorationType type)
+	{
+		switch(type) {
+		case PINE_TREE:
+			return MAX_PINE_TREES;
+		case TREE:
+			return MAX_TREES;
+		}
+		return 0;
+	}
+
 	int getChunkSeed(int x, int z, const worldseed &permutations)
 	{
 		//Taken from wikipedia
@@ -29,6 +54,13 @@ namespace infworld {
 			for(int z = -int(sz); z <= int(sz); z++)
 				positions.push_back({ x, z });	
 		decorations = std::vector<std::vector<Decoration>>(count());
+		versions = std::vector<unsigned int>(count(), 0);
+		instances = std::vector<CellInstances>(count() * DECORATION_TYPES);
+		generation = std::vector<unsigned int>(count(), 0);
+		generated = std::make_shared<GeneratedCells>();
+		lowerbounds = std::vector<glm::vec3>(count());
+		upperbounds = std::vector<glm::vec3>(count());
+		hidden = std::vector<bool>(count(), false);
 	}
 
 	unsigned int DecorationTable::count()
@@ -36,21 +68,61 @@ namespace infworld {
 		return size * size;
 	}
 
+	const std::vector<Decoration>& DecorationTable::getDecorations(unsigned int index) const
+	{
+		return decorations.at(index);
+	}
+
 	//Draw chunk decorations
 	void DecorationTable::drawDecorations(const gfx::Vao &vao) {
-		if(!vaoCount.count(vao.vaoid))
+		if(!instancebuffers.count(vao.vaoid))
+			return;
+		const InstanceBuffer &buffer = instancebuffers.at(vao.vaoid);
+
+		if(buffer.indirectbuffer) {
+			if(buffer.drawcount == 0)
+				return;
+			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, buffer.indirectbuffer);
+			glMultiDrawElementsIndirect(
+				GL_TRIANGLES,
+				GL_UNSIGNED_INT,
+				nullptr,
+				buffer.drawcount,
+				0
+			);
+			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
 			return;
-		glDrawElementsInstanced(GL_TRIANGLES, vao.vertcount, GL_UNSIGNED_INT, 0, vaoCount.at(vao.vaoid));
+		}
+
+		//Without indirect draws (OpenGL 4.3) the offsets are pointed at each
+		//slot in turn
+		size_t slotsize = maxDecorations(buffer.type) * 3 * sizeof(float);
+		glBindBuffer(GL_ARRAY_BUFFER, vao.buffers.at(4));
+		for(unsigned int i = 0; i < buffer.counts.size(); i++) {
+			if(buffer.counts.at(i) == 0)
+				continue;
+			glVertexAttribPointer(3, 3, GL_FLOAT, false, 3 * sizeof(float), (void*)(i * slotsize));
+			glDrawElementsInstanced(
+				GL_TRIANGLES,
+				vao.vertcount,
+				GL_UNSIGNED_INT,
+				0,
+				buffer.counts.at(i)
+			);
+		}
+		glVertexAttribPointer(3, 3, GL_FLOAT, false, 3 * sizeof(float), (void*)0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
 	}
 
-	void DecorationTable::genDecorations(
+	void genDecorations(
 		const worldseed &permutations,
 		DecorationType type,
 		unsigned int n,
 		int x,
 		int z,
-		unsigned int index,
-		std::minstd_rand0 &lcg
+		float chunkscale,
+		std::minstd_rand0 &lcg,
+		std::vector<Decoration> &decorations
 	) {
 		float chunksz = chunkscale * 2.0f * float(PREC) / float(PREC + 1);	
 		float posx = float(z) * chunksz;
@@ -68,56 +140,90 @@ namespace infworld {
 			y *= HEIGHT;
 			x *= float(PREC) / float(PREC + 1);
 			z *= float(PREC) / float(PREC + 1);
-			decorations.at(index).push_back({
+			decorations.push_back({
 				glm::vec3(x, y - 0.5f, z),
 				type,
 			});
 		}
 	}
 
-	void DecorationTable::generate(const worldseed &permutations, unsigned int index)
-	{
-		ChunkPos pos = positions.at(index);
+	//Only depends on its arguments so it can be run on any thread
+	std::vector<Decoration> generateDecorations(
+		const worldseed &permutations,
+		ChunkPos pos,
+		float chunkscale
+	) {
+		std::vector<Decoration> decorations;
 		int seed = getChunkSeed(pos.x, pos.z, permutations);
 		std::minstd_rand0 lcg;
 		lcg.seed(seed);
-		genDecorations(permutations, PINE_TREE, 120, pos.x, pos.z, index, lcg);
-		genDecorations(permutations, TREE, 36, pos.x, pos.z, index, lcg);
+		genDecorations(permutations, PINE_TREE, MAX_PINE_TREES, pos.x, pos.z, chunkscale, lcg, decorations);
+		genDecorations(permutations, TREE, MAX_TREES, pos.x, pos.z, chunkscale, lcg, decorations);
 
-		decorations.at(index).erase(std::remove_if(
-			decorations.at(index).begin(),
-			decorations.at(index).end(),
+		decorations.erase(std::remove_if(
+			decorations.begin(),
+			decorations.end(),
 			[&permutations](Decoration d) {
 				float x = d.position.x / 128.0f;
 				float z = d.position.z / 128.0f;
 				return perlin::noise(x, z, permutations.at(0)) < 0.0f;
 			}
-		), decorations.at(index).end());
+		), decorations.end());
 
-		decorations.at(index).erase(std::remove_if(
-			decorations.at(index).begin(),
-			decorations.at(index).end(),
+		decorations.erase(std::remove_if(
+			decorations.begin(),
+			decorations.end(),
 			[](Decoration d) {
 				float y = d.position.y / HEIGHT;
 				return d.type == TREE && (y < 0.02f || y > 0.2f);
 			}
-		), decorations.at(index).end());
+		), decorations.end());
 
-		decorations.at(index).erase(std::remove_if(
-			decorations.at(index).begin(),
-			decorations.at(index).end(),
+		decorations.erase(std::remove_if(
+			decorations.begin(),
+			decorations.end(),
 			[](Decoration d) {
 				float y = d.position.y / HEIGHT;
 				return d.type == PINE_TREE && (y < 0.04f || y > 0.3f);
 			}
-		), decorations.at(index).end());
+		), decorations.end());
+
+		return decorations;
+	}
+
+	void DecorationTable::setDecorations(unsigned int index, std::vector<Decoration> &&cell)
+	{
+		decorations.at(index) = std::move(cell);
+		for(unsigned int type = 0; type < DECORATION_TYPES; type++) {
+			CellInstances &typeinstances = instances.at(index * DECORATION_TYPES + type);
+			typeinstances.xs.clear();
+			typeinstances.ys.clear();
+			typeinstances.zs.clear();
+		}
+		for(const auto &decoration : decorations.at(index)) {
+			CellInstances &typeinstances = instances.at(index * DECORATION_TYPES + decoration.type);
+			typeinstances.xs.push_back(decoration.position.x * SCALE);
+			typeinstances.ys.push_back(decoration.position.y * SCALE);
+			typeinstances.zs.push_back(decoration.position.z * SCALE);
+		}
+		findBounds(index);
+		hidden.at(index) = false;
+		versions.at(index)++;
 	}
 
 	//Generate decorations
 	void DecorationTable::genDecorations(const worldseed &permutations)
 	{
-		for(int i = 0; i < decorations.size(); i++)
-			generate(permutations, i);
+		waitForDecorations();
+		for(auto &g : generation)
+			g++;
+		std::vector<std::vector<Decoration>> cells(count());
+		JOBS->parallelFor(count(), 1, [&](size_t begin, size_t end) {
+			for(size_t i = begin; i < end; i++)
+				cells.at(i) = generateDecorations(permutations, positions.at(i), chunkscale);
+		});
+		for(int i = 0; i < count(); i++)
+			setDecorations(i, std::move(cells.at(i)));
 	}
 
 	bool DecorationTable::genNewDecorations(
@@ -153,12 +259,27 @@ namespace infworld {
 			indices.push_back(i);
 		}
 
+		std::shared_ptr<GeneratedCells> queue = generated;
 		for(int i = 0; i < indices.size(); i++) {
 			unsigned int index = indices.at(i);
 			ChunkPos pos = newChunks.at(i);
 			positions.at(index) = pos;
-			decorations.at(index).clear();
-			generate(permutations, index);
+			//The cell stays empty until its decorations are integrated
+			setDecorations(index, {});
+
+			unsigned int gen = ++generation.at(index);
+			{
+				std::lock_guard<std::mutex> lock(queue->mutex);
+				queue->generating++;
+			}
+			float scale = chunkscale;
+			JOBS->submit([queue, &permutations, index, gen, pos, scale]() {
+				std::vector<Decoration> cell = generateDecorations(permutations, pos, scale);
+				std::lock_guard<std::mutex> lock(queue->mutex);
+				queue->cells.push_back({ index, gen, std::move(cell) });
+				queue->generating--;
+				queue->finished.notify_all();
+			});
 		}
 
 		centerx = ix;
@@ -167,42 +288,220 @@ namespace infworld {
 		return true;
 	}
 
+	void DecorationTable::findBounds(unsigned int index)
+	{
+		if(decorations.at(index).empty())
+			return;
+		glm::vec3 lower, upper;
+		lower = upper = decorations.at(index).front().position;
+		for(const auto &decoration : decorations.at(index)) {
+			lower = glm::min(lower, decoration.position);
+			upper = glm::max(upper, decoration.position);
+		}
+		//Leave room for the size of the models
+		lowerbounds.at(index) = (lower - glm::vec3(DECORATION_SIZE)) * SCALE;
+		upperbounds.at(index) = (upper + glm::vec3(DECORATION_SIZE)) * SCALE;
+	}
+
+	unsigned int DecorationTable::integrateDecorations(unsigned int budget)
+	{
+		std::vector<PendingCell> ready;
+		{
+			std::lock_guard<std::mutex> lock(generated->mutex);
+			if(generated->cells.empty())
+				return 0;
+			ready.swap(generated->cells);
+		}
+
+		unsigned int integrated = 0;
+		std::vector<PendingCell> remaining;
+		for(auto &pending : ready) {
+			//The cell has been given a different position since this was
+			//generated
+			if(pending.generation != generation.at(pending.index))
+				continue;
+
+			if(integrated < budget) {
+				setDecorations(pending.index, std::move(pending.decorations));
+				integrated++;
+			}
+			else
+				remaining.push_back(std::move(pending));
+		}
+
+		//Put back anything that went over the budget for the next frame
+		if(!remaining.empty()) {
+			std::lock_guard<std::mutex> lock(generated->mutex);
+			for(auto &pending : generated->cells)
+				remaining.push_back(std::move(pending));
+			generated->cells.swap(remaining);
+		}
+
+		return integrated;
+	}
+
+	void DecorationTable::waitForDecorations()
+	{
+		std::unique_lock<std::mutex> lock(generated->mutex);
+		generated->finished.wait(lock, [this]() { return generated->generating == 0; });
+	}
+
+	bool DecorationTable::updateOcclusion(const HorizonMap &horizon)
+	{
+		bool changed = false;
+		for(unsigned int i = 0; i < count(); i++) {
+			bool occluded =
+				!decorations.at(i).empty() &&
+				horizon.occluded(lowerbounds.at(i), upperbounds.at(i));
+			changed = changed || occluded != hidden.at(i);
+			hidden.at(i) = occluded;
+		}
+		return changed;
+	}
+
 	void DecorationTable::generateOffsets(
 		DecorationType type,
 		const gfx::Vao &vao,
 		unsigned int minrange,
-		unsigned int maxrange
+		unsigned int maxrange,
+		const glm::vec3 &camerapos,
+		const geo::PackedFrustum &viewfrustum
 	) {
 		if(decorations.size() == 0)
 			return;
 
-		std::vector<float> offsets;
+		unsigned int capacity = maxDecorations(type);
+		glBindBuffer(GL_ARRAY_BUFFER, vao.buffers.at(4));
+		if(!instancebuffers.count(vao.vaoid)) {
+			InstanceBuffer buffer;
+			buffer.type = type;
+			buffer.counts = std::vector<unsigned int>(count(), 0);
+			buffer.written = std::vector<unsigned int>(count(), UINT_MAX);
+			buffer.keys = std::vector<uint64_t>(count(), 0);
+			if(GLAD_GL_VERSION_4_3)
+				glGenBuffers(1, &buffer.indirectbuffer);
+			glBufferData(
+				GL_ARRAY_BUFFER,
+				sizeof(float) * 3 * capacity * count(),
+				nullptr,
+				GL_DYNAMIC_DRAW
+			);
+			instancebuffers.insert({ vao.vaoid, buffer });
+		}
+		InstanceBuffer &buffer = instancebuffers.at(vao.vaoid);
+
+		float cellwidth = 
+			chunkscale * 2.0f *
+			float(PREC) / float(PREC + 1) *
+			float(PREC) / float(PREC + 1) *
+			SCALE;
+		float mindist = minrange > 0 ? (float(minrange) - 0.5f) * cellwidth : 0.0f;
+		float maxdist = (float(maxrange) - 0.5f) * cellwidth;
 
+		std::vector<unsigned int> indices(capacity);
+		std::vector<float> offsets;
+		offsets.reserve(capacity * 3);
+		std::vector<DrawElementsIndirectCommand> commands;
 		for(int i = 0; i < count(); i++) {
-			ChunkPos pos = positions.at(i);
+			buffer.counts.at(i) = 0;
+			const CellInstances &cell = instances.at(i * DECORATION_TYPES + type);
+			size_t n = cell.xs.size();
+			if(n == 0 || hidden.at(i))
+				continue;
 
-			if((labs(pos.x - centerx) < minrange &&
-			    labs(pos.z - centerz) < minrange) ||
-			   (labs(pos.x - centerx) >= maxrange ||
-				labs(pos.z - centerz) >= maxrange))
+			//Skip cells that are entirely out of range or outside of the
+			//view frustum
+			glm::vec3 lower = lowerbounds.at(i), upper = upperbounds.at(i);
+			float closest = glm::length(glm::clamp(camerapos, lower, upper) - camerapos);
+			float farthest = glm::length(glm::max(
+				glm::abs(lower - camerapos),
+				glm::abs(upper - camerapos)
+			));
+			if(farthest < mindist || closest >= maxdist)
+				continue;
+			geo::AABB box((lower + upper) * 0.5f, upper - lower);
+			geo::FrustumTest test = geo::testFrustum(viewfrustum, box);
+			if(test == geo::OUTSIDE)
 				continue;
 
-			for(const auto &decoration : decorations.at(i)) {
-				if(decoration.type != type)
-					continue;
-				offsets.push_back(decoration.position.x * SCALE);
-				offsets.push_back(decoration.position.y * SCALE);
-				offsets.push_back(decoration.position.z * SCALE);
+			size_t visible = n;
+			if(test == geo::INSIDE && closest >= mindist && farthest < maxdist) {
+				//Everything in the cell is visible
+				for(unsigned int j = 0; j < n; j++)
+					indices.at(j) = j;
 			}
-		}
+			else {
+				visible = geo::cullSpheres(
+					viewfrustum,
+					&cell.xs[0],
+					&cell.ys[0],
+					&cell.zs[0],
+					n,
+					DECORATION_SIZE * SCALE,
+					camerapos,
+					mindist,
+					maxdist,
+					&indices[0]
+				);
+			}
+			if(visible == 0)
+				continue;
 
-		if(vaoCount.count(vao.vaoid))
-			vaoCount.at(vao.vaoid) = offsets.size() / 3;
-		else
-			vaoCount.insert({ vao.vaoid, offsets.size() / 3 });
+			//FNV-1a hash of the visible indices
+			uint64_t key = 14695981039346656037ull;
+			for(unsigned int j = 0; j < visible; j++)
+				key = (key ^ indices.at(j)) * 1099511628211ull;
+			key = (key ^ visible) * 1099511628211ull;
 
-		glBindBuffer(GL_ARRAY_BUFFER, vao.buffers.at(4));
-		glBufferData(GL_ARRAY_BUFFER, sizeof(float) * offsets.size(), &offsets[0], GL_STATIC_DRAW);
+			//Only write the slot if it does not already hold these
+			if(buffer.written.at(i) != versions.at(i) || buffer.keys.at(i) != key) {
+				offsets.clear();
+				for(unsigned int j = 0; j < visible; j++) {
+					unsigned int index = indices.at(j);
+					offsets.push_back(cell.xs.at(index));
+					offsets.push_back(cell.ys.at(index));
+					offsets.push_back(cell.zs.at(index));
+				}
+				glBufferSubData(
+					GL_ARRAY_BUFFER,
+					sizeof(float) * 3 * capacity * i,
+					sizeof(float) * offsets.size(),
+					offsets.data()
+				);
+				buffer.written.at(i) = versions.at(i);
+				buffer.keys.at(i) = key;
+			}
+
+			buffer.counts.at(i) = visible;
+			commands.push_back({
+				vao.vertcount,
+				buffer.counts.at(i),
+				0,
+				0,
+				capacity * i
+			});
+		}
 		glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+		if(buffer.indirectbuffer) {
+			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, buffer.indirectbuffer);
+			glBufferData(
+				GL_DRAW_INDIRECT_BUFFER,
+				sizeof(DrawElementsIndirectCommand) * commands.size(),
+				commands.data(),
+				GL_DYNAMIC_DRAW
+			);
+			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+		}
+		buffer.drawcount = commands.size();
+	}
+
+	void DecorationTable::clearBuffers()
+	{
+		waitForDecorations();
+		generated->cells.clear();
+		for(auto &buffer : instancebuffers)
+			glDeleteBuffers(1, &buffer.second.indirectbuffer);
+		instancebuffers.clear();
 	}
 }
@@ -0,0 +1,90 @@
+#include "infworld.hpp"
+
+namespace infworld {
+	GPUChunkGenerator::GPUChunkGenerator(
+		const worldseed &permutations,
+		const char *shaderpath
+	) {
+		shader = std::make_unique<ShaderProgram>(
+			shaderpath,
+			std::vector<const char*>{ "vertexdata" }
+		);
+		octaves = permutations.size();
+
+		//The other uniforms are the same for every chunk
+		shader->use();
+		shader->uniformInt("permutations", 0);
+		shader->uniformInt("octaves", octaves);
+		shader->uniformInt("prec", PREC);
+		shader->uniformFloat("frequency", FREQUENCY);
+		chunkposuniform = shader->getUniform<glm::ivec2>("chunkpos");
+		chunkscaleuniform = shader->getUniform<float>("chunkscale");
+		maxheightuniform = shader->getUniform<float>("maxheight");
+
+		//The permutation tables of every octave one after the other
+		std::vector<int> values;
+		values.reserve(octaves * 256);
+		for(const auto &p : permutations)
+			values.insert(values.end(), p, p + 256);
+		glGenBuffers(1, &permutationbuffer);
+		glBindBuffer(GL_TEXTURE_BUFFER, permutationbuffer);
+		glBufferData(
+			GL_TEXTURE_BUFFER,
+			values.size() * sizeof(int),
+			&values[0],
+			GL_STATIC_DRAW
+		);
+		glGenTextures(1, &permutationtexture);
+		glBindTexture(GL_TEXTURE_BUFFER, permutationtexture);
+		glTexBuffer(GL_TEXTURE_BUFFER, GL_R32I, permutationbuffer);
+		glBindTexture(GL_TEXTURE_BUFFER, 0);
+		glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+		//The shader has no vertex attributes but a vao still needs
+		//to be bound to draw
+		glGenVertexArrays(1, &vao);
+	}
+
+	GPUChunkGenerator::~GPUChunkGenerator()
+	{
+		glDeleteVertexArrays(1, &vao);
+		glDeleteTextures(1, &permutationtexture);
+		glDeleteBuffers(1, &permutationbuffer);
+		glDeleteProgram(shader->getid());
+	}
+
+	void GPUChunkGenerator::generate(
+		unsigned int buffer,
+		size_t offset,
+		ChunkPos pos,
+		float chunkscale,
+		float maxheight
+	) {
+		shader->use();
+		shader->uniformIVec2(chunkposuniform, glm::ivec2(pos.x, pos.z));
+		shader->uniformFloat(chunkscaleuniform, chunkscale);
+		shader->uniformFloat(maxheightuniform, maxheight);
+
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_BUFFER, permutationtexture);
+		glBindVertexArray(vao);
+		glBindBufferRange(
+			GL_TRANSFORM_FEEDBACK_BUFFER,
+			0,
+			buffer,
+			offset,
+			CHUNK_VERTICES * CHUNK_VERT_SZ_BYTES
+		);
+
+		//One point per vertex, nothing is drawn
+		glEnable(GL_RASTERIZER_DISCARD);
+		glBeginTransformFeedback(GL_POINTS);
+		glDrawArrays(GL_POINTS, 0, CHUNK_VERTICES);
+		glEndTransformFeedback();
+		glDisable(GL_RASTERIZER_DISCARD);
+
+		glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+		glBindTexture(GL_TEXTURE_BUFFER, 0);
+		glBindVertexArray(0);
+	}
+}
@@ -1,6 +1,8 @@
 #include "infworld.hpp"
+#include "jobsystem.hpp"
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <limits>
 
 namespace infworld {
 	//Default constructor
@@ -11,118 +13,72 @@ namespace infworld {
 		chunkscale = 0.0f;
 	}
 
-	ChunkTable::ChunkTable(unsigned int range, float scale, float h)
-	{
+	ChunkTable::ChunkTable(
+		unsigned int range,
+		float scale,
+		float h,
+		std::shared_ptr<ChunkBackend> chunkbackend
+	) {
 		size = 2 * range + 1;
 		chunkcount = size * size;
 		chunkscale = scale;
 		height = h;
-		vaoids = std::vector<unsigned int>(chunkcount);
+		backend = chunkbackend;
 		chunkpos = std::vector<infworld::ChunkPos>(chunkcount);
-		bufferids = std::vector<unsigned int>(BUFFER_PER_CHUNK * chunkcount);
+		targetpos = std::vector<infworld::ChunkPos>(chunkcount);
+		generation = std::vector<unsigned int>(chunkcount);
+		minheights = std::vector<float>(chunkcount, -1.0f);
+		maxheights = std::vector<float>(chunkcount, 1.0f);
+		built = std::make_shared<BuiltChunks>();
 	}
 
 	void ChunkTable::genBuffers()
 	{	
-		glGenVertexArrays(vaoids.size(), &vaoids[0]);	
-		glGenBuffers(bufferids.size(), &bufferids[0]);
+		backend->init(chunkcount);
 	}
 
 	void ChunkTable::clearBuffers()
 	{
-		glDeleteVertexArrays(vaoids.size(), &vaoids[0]);
-		glDeleteBuffers(bufferids.size(), &bufferids[0]);
-	}
-
-	void ChunkTable::addChunk(
-		unsigned int index,
-		const mesh::ElementArrayBuffer<float> &chunkmesh,
-		int x,
-		int z
-	) {
-		chunkpos.at(index) = { x, z };
-
-		glBindVertexArray(vaoids.at(index));
-
-		//Buffer 0 (vertex positions)
-		glBindBuffer(GL_ARRAY_BUFFER, bufferids.at(index * BUFFER_PER_CHUNK));
-		glBufferData(
-			GL_ARRAY_BUFFER, 
-			chunkmesh.mesh.vertices.size() * sizeof(float),
-			&chunkmesh.mesh.vertices[0],
-			GL_STATIC_DRAW
-		);
-		glVertexAttribPointer(
-			0,
-			1,
-			GL_FLOAT,
-			false,
-			CHUNK_VERT_SZ_BYTES,
-			(void*)0
-		);
-		glEnableVertexAttribArray(0);
-
-		//Buffer 1 (vertex normals)
-		glBindBuffer(GL_ARRAY_BUFFER, bufferids.at(index * BUFFER_PER_CHUNK + 1));
-		glBufferData(
-			GL_ARRAY_BUFFER,
-			chunkmesh.mesh.vertices.size() * sizeof(float),
-			&chunkmesh.mesh.vertices[0],
-			GL_STATIC_DRAW
-		);
-		glVertexAttribPointer(
-			1,
-			2,
-			GL_FLOAT, 
-			false,
-			CHUNK_VERT_SZ_BYTES,
-			(void*)(sizeof(float))
-		);
-		glEnableVertexAttribArray(1);
-
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, bufferids.at(index * BUFFER_PER_CHUNK + 2));
-		glBufferData(
-			GL_ELEMENT_ARRAY_BUFFER,
-			CHUNK_INDICES.size() * sizeof(unsigned int),
-			&CHUNK_INDICES[0],
-			GL_STATIC_DRAW
-		);
+		waitForChunks();
+		if(built)
+			built->chunks.clear();
+		backend->destroy();
 	}
 
 	void ChunkTable::addChunk(unsigned int index, const ChunkData &chunk)
 	{
-		addChunk(index, chunk.chunkmesh, chunk.position.x, chunk.position.z);
+		changes++;
+		chunkpos.at(index) = chunk.position;
+		targetpos.at(index) = chunk.position;
+		minheights.at(index) = chunk.minheight;
+		maxheights.at(index) = chunk.maxheight;
+		cullnodesdirty = true;
+		backend->addChunk(index, chunk);
 	}
 
 	void ChunkTable::updateChunk(unsigned int index, const ChunkData &chunk)
 	{
-		chunkpos.at(index) = { chunk.position.x, chunk.position.z };
-
-		glBindVertexArray(vaoids.at(index));
-
-		//Buffer 0 (vertex positions)
-		glBindBuffer(GL_ARRAY_BUFFER, bufferids.at(index * BUFFER_PER_CHUNK));
-		glBufferSubData(
-			GL_ARRAY_BUFFER,
-			0,
-			chunk.chunkmesh.mesh.vertices.size() * sizeof(float),
-			&chunk.chunkmesh.mesh.vertices[0]
-		);
-
-		//Buffer 1 (vertex normals)
-		glBindBuffer(GL_ARRAY_BUFFER, bufferids.at(index * BUFFER_PER_CHUNK + 1));
-		glBufferSubData(
-			GL_ARRAY_BUFFER,
-			0,
-			chunk.chunkmesh.mesh.vertices.size() * sizeof(float),
-			&chunk.chunkmesh.mesh.vertices[0]
-		);
+		changes++;
+		chunkpos.at(index) = chunk.position;
+		minheights.at(index) = chunk.minheight;
+		maxheights.at(index) = chunk.maxheight;
+		cullnodesdirty = true;
+		backend->updateChunk(index, chunk);
 	}
 
-	void ChunkTable::bindVao(unsigned int index)
+	bool ChunkTable::generateChunk(unsigned int index, ChunkPos pos)
 	{
-		glBindVertexArray(vaoids.at(index));
-	}	
+		if(!backend->generateChunk(index, pos, chunkscale, height))
+			return false;
+		chunkpos.at(index) = pos;
+		targetpos.at(index) = pos;
+		//The heights are not read back from the GPU
+		minheights.at(index) = -1.0f;
+		maxheights.at(index) = 1.0f;
+		cullnodesdirty = true;
+		changes++;
+		return true;
+	}
 
 	infworld::ChunkPos ChunkTable::getPos(unsigned int index)
 	{
@@ -143,23 +99,37 @@ namespace infworld {
 	{
 		centerx = x;
 		centerz = z;
+		cullnodesdirty = true;
+		changes++;
+	}
+
+	void ChunkTable::buildInBackground(
+		unsigned int index,
+		ChunkPos pos,
+		HeightCache &heights
+	) {
+		std::shared_ptr<BuiltChunks> queue = built;
+		{
+			std::lock_guard<std::mutex> lock(queue->mutex);
+			queue->building++;
+		}
+
+		unsigned int gen = generation.at(index);
+		float maxheight = height, scale = chunkscale;
+		JOBS->submit([queue, &heights, index, gen, pos, maxheight, scale]() {
+			ChunkData chunk = buildChunk(heights, pos.x, pos.z, maxheight, scale);
+			std::lock_guard<std::mutex> lock(queue->mutex);
+			queue->chunks.push_back({ index, gen, std::move(chunk) });
+			queue->building--;
+			queue->finished.notify_all();
+		});
 	}
 
 	void ChunkTable::generateNewChunks(
 		float camerax,
 		float cameraz,
-		const worldseed &permutations
+		HeightCache &heights
 	) {
-		if(indices.size() > 0) {
-			int i = indices.size() - 1;
-			int x = newChunks.at(i).x, z = newChunks.at(i).z;
-			ChunkData chunk = buildChunk(permutations, x, z, height, chunkscale);
-			updateChunk(indices.at(i), chunk);
-			indices.pop_back();
-			newChunks.pop_back();
-			return;
-		}
-
 		float chunksz = chunkscale * float(PREC) / float(PREC + 1);
 		int
 			ix = int(floorf((cameraz + chunksz * SCALE) / (chunksz * SCALE * 2.0f))),
@@ -167,95 +137,311 @@ namespace infworld {
 		if(ix == centerx && iz == centerz)
 			return;
 
+		std::vector<ChunkPos> newchunks;
 		int range = (size - 1) / 2;
 		for(int x = ix - range; x <= ix + range; x++) {
 			for(int z = iz - range; z <= iz + range; z++) {
 				if(labs(x - centerx) <= range && labs(z - centerz) <= range)
 					continue;
-				newChunks.push_back({ x, z });
+				newchunks.push_back({ x, z });
 			}
 		}
 
-		//Determine which chunks are out of range
+		//Reuse the slots that are out of range, this uses the position that
+		//the slot will have so that slots that are still waiting on a chunk
+		//are handled correctly
+		unsigned int n = 0;
 		for(int i = 0; i < chunkcount; i++) {
 			int 
-				chunkx = chunkpos.at(i).x,
-				chunkz = chunkpos.at(i).z;	
+				chunkx = targetpos.at(i).x,
+				chunkz = targetpos.at(i).z;	
 			if(labs(ix - chunkx) <= range && labs(iz - chunkz) <= range)
 				continue;
-			indices.push_back(i);
+			ChunkPos pos = newchunks.at(n++);
+			generation.at(i)++;
+			//Backends that generate chunks themselves do not need to wait
+			//for the chunk to be built
+			if(!generateChunk(i, pos)) {
+				targetpos.at(i) = pos;
+				buildInBackground(i, pos, heights);
+			}
 		}	
 
 		centerx = ix;
 		centerz = iz;
+		cullnodesdirty = true;
+		changes++;
 	}
 
-	unsigned int ChunkTable::draw(
-		ShaderProgram &shader,
-		const geo::Frustum &viewfrustum
+	unsigned int ChunkTable::uploadChunks(unsigned int budget)
+	{
+		std::vector<PendingChunk> ready;
+		{
+			std::lock_guard<std::mutex> lock(built->mutex);
+			if(built->chunks.empty())
+				return 0;
+			ready.swap(built->chunks);
+		}
+
+		unsigned int uploaded = 0;
+		std::vector<PendingChunk> remaining;
+		for(auto &pending : ready) {
+			//The slot has been given a different chunk since this was built
+			if(pending.generation != generation.at(pending.index))
+				continue;
+
+			if(uploaded < budget) {
+				updateChunk(pending.index, pending.chunk);
+				uploaded++;
+			}
+			else
+				remaining.push_back(std::move(pending));
+		}
+
+		//Put back anything that went over the budget for the next frame
+		if(!remaining.empty()) {
+			std::lock_guard<std::mutex> lock(built->mutex);
+			for(auto &pending : built->chunks)
+				remaining.push_back(std::move(pending));
+			built->chunks.swap(remaining);
+		}
+
+		return uploaded;
+	}
+
+	void ChunkTable::waitForChunks()
+	{
+		if(!built)
+			return;
+		std::unique_lock<std::mutex> lock(built->mutex);
+		built->finished.wait(lock, [this]() { return built->building == 0; });
+	}
+
+	void ChunkTable::chunkBounds(unsigned int index, glm::vec3 &lower, glm::vec3 &upper)
+	{
+		infworld::ChunkPos p = getPos(index);
+		float chunksz = chunkscale * float(PREC) / float(PREC + 1) * SCALE;
+		glm::vec3 center(float(p.z) * chunksz * 2.0f, 0.0f, float(p.x) * chunksz * 2.0f);
+		lower = glm::vec3(center.x - chunksz, minheights.at(index) * height * SCALE, center.z - chunksz);
+		upper = glm::vec3(center.x + chunksz, maxheights.at(index) * height * SCALE, center.z + chunksz);
+	}
+
+	//Builds the node for the cells [x0, x1) x [z0, z1) of the grid and
+	//returns its index, returns -1 if there are no chunks in those cells
+	int ChunkTable::buildCullNode(
+		const std::vector<int> &grid,
+		int x0,
+		int z0,
+		int x1,
+		int z1
 	) {
-		unsigned int drawCount = 0;
-		for(int i = 0; i < count(); i++) {
-			infworld::ChunkPos p = getPos(i);
+		if(x1 - x0 == 1 && z1 - z0 == 1) {
+			int slot = grid.at(x0 * size + z0);
+			if(slot < 0)
+				return -1;
+			CullNode leaf = { glm::vec3(0.0f), glm::vec3(0.0f), { -1, -1, -1, -1 }, slot };
+			chunkBounds(slot, leaf.lower, leaf.upper);
+			cullnodes.push_back(leaf);
+			return cullnodes.size() - 1;
+		}
+
+		int index = cullnodes.size();
+		cullnodes.push_back({ glm::vec3(0.0f), glm::vec3(0.0f), { -1, -1, -1, -1 }, -1 });
+		int xm = (x0 + x1 + 1) / 2, zm = (z0 + z1 + 1) / 2;
+		int ranges[4][4] = {
+			{ x0, z0, xm, zm },
+			{ xm, z0, x1, zm },
+			{ x0, zm, xm, z1 },
+			{ xm, zm, x1, z1 },
+		};
+		bool empty = true;
+		glm::vec3 lower(0.0f), upper(0.0f);
+		for(int i = 0; i < 4; i++) {
+			const int *r = ranges[i];
+			if(r[0] >= r[2] || r[1] >= r[3])
+				continue;
+			int child = buildCullNode(grid, r[0], r[1], r[2], r[3]);
+			cullnodes.at(index).children[i] = child;
+			if(child < 0)
+				continue;
+			//cullnodes may have been reallocated
+			const CullNode &node = cullnodes.at(child);
+			lower = empty ? node.lower : glm::min(lower, node.lower);
+			upper = empty ? node.upper : glm::max(upper, node.upper);
+			empty = false;
+		}
 
-			float x = float(p.z) * chunkscale * 2.0f * float(PREC) / float(PREC + 1);
-			float z = float(p.x) * chunkscale * 2.0f * float(PREC) / float(PREC + 1);	
+		if(empty) {
+			cullnodes.pop_back();
+			return -1;
+		}
+		cullnodes.at(index).lower = lower;
+		cullnodes.at(index).upper = upper;
+		return index;
+	}
 
-			geo::AABB chunkAABB = geo::AABB(
-				glm::vec3(x, 0.0f, z) * SCALE,
-				glm::vec3(chunkscale * 2.0f, HEIGHT * 2.0f, chunkscale * 2.0f) * SCALE
-			);
+	void ChunkTable::buildCullNodes()
+	{
+		cullnodes.clear();
+		strayslots.clear();
+		cullnodesdirty = false;
+		gridheights.assign(size * size, -std::numeric_limits<float>::infinity());
+		if(size == 0)
+			return;
 
-			if(!geo::intersectsFrustum(viewfrustum, chunkAABB))
+		//Place each chunk in the square around the center
+		int range = (size - 1) / 2;
+		std::vector<int> grid(size * size, -1);
+		for(unsigned int i = 0; i < chunkcount; i++) {
+			ChunkPos p = getPos(i);
+			int x = p.x - centerx + range, z = p.z - centerz + range;
+			if(x < 0 || z < 0 || x >= int(size) || z >= int(size) || grid.at(x * size + z) >= 0) {
+				strayslots.push_back(i);
 				continue;
+			}
+			grid.at(x * size + z) = i;
+			gridheights.at(x * size + z) = minheights.at(i) * height * SCALE;
+		}
+
+		//The root is always the first node
+		buildCullNode(grid, 0, 0, size, size);
+	}
+
+	void ChunkTable::cullNode(
+		int node,
+		bool inside,
+		float minrange,
+		float maxrange,
+		const glm::vec2 &center,
+		const geo::PackedFrustum &frustum,
+		const HorizonMap *horizon
+	) {
+		const CullNode &n = cullnodes.at(node);
+
+		//Skip regions that are entirely inside or outside of the ring
+		glm::vec2
+			lower = glm::vec2(n.lower.x, n.lower.z) - center,
+			upper = glm::vec2(n.upper.x, n.upper.z) - center;
+		glm::vec2 farthest = glm::max(glm::abs(lower), glm::abs(upper));
+		glm::vec2 closest = glm::max(glm::max(lower, -upper), glm::vec2(0.0f));
+		if(std::max(farthest.x, farthest.y) <= minrange)
+			return;
+		if(maxrange > 0.0f && std::max(closest.x, closest.y) >= maxrange)
+			return;
 
-			glm::mat4 transform = glm::mat4(1.0f);
-			transform = glm::scale(transform, glm::vec3(SCALE));
-			transform = glm::translate(transform, glm::vec3(x, 0.0f, z));
-			shader.uniformMat4x4("transform", transform);
-			bindVao(i);
-			glDrawElements(GL_TRIANGLES, CHUNK_VERT_COUNT, GL_UNSIGNED_INT, 0);
-			drawCount++;
+		//Frustum culling, once a region is entirely inside of the frustum
+		//nothing below it needs to be tested against it
+		if(!inside) {
+			geo::AABB box((n.lower + n.upper) * 0.5f, n.upper - n.lower);
+			geo::FrustumTest result = geo::testFrustum(frustum, box);
+			if(result == geo::OUTSIDE)
+				return;
+			inside = result == geo::INSIDE;
 		}
 
-		return drawCount;
+		if(horizon && horizon->occluded(n.lower, n.upper))
+			return;
+
+		if(n.slot >= 0) {
+			visible.push_back(n.slot);
+			return;
+		}
+		for(int child : n.children)
+			if(child >= 0)
+				cullNode(child, inside, minrange, maxrange, center, frustum, horizon);
+	}
+
+	const std::vector<unsigned int>& ChunkTable::cull(
+		float minrange,
+		float maxrange,
+		const glm::vec2 &center,
+		const geo::Frustum &viewfrustum,
+		const HorizonMap *horizon
+	) {
+		visible.clear();
+		if(cullnodesdirty)
+			buildCullNodes();
+
+		geo::PackedFrustum frustum = geo::packFrustum(viewfrustum);
+		if(!cullnodes.empty())
+			cullNode(0, false, minrange, maxrange, center, frustum, horizon);
+
+		for(unsigned int i : strayslots) {
+			glm::vec3 lower, upper;
+			chunkBounds(i, lower, upper);
+			glm::vec2 dist = glm::abs((glm::vec2(lower.x, lower.z) + glm::vec2(upper.x, upper.z)) * 0.5f - center);
+			float halfwidth = (upper.x - lower.x) * 0.5f;
+			if(std::max(dist.x, dist.y) + halfwidth <= minrange)
+				continue;
+			if(maxrange > 0.0f && std::max(dist.x, dist.y) - halfwidth >= maxrange)
+				continue;
+			geo::AABB box((lower + upper) * 0.5f, upper - lower);
+			if(!geo::intersectsFrustum(frustum, box))
+				continue;
+			if(horizon && horizon->occluded(lower, upper))
+				continue;
+			visible.push_back(i);
+		}
+
+		return visible;
 	}
 
 	unsigned int ChunkTable::draw(
 		ShaderProgram &shader,
-		unsigned int minrange,
 		const geo::Frustum &viewfrustum
 	) {
-		unsigned int drawCount = 0;
-		for(int i = 0; i < count(); i++) {
-			infworld::ChunkPos p = getPos(i);
+		return draw(shader, 0.0f, -1.0f, glm::vec2(0.0f), viewfrustum);
+	}
 
-			if(std::abs(p.x - centerx) < minrange && 
-				std::abs(p.z - centerz) < minrange)
-				continue;
+	unsigned int ChunkTable::draw(
+		ShaderProgram &shader,
+		float minrange,
+		float maxrange,
+		const glm::vec2 &center,
+		const geo::Frustum &viewfrustum,
+		const HorizonMap *horizon
+	) {
+		cull(minrange, maxrange, center, viewfrustum, horizon);
+		backend->draw(shader, visible);
+		return visible.size();
+	}
 
-			float x = float(p.z) * chunkscale * 2.0f * float(PREC) / float(PREC + 1);
-			float z = float(p.x) * chunkscale * 2.0f * float(PREC) / float(PREC + 1);	
-		
-			geo::AABB chunkAABB = geo::AABB(
-				glm::vec3(x, 0.0f, z) * SCALE,
-				glm::vec3(chunkscale * 2.0f, HEIGHT * 2.0f, chunkscale * 2.0f) * SCALE
-			);
-			
-			//Frustum culling
-			if(!geo::intersectsFrustum(viewfrustum, chunkAABB))
-				continue;
+	float ChunkTable::lowestHeight(const glm::vec2 &lower, const glm::vec2 &upper)
+	{
+		if(cullnodesdirty)
+			buildCullNodes();
+		if(size == 0)
+			return -std::numeric_limits<float>::infinity();
 
-			glm::mat4 transform = glm::mat4(1.0f);
-			transform = glm::scale(transform, glm::vec3(SCALE));
-			transform = glm::translate(transform, glm::vec3(x, 0.0f, z));
-			shader.uniformMat4x4("transform", transform);
-			bindVao(i);
-			glDrawElements(GL_TRIANGLES, CHUNK_VERT_COUNT, GL_UNSIGNED_INT, 0);
-			drawCount++;
-		}
+		//Chunk x is along the z axis and chunk z is along the x axis
+		float chunkwidth = chunkscale * 2.0f * float(PREC) / float(PREC + 1) * SCALE;
+		int range = (size - 1) / 2;
+		int
+			x0 = int(floorf(lower.y / chunkwidth + 0.5f)) - centerx + range,
+			x1 = int(floorf(upper.y / chunkwidth + 0.5f)) - centerx + range,
+			z0 = int(floorf(lower.x / chunkwidth + 0.5f)) - centerz + range,
+			z1 = int(floorf(upper.x / chunkwidth + 0.5f)) - centerz + range;
+		if(x0 < 0 || z0 < 0 || x1 >= int(size) || z1 >= int(size))
+			return -std::numeric_limits<float>::infinity();
+
+		float lowest = std::numeric_limits<float>::infinity();
+		for(int x = x0; x <= x1; x++)
+			for(int z = z0; z <= z1; z++)
+				lowest = std::min(lowest, gridheights.at(x * size + z));
+		return lowest;
+	}
 
-		return drawCount;
+	float ChunkTable::lodRange() const
+	{
+		float chunkwidth = chunkscale * 2.0f * float(PREC) / float(PREC + 1) * SCALE;
+		//The camera is always in the center chunk of the table so the
+		//table covers at least range() chunks around it
+		return (float(range()) - 0.5f) * chunkwidth;
+	}
+
+	unsigned int ChunkTable::version() const
+	{
+		return changes;
 	}
 
 	float ChunkTable::scale() const
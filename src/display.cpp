@@ -2,6 +2,7 @@
 #include "assets.hpp"
 #include "app.hpp"
 #include "infworld.hpp"
+#include "plants.hpp"
 #include <glad/glad.h>
 #include <glm/gtc/matrix_transform.hpp>
 
@@ -18,381 +19,554 @@ constexpr float MINIMAP_SIZE = 80.0f;
 
 namespace gobjs = gameobjects;
 
+//Uniform block binding of FrameData, GlobalVals is at binding 0
+constexpr unsigned int FRAME_DATA_BINDING = 1;
+
+//Has the same layout as the FrameData uniform block in the shaders (std140
+//pads each vec3 to the size of a vec4)
+struct FrameData {
+	glm::mat4 persp;
+	glm::mat4 view;
+	glm::vec4 camerapos;
+	glm::vec4 lightdir;
+};
+
+unsigned int frameDataUbo = 0;
+//The transform of a game object is made of a translation, a scale and
+//rotations so the inverse transpose used for the normals is just the
+//transform with each row divided by the scale squared
+glm::mat3 getNormalMat(const glm::mat4 &transform, const glm::vec3 &scale)
+{
+	glm::mat3 normal = glm::mat3(transform);
+	for(int i = 0; i < 3; i++)
+		for(int j = 0; j < 3; j++)
+			normal[i][j] /= scale[j] * scale[j];
+	return normal;
+}
+
+unsigned int addInstance(
+	gfx::RenderQueue &queue,
+	const glm::mat4 &transform,
+	const glm::mat3 &normalmat,
+	const glm::vec4 &extra = glm::vec4(0.0f)
+) {
+	return queue.addInstance({ transform, normalmat, extra });
+}
+
+//Transform of the propeller relative to the plane
+glm::mat4 getPropellerTransform(float totalTime)
+{
+	glm::mat4 propellerTransform = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, 13.888f));
+	float rotation = totalTime * 16.0f;
+	return glm::rotate(propellerTransform, rotation, glm::vec3(0.0f, 0.0f, 1.0f));
+}
+//A packet that draws a vao with a texture bound
+gfx::DrawPacket makePacket(
+	const std::string &shadername,
+	const std::string &texturename,
+	const std::string &vaoname
+) {
+	gfx::DrawPacket packet;
+	packet.shader = &SHADERS->getShader(shadername);
+	assets::TextureInfo texture = TEXTURES->getTexture(texturename);
+	packet.texture = texture.id;
+	packet.texturetarget = texture.target;
+	packet.vao = &VAOS->getVao(vaoname);
+	return packet;
+}
+
+//Sets the specular factor of the textured and trail shaders
+std::function<void(ShaderProgram&)> specularFactor(float factor)
+{
+	return [factor](ShaderProgram &shader) {
+		shader.uniformFloat("specularfactor", factor);
+	};
+}
+
+//Submits the instances that were added to the queue since 'first' as one
+//draw, each instance is drawn 'repeat' times
+void submitInstances(
+	gfx::RenderQueue &queue,
+	gfx::DrawPacket packet,
+	unsigned int first,
+	unsigned int repeat = 1
+) {
+	packet.firstinstance = first;
+	packet.uploadcount = queue.instanceCount() - first;
+	packet.instancecount = packet.uploadcount * repeat;
+	if(packet.uploadcount > 0)
+		queue.submit(packet);
+}
+
+//Adds every enemy in the list to the queue, returns the index of the first
+unsigned int addEnemies(gfx::RenderQueue &queue, const gobjs::EnemyColumns &enemies)
+{
+	unsigned int first = queue.instanceCount();
+	for(const auto &enemy : enemies.transforms) {
+		glm::mat4 transform = enemy.getTransformMat();
+		addInstance(queue, transform, getNormalMat(transform, enemy.scale));
+	}
+	return first;
+}
+
+void submitEnemies(
+	gfx::RenderQueue &queue,
+	const gobjs::EnemyColumns &enemies,
+	const std::string &texturename,
+	const std::string &vaoname,
+	float specular,
+	unsigned int state = gfx::STATE_DEFAULT
+) {
+	gfx::DrawPacket packet = makePacket("textured", texturename, vaoname);
+	packet.state = state;
+	packet.uniforms = specularFactor(specular);
+	submitInstances(queue, packet, addEnemies(queue, enemies));
+}
+
 namespace gfx {
-	void displaySkybox() 
+	void initFrameData()
+	{
+		glGenBuffers(1, &frameDataUbo);
+		glBindBuffer(GL_UNIFORM_BUFFER, frameDataUbo);
+		glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameData), nullptr, GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+		const char* shaders[] = {
+			"terrain",
+			"water",
+			"skybox",
+			"tree",
+			"impostor",
+			"textured",
+			"explosion",
+			"trail",
+		};
+		for(const char *name : shaders)
+			SHADERS->getShader(name).setBinding("FrameData", FRAME_DATA_BINDING);
+		glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_DATA_BINDING, frameDataUbo);
+	}
+
+	void updateFrameData(
+		const glm::mat4 &persp,
+		const glm::mat4 &view,
+		const glm::vec3 &camerapos
+	) {
+		FrameData framedata = {
+			persp,
+			view,
+			glm::vec4(camerapos, 1.0f),
+			glm::vec4(LIGHT, 0.0f),
+		};
+		glBindBuffer(GL_UNIFORM_BUFFER, frameDataUbo);
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameData), &framedata);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	}
+
+	void updateFrameData()
 	{
 		State* state = State::get();
 		Camera& cam = state->getCamera();
+		updateFrameData(state->getPerspective(), cam.viewMatrix(), cam.position);
+	}
 
-		//Draw skybox
-		glCullFace(GL_FRONT);
-		TEXTURES->bindTexture("skybox", GL_TEXTURE0);	
-		ShaderProgram& skyboxShader = SHADERS->getShader("skybox");
-		skyboxShader.use();
-		
-		//Uniforms
-		skyboxShader.uniformInt("skybox", 0);
-		skyboxShader.uniformMat4x4("persp", state->getPerspective());
-		glm::mat4 skyboxView = glm::mat4(glm::mat3(cam.viewMatrix()));	
-		skyboxShader.uniformMat4x4("view", skyboxView);
-
-		VAOS->bind("cube");
-		VAOS->draw();
-		glCullFace(GL_BACK);
+	void displaySkybox(RenderQueue &queue)
+	{
+		DrawPacket packet = makePacket("skybox", "skybox", "cube");
+		packet.layer = LAYER_SKY;
+		//We are inside of the cube
+		packet.state = STATE_CULL_FRONT;
+		queue.submit(packet);
 	}
 
-	void displayWater(float totalTime)
+	void displayWater(RenderQueue &queue, float totalTime)
 	{
 		State* state = State::get();
 		Camera& cam = state->getCamera();
-		
-		VAOS->bind("quad");
+
 		const int waterrange = 4;
 		const int count = (waterrange * 2 + 1) * (waterrange * 2 + 1);
 		const float quadscale = CHUNK_SZ * 32.0f * SCALE;
-		//Draw water
-		ShaderProgram& waterShader = SHADERS->getShader("water");
-		waterShader.use();
-		TEXTURES->bindTexture("watermaps", GL_TEXTURE0);	
-		waterShader.uniformInt("range", waterrange);
-		waterShader.uniformFloat("scale", quadscale);
-		waterShader.uniformInt("waternormals", 0);
-		waterShader.uniformInt("waterdudv", 1);
-		waterShader.uniformMat4x4("persp", state->getPerspective());
-		waterShader.uniformMat4x4("view", cam.viewMatrix());
-		waterShader.uniformVec3("lightdir", glm::normalize(glm::vec3(-1.0f)));
-		waterShader.uniformVec3("camerapos", cam.position);
-		waterShader.uniformFloat("time", totalTime);
 		glm::mat4 transform = glm::mat4(1.0f);
 		transform = glm::translate(transform, glm::vec3(cam.position.x, 0.0f, cam.position.z));
 		transform = glm::scale(transform, glm::vec3(quadscale));
-		waterShader.uniformMat4x4("transform", transform);
-		VAOS->drawInstanced(count);
+		//Draw water
+		DrawPacket packet = makePacket("water", "watermaps", "quad");
+		packet.layer = LAYER_TRANSPARENT;
+		packet.instancecount = count;
+		packet.uniforms = [=](ShaderProgram &waterShader) {
+			waterShader.uniformInt("range", waterrange);
+			waterShader.uniformFloat("scale", quadscale);
+			waterShader.uniformFloat("time", totalTime);
+			waterShader.uniformMat4x4("transform", transform);
+		};
+		queue.submit(packet);
 	}
 
 	void generateDecorationOffsets(infworld::DecorationTable &decorations)
-	{
-		decorations.generateOffsets(infworld::PINE_TREE, VAOS->getVao("pinetree"), 0, 4);
-		decorations.generateOffsets(infworld::PINE_TREE, VAOS->getVao("pinetreelowdetail"), 4, 999);
-		decorations.generateOffsets(infworld::TREE, VAOS->getVao("tree"), 0, 4);
-		decorations.generateOffsets(infworld::TREE, VAOS->getVao("treelowdetail"), 4, 8);
-	}
-
-	void displayDecorations(
-		infworld::DecorationTable &decorations,
-		float totalTime
-	) {
-		State* state = State::get();
-		Camera& cam = state->getCamera();
-
-		glDisable(GL_CULL_FACE);
-		//Display trees	
-		ShaderProgram& treeShader = SHADERS->getShader("tree");
-		treeShader.use();
-		treeShader.uniformMat4x4("persp", state->getPerspective());
-		treeShader.uniformMat4x4("view", cam.viewMatrix());
-		treeShader.uniformVec3("lightdir", glm::normalize(glm::vec3(-1.0f)));
-		treeShader.uniformVec3("camerapos", cam.position);
-		treeShader.uniformFloat("time", totalTime);
-		treeShader.uniformFloat("windstrength", SCALE * 3.0f);
-		treeShader.uniformMat4x4(
-			"transform",
-			glm::scale(glm::mat4(1.0f), glm::vec3(SCALE * 2.5f))
-		);
-		//treeShader.uniformFloat("specularfactor", 0.0f);
-		treeShader.uniformVec3("camerapos", cam.position);
-		//Draw pine trees
-		TEXTURES->bindTexture("pinetree", GL_TEXTURE0);
-		VAOS->bind("pinetree");
-		decorations.drawDecorations(VAOS->getVao("pinetree"));
-		VAOS->bind("pinetreelowdetail");
-		decorations.drawDecorations(VAOS->getVao("pinetreelowdetail"));
-		//Draw trees
-		TEXTURES->bindTexture("tree", GL_TEXTURE0);
-		VAOS->bind("tree");
-		decorations.drawDecorations(VAOS->getVao("tree"));
-		VAOS->bind("treelowdetail");
-		decorations.drawDecorations(VAOS->getVao("treelowdetail"));
-		glEnable(GL_CULL_FACE);
-	}
-
-	unsigned int displayTerrain(infworld::ChunkTable *chunktables, int maxlod, float lodscale)
 	{
 		State* state = State::get();
 		Camera& cam = state->getCamera();
-		ShaderProgram& terrainShader = SHADERS->getShader("terrain");
-
-		//Draw terrain
-		terrainShader.use();
-		//Textures
-		TEXTURES->bindTexture("terrain", GL_TEXTURE0);
-		terrainShader.uniformInt("terraintexture", 0);
-		//uniforms
-		terrainShader.uniformMat4x4("persp", state->getPerspective());
-		terrainShader.uniformMat4x4("view", cam.viewMatrix());
-		terrainShader.uniformVec3("lightdir", glm::normalize(glm::vec3(-1.0f)));
-		terrainShader.uniformVec3("camerapos", cam.position);
-		unsigned int drawCount = 0;	
-
-		geo::Frustum viewfrustum = cam.getViewFrustum(
+		geo::PackedFrustum viewfrustum = geo::packFrustum(cam.getViewFrustum(
 			state->getZnear(),
 			state->getZfar(),
 			state->getAspect(),
 			state->getFovy()
-		);
+		));
+		glm::vec3 pos = cam.position;
+
+		decorations.generateOffsets(infworld::PINE_TREE, VAOS->getVao("pinetree"), 0, 4, pos, viewfrustum);
+		decorations.generateOffsets(infworld::PINE_TREE, VAOS->getVao("pinetreelowdetail"), 4, 7, pos, viewfrustum);
+		decorations.generateOffsets(infworld::PINE_TREE, VAOS->getVao("pinetreeimpostor"), 7, 999, pos, viewfrustum);
+		decorations.generateOffsets(infworld::TREE, VAOS->getVao("tree"), 0, 4, pos, viewfrustum);
+		decorations.generateOffsets(infworld::TREE, VAOS->getVao("treelowdetail"), 4, 7, pos, viewfrustum);
+		decorations.generateOffsets(infworld::TREE, VAOS->getVao("treeimpostor"), 7, 999, pos, viewfrustum);
+	}
 
-		infworld::ChunkPos center = chunktables[0].getCenter();
-		glm::vec2 centerpos = glm::vec2(float(center.z), float(center.x));
-		centerpos *= float(PREC) / float(PREC + 1);
-		centerpos *= chunktables[0].scale() * SCALE * 2.0f;
-		terrainShader.uniformVec2("center", centerpos);
+	void bakeTreeImpostors()
+	{
+		//The impostors are baked from the most detailed models, each one
+		//is drawn with the texture that has the same name
+		const char *names[] = { "pinetree", "tree" };
+		//These were cached by game::loadAssets
+		mesh::ModelCache cache(modelCachePath);
+		const mesh::Model models[] = {
+			plants::createPineTree(cache, 8),
+			plants::createTree(cache, 6),
+		};
+		const unsigned int rows = sizeof(names) / sizeof(names[0]);
+		const unsigned int width = plants::IMPOSTOR_VIEWS * plants::IMPOSTOR_RESOLUTION;
+		const unsigned int height = rows * plants::IMPOSTOR_RESOLUTION;
+
+		unsigned int atlas;
+		glGenTextures(1, &atlas);
+		glBindTexture(GL_TEXTURE_2D, atlas);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexImage2D(
+			GL_TEXTURE_2D,
+			0,
+			GL_RGBA,
+			width,
+			height,
+			0,
+			GL_RGBA,
+			GL_UNSIGNED_BYTE,
+			nullptr
+		);
 
-		float mindist = 0.0f;
-		for(int i = 0; i < maxlod; i++) {
-			terrainShader.uniformVec3("testcolor", TERRAIN_LOD_COLORS[i]);
-			terrainShader.uniformFloat("chunksz", chunktables[i].scale());
+		unsigned int fbo, depth;
+		glGenFramebuffers(1, &fbo);
+		glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, atlas, 0);
+		glGenRenderbuffers(1, &depth);
+		glBindRenderbuffer(GL_RENDERBUFFER, depth);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+		if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+			fprintf(stderr, "Failed to create framebuffer for tree impostors\n");
+
+		int viewport[4];
+		glGetIntegerv(GL_VIEWPORT, viewport);
+		bool depthtest = glIsEnabled(GL_DEPTH_TEST);
+		bool cullface = glIsEnabled(GL_CULL_FACE);
+		glEnable(GL_DEPTH_TEST);
+		glDisable(GL_CULL_FACE);
+		//Anything that is not covered by a tree is transparent and will
+		//be discarded when the impostor is drawn
+		glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-			if(i < maxlod - 1) {
-				float chunkscale = 
-					chunktables[i].scale() * 
-					2.0f * 
-					float(PREC) / float(PREC + 1);
-				float range = float(chunktables[i].range()) - 0.5f;
-				//Slight amount of overlap to mitigate cracks in terrain
-				//We increase this amount due to the terrain becoming less precise
-				//and more likely to have cracks
-				float d = 8.0f * float(i) + 4.0f;
-				float maxrange = chunkscale * range * SCALE + d;	
-			
-				terrainShader.uniformFloat("minrange", mindist);
-				terrainShader.uniformFloat("maxrange", maxrange);
-
-				mindist = maxrange - 2.0f * d;
-			}
-			else {
-				terrainShader.uniformFloat("minrange", mindist);
-				terrainShader.uniformFloat("maxrange", -1.0f);
+		ShaderProgram& treeShader = SHADERS->getShader("tree");
+		treeShader.use();
+		treeShader.uniformFloat("time", 0.0f);
+		treeShader.uniformFloat("windstrength", 0.0f);
+		treeShader.uniformMat4x4("transform", glm::mat4(1.0f));
+		for(unsigned int row = 0; row < rows; row++) {
+			plants::ImpostorBounds bounds = plants::findImpostorBounds(models[row]);
+			//The tree vaos read the instance offsets from a buffer, this
+			//one leaves the offset at zero
+			Vao vao = createModelVao(models[row]);
+			TEXTURES->bindTexture(names[row], GL_TEXTURE0);
+			glm::mat4 persp = plants::impostorProjection(bounds);
+			for(unsigned int i = 0; i < plants::IMPOSTOR_VIEWS; i++) {
+				glViewport(
+					i * plants::IMPOSTOR_RESOLUTION,
+					row * plants::IMPOSTOR_RESOLUTION,
+					plants::IMPOSTOR_RESOLUTION,
+					plants::IMPOSTOR_RESOLUTION
+				);
+				glm::mat4 view = plants::impostorView(bounds, i);
+				updateFrameData(persp, view, glm::vec3(glm::inverse(view)[3]));
+				glDrawElements(GL_TRIANGLES, vao.vertcount, GL_UNSIGNED_INT, 0);
 			}
+			destroyVao(vao);
 
-			if(i == 0)
-				drawCount += chunktables[i].draw(terrainShader, viewfrustum);
-			else {
-				int minrange = chunktables[i - 1].range() / int(lodscale);
-				drawCount += chunktables[i].draw(terrainShader, minrange - 1, viewfrustum);
-			}
+			std::string name = std::string(names[row]) + "impostor";
+			VAOS->add(name, plants::createImpostorModel(bounds, row, rows));
 		}
-
-		return drawCount;
+		TEXTURES->add("treeimpostors", { atlas, GL_TEXTURE_2D });
+
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		glDeleteRenderbuffers(1, &depth);
+		glDeleteFramebuffers(1, &fbo);
+		glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+		if(!depthtest)
+			glDisable(GL_DEPTH_TEST);
+		if(cullface)
+			glEnable(GL_CULL_FACE);
+		glBindVertexArray(0);
 	}
 
-	void displayPlayerPlane(float totalTime, const game::Transform &transform)
-	{
-		State* state = State::get();
-		Camera& cam = state->getCamera();
+	void displayDecorations(
+		RenderQueue &queue,
+		infworld::DecorationTable &decorations,
+		float totalTime
+	) {
+		//Cull the trees and pick their level of detail
+		generateDecorationOffsets(decorations);
+
+		auto submitTrees = [&](
+			const char *shadername,
+			const char *texturename,
+			const char *vaoname,
+			std::function<void(ShaderProgram&)> uniforms
+		) {
+			DrawPacket packet = makePacket(shadername, texturename, vaoname);
+			packet.state = STATE_NO_CULL;
+			packet.uniforms = uniforms;
+			infworld::DecorationTable *table = &decorations;
+			const Vao *vao = packet.vao;
+			packet.draw = [table, vao](ShaderProgram &) {
+				table->drawDecorations(*vao);
+			};
+			queue.submit(packet);
+		};
+
+		auto treeUniforms = [totalTime](ShaderProgram &treeShader) {
+			treeShader.uniformFloat("time", totalTime);
+			treeShader.uniformFloat("windstrength", SCALE * 3.0f);
+			treeShader.uniformMat4x4(
+				"transform",
+				glm::scale(glm::mat4(1.0f), glm::vec3(SCALE * 2.5f))
+			);
+		};
+		//Draw pine trees
+		submitTrees("tree", "pinetree", "pinetree", treeUniforms);
+		submitTrees("tree", "pinetree", "pinetreelowdetail", treeUniforms);
+		//Draw trees
+		submitTrees("tree", "tree", "tree", treeUniforms);
+		submitTrees("tree", "tree", "treelowdetail", treeUniforms);
+		//Draw far away trees
+		auto impostorUniforms = [](ShaderProgram &impostorShader) {
+			impostorShader.uniformMat4x4(
+				"transform",
+				glm::scale(glm::mat4(1.0f), glm::vec3(SCALE * 2.5f))
+			);
+		};
+		submitTrees("impostor", "treeimpostors", "pinetreeimpostor", impostorUniforms);
+		submitTrees("impostor", "treeimpostors", "treeimpostor", impostorUniforms);
+	}
 
-		ShaderProgram& shader = SHADERS->getShader("textured");	
+	void displayTerrain(
+		RenderQueue &queue,
+		infworld::ChunkTable *chunktables,
+		int maxlod,
+		unsigned int &drawcount,
+		const infworld::HorizonMap *horizon
+	) {
+		ShaderProgram& terrainShader = SHADERS->getShader("terrain");
+		//These are set for each level of detail
+		static const Uniform<glm::vec3>
+			testcoloruniform = terrainShader.getUniform<glm::vec3>("testcolor");
+		static const Uniform<float>
+			chunkszuniform = terrainShader.getUniform<float>("chunksz"),
+			minrangeuniform = terrainShader.getUniform<float>("minrange"),
+			maxrangeuniform = terrainShader.getUniform<float>("maxrange"),
+			morphstartuniform = terrainShader.getUniform<float>("morphstart"),
+			morphenduniform = terrainShader.getUniform<float>("morphend");
+
+		//Draw terrain, the chunk tables bind their own vaos
+		DrawPacket packet;
+		packet.shader = &terrainShader;
+		assets::TextureInfo texture = TEXTURES->getTexture("terrain");
+		packet.texture = texture.id;
+		packet.texturetarget = texture.target;
+		packet.draw = [chunktables, maxlod, horizon, &drawcount](ShaderProgram &terrainShader) {
+			State* state = State::get();
+			Camera& cam = state->getCamera();
+			geo::Frustum viewfrustum = cam.getViewFrustum(
+				state->getZnear(),
+				state->getZfar(),
+				state->getAspect(),
+				state->getFovy()
+			);
+
+			//Each level of detail is drawn in a square ring around the camera
+			//and the rings meet exactly. Near the outer edge of a ring the
+			//vertices are morphed into the shape of the next level of detail
+			//(which has half the resolution) so that there are no cracks.
+			glm::vec2 center = glm::vec2(cam.position.x, cam.position.z);
+			float minrange = 0.0f;
+			for(int i = 0; i < maxlod; i++) {
+				terrainShader.uniformVec3(testcoloruniform, TERRAIN_LOD_COLORS[i]);
+				terrainShader.uniformFloat(chunkszuniform, chunktables[i].scale());
+
+				float chunkwidth = 
+					chunktables[i].scale() * 
+					2.0f * 
+					float(PREC) / float(PREC + 1) *
+					SCALE;
+				float maxrange = -1.0f, morphend = -1.0f;
+				if(i < maxlod - 1) {
+					maxrange = chunktables[i].lodRange();
+					//Vertices are fully morphed a little before the edge so
+					//that the triangles that cross it match exactly
+					morphend = maxrange - 2.0f * chunkwidth / float(PREC);
+				}
+				terrainShader.uniformFloat(minrangeuniform, minrange);
+				terrainShader.uniformFloat(maxrangeuniform, maxrange);
+				terrainShader.uniformFloat(morphstartuniform, morphend - chunkwidth);
+				terrainShader.uniformFloat(morphenduniform, morphend);
+
+				drawcount += chunktables[i].draw(
+					terrainShader,
+					minrange,
+					maxrange,
+					center,
+					viewfrustum,
+					horizon
+				);
+				minrange = maxrange;
+			}
+		};
+		queue.submit(packet);
+	}
 
-		shader.use();
-		shader.uniformMat4x4("persp", state->getPerspective());
-		shader.uniformMat4x4("view", cam.viewMatrix());
-		shader.uniformVec3("lightdir", LIGHT);
-		shader.uniformVec3("camerapos", cam.position);
-	
+	void displayPlayerPlane(
+		RenderQueue &queue,
+		float totalTime,
+		const game::Transform &transform
+	) {
 		//Display plane body
 		glm::mat4 transformMat = transform.getTransformMat();
-		glm::mat4 normal = glm::mat3(glm::transpose(glm::inverse(transformMat)));
-		TEXTURES->bindTexture("plane", GL_TEXTURE0);	
-		shader.uniformFloat("specularfactor", 0.5f);	
-		shader.uniformMat4x4("transform", transformMat);
-		shader.uniformMat3x3("normalmat", normal);
-		VAOS->bind("plane");
-		VAOS->draw();
-
-		//Display propeller
-		TEXTURES->bindTexture("propeller", GL_TEXTURE0);
-		glm::mat4 propellerTransform = glm::mat4(1.0f);
-		propellerTransform = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, 13.888f));
-		float rotation = totalTime * 16.0f;
-		propellerTransform = glm::rotate(propellerTransform, rotation, glm::vec3(0.0f, 0.0f, 1.0f));
-		propellerTransform = transformMat * propellerTransform;
-		normal = glm::mat3(glm::transpose(glm::inverse(propellerTransform)));
-		shader.uniformFloat("specularfactor", 0.0f);
-		shader.uniformMat4x4("transform", propellerTransform);
-		shader.uniformMat3x3("normalmat", normal);
-		VAOS->bind("propeller");
-		VAOS->draw();
+		glm::mat3 normal = getNormalMat(transformMat, transform.scale);
+		DrawPacket body = makePacket("textured", "plane", "plane");
+		body.uniforms = specularFactor(0.5f);
+		submitInstances(queue, body, addInstance(queue, transformMat, normal));
+
+		//Display propeller, it only rotates around its own axis so its
+		//normals are rotated the same way
+		glm::mat4 propellerTransform = getPropellerTransform(totalTime);
+		DrawPacket propeller = makePacket("textured", "propeller", "propeller");
+		propeller.uniforms = specularFactor(0.0f);
+		unsigned int first = addInstance(
+			queue,
+			transformMat * propellerTransform,
+			normal * glm::mat3(propellerTransform)
+		);
+		submitInstances(queue, propeller, first);
 	}
 
-	void displayExplosions(const std::vector<gobjs::Explosion> &explosions)
-	{
+	void displayExplosions(
+		RenderQueue &queue,
+		const std::vector<gobjs::Explosion> &explosions
+	) {
 		if(explosions.empty())
 			return;
 
-		State* state = State::get();
-
-		glDisable(GL_CULL_FACE);
-		glDepthMask(GL_FALSE);
-		VAOS->bind("quad");
-		SHADERS->use("explosion");
-		TEXTURES->bindTexture("explosion_particle", GL_TEXTURE0);
 		ShaderProgram& shader = SHADERS->getShader("explosion");
-		shader.uniformMat4x4("persp", state->getPerspective());
-		shader.uniformMat4x4("view", state->getCamera().viewMatrix());
-		for(const auto &explosion : explosions) {
-			if(!explosion.visible)
-				continue;
-			shader.uniformFloat("time", explosion.timePassed);
-			shader.uniformFloat("scale", explosion.explosionScale);
-			shader.uniformMat4x4("transform", explosion.transform.getTransformMat());
-			VAOS->drawInstanced(128);
-		}
-		glDepthMask(GL_TRUE);
-		glEnable(GL_CULL_FACE);
+		//Shaders are never reloaded so the handles only need to be found once
+		static const Uniform<float>
+			timeuniform = shader.getUniform<float>("time"),
+			scaleuniform = shader.getUniform<float>("scale");
+		static const Uniform<glm::mat4>
+			transformuniform = shader.getUniform<glm::mat4>("transform");
+		DrawPacket packet = makePacket("explosion", "explosion_particle", "quad");
+		packet.layer = LAYER_EFFECTS;
+		packet.state = STATE_NO_CULL | STATE_NO_DEPTH_WRITE;
+		const std::vector<gobjs::Explosion> *list = &explosions;
+		const Vao *vao = packet.vao;
+		packet.draw = [list, vao](ShaderProgram &shader) {
+			for(const auto &explosion : *list) {
+				if(!explosion.visible)
+					continue;
+				shader.uniformFloat(timeuniform, explosion.timePassed);
+				shader.uniformFloat(scaleuniform, explosion.explosionScale);
+				shader.uniformMat4x4(transformuniform, explosion.transform.getTransformMat());
+				glDrawElementsInstanced(GL_TRIANGLES, vao->vertcount, GL_UNSIGNED_INT, 0, 128);
+			}
+		};
+		queue.submit(packet);
 	}
 
-	void displayBalloons(const std::vector<gameobjects::Enemy> &balloons)
-	{
-		if(balloons.empty())
-			return;
-
-		State* state = State::get();
-
-		glDisable(GL_CULL_FACE);
-		VAOS->bind("balloon");
-		SHADERS->use("textured");
-		TEXTURES->bindTexture("balloon", GL_TEXTURE0);
-		ShaderProgram& shader = SHADERS->getShader("textured");
-		shader.uniformMat4x4("persp", state->getPerspective());
-		shader.uniformMat4x4("view", state->getCamera().viewMatrix());
-		shader.uniformFloat("specularfactor", 0.0f);
-		shader.uniformVec3("lightdir", LIGHT);
-		shader.uniformVec3("camerapos", state->getCamera().position);
-		for(const auto &balloon : balloons) {
-			glm::mat4 transform = balloon.transform.getTransformMat();
-			glm::mat3 normal = glm::mat3(glm::transpose(glm::inverse(transform)));
-			shader.uniformMat4x4("transform", transform);
-			shader.uniformMat3x3("normalmat", normal);
-			VAOS->draw();
-		}
-		glEnable(GL_CULL_FACE);
+	void displayBalloons(
+		RenderQueue &queue,
+		const gameobjects::Balloons &balloons
+	) {
+		submitEnemies(queue, balloons, "balloon", "balloon", 0.0f, STATE_NO_CULL);
 	}
 
-	void displayBlimps(const std::vector<gameobjects::Enemy> &blimps)
-	{
-		if(blimps.empty())
-			return;
-	
-		State* state = State::get();
-
-		VAOS->bind("blimp");
-		SHADERS->use("textured");
-		TEXTURES->bindTexture("blimp", GL_TEXTURE0);
-		ShaderProgram& shader = SHADERS->getShader("textured");
-		shader.uniformMat4x4("persp", state->getPerspective());
-		shader.uniformMat4x4("view", state->getCamera().viewMatrix());
-		shader.uniformFloat("specularfactor", 0.1f);
-		shader.uniformVec3("lightdir", LIGHT);
-		shader.uniformVec3("camerapos", state->getCamera().position);
-		for(const auto &blimp : blimps) {
-			glm::mat4 transform = blimp.transform.getTransformMat();
-			glm::mat3 normal = glm::mat3(glm::transpose(glm::inverse(transform)));
-			shader.uniformMat4x4("transform", transform);
-			shader.uniformMat3x3("normalmat", normal);
-			VAOS->draw();
-		}
+	void displayBlimps(
+		RenderQueue &queue,
+		const gameobjects::Blimps &blimps
+	) {
+		submitEnemies(queue, blimps, "blimp", "blimp", 0.1f);
 	}
 
-	void displayUfos(const std::vector<gameobjects::Enemy> &ufos)
-	{
-		if(ufos.empty())
-			return;
-
-		State* state = State::get();
-	
-		VAOS->bind("ufo");
-		SHADERS->use("textured");
-		TEXTURES->bindTexture("ufo", GL_TEXTURE0);
-		ShaderProgram& shader = SHADERS->getShader("textured");
-		shader.uniformMat4x4("persp", state->getPerspective());
-		shader.uniformMat4x4("view", state->getCamera().viewMatrix());
-		shader.uniformFloat("specularfactor", 1.0f);
-		shader.uniformVec3("lightdir", LIGHT);
-		shader.uniformVec3("camerapos", state->getCamera().position);
-		for(const auto &ufo : ufos) {
-			glm::mat4 transform = ufo.transform.getTransformMat();
-			glm::mat3 normal = glm::mat3(glm::transpose(glm::inverse(transform)));
-			shader.uniformMat4x4("transform", transform);
-			shader.uniformMat3x3("normalmat", normal);
-			VAOS->draw();
-		}
+	void displayUfos(
+		RenderQueue &queue,
+		const gameobjects::Ufos &ufos
+	) {
+		submitEnemies(queue, ufos, "ufo", "ufo", 1.0f);
 	}
 
-	void displayPlanes(float totalTime, const std::vector<gameobjects::Enemy> &planes)
-	{
+	void displayPlanes(
+		RenderQueue &queue,
+		float totalTime,
+		const gameobjects::Planes &planes
+	) {
 		if(planes.empty())
 			return;
 
-		State* state = State::get();
-
-		VAOS->bind("plane");
-		SHADERS->use("textured");
-		TEXTURES->bindTexture("enemy_plane", GL_TEXTURE0);
-		ShaderProgram& shader = SHADERS->getShader("textured");
-		shader.uniformMat4x4("persp", state->getPerspective());
-		shader.uniformMat4x4("view", state->getCamera().viewMatrix());
-		shader.uniformFloat("specularfactor", 0.5f);
-		shader.uniformVec3("lightdir", LIGHT);
-		shader.uniformVec3("camerapos", state->getCamera().position);
-		for(const auto &plane : planes) {
-			glm::mat4 transform = plane.transform.getTransformMat();
-			glm::mat3 normal = glm::mat3(glm::transpose(glm::inverse(transform)));
-			shader.uniformMat4x4("transform", transform);
-			shader.uniformMat3x3("normalmat", normal);
-			VAOS->draw();
-		}
-
-		shader.uniformFloat("specularfactor", 0.0f);
-		VAOS->bind("propeller");
-		TEXTURES->bindTexture("propeller", GL_TEXTURE0);
-		for(const auto &plane : planes) {
-			glm::mat4 propellerTransform = glm::mat4(1.0f);
-			propellerTransform = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, 13.888f));
-			float rotation = totalTime * 16.0f;
-			propellerTransform = glm::rotate(propellerTransform, rotation, glm::vec3(0.0f, 0.0f, 1.0f));
-			propellerTransform = plane.transform.getTransformMat() * propellerTransform;
-			glm::mat3 normal = glm::mat3(glm::transpose(glm::inverse(propellerTransform)));
-			shader.uniformMat4x4("transform", propellerTransform);
-			shader.uniformMat3x3("normalmat", normal);
-			VAOS->draw();
+		unsigned int first = addEnemies(queue, planes);
+		DrawPacket body = makePacket("textured", "enemy_plane", "plane");
+		body.uniforms = specularFactor(0.5f);
+		submitInstances(queue, body, first);
+
+		//The propellers are drawn with the transforms of the planes
+		glm::mat4 propellerTransform = getPropellerTransform(totalTime);
+		glm::mat3 propellerNormal = glm::mat3(propellerTransform);
+		unsigned int propellers = queue.instanceCount();
+		for(unsigned int i = first; i < propellers; i++) {
+			const InstanceData plane = queue.getInstance(i);
+			addInstance(
+				queue,
+				plane.transform * propellerTransform,
+				plane.normalmat * propellerNormal
+			);
 		}
+		DrawPacket propeller = makePacket("textured", "propeller", "propeller");
+		propeller.uniforms = specularFactor(0.0f);
+		submitInstances(queue, propeller, propellers);
 	}
 
-	void displayBullets(const std::vector<gameobjects::Bullet> &bullets)
-	{
-		if(bullets.empty())
-			return;
-
-		State* state = State::get();
-
-		VAOS->bind("bullet");
-		TEXTURES->bindTexture("bullet", GL_TEXTURE0);
-		SHADERS->use("trail");
-		ShaderProgram& trailshader = SHADERS->getShader("trail");
-		trailshader.uniformMat4x4("persp", state->getPerspective());
-		trailshader.uniformMat4x4("view", state->getCamera().viewMatrix());
-		trailshader.uniformFloat("specularfactor", 1.0f);
-		trailshader.uniformVec3("lightdir", LIGHT);
-		trailshader.uniformVec3("camerapos", state->getCamera().position);
+	void displayBullets(
+		RenderQueue &queue,
+		const std::vector<gameobjects::Bullet> &bullets
+	) {
+		unsigned int first = queue.instanceCount();
 		for(const auto &bullet : bullets) {
 			glm::mat4 transform = bullet.transform.getTransformMat();
-			glm::mat3 normal = glm::mat3(glm::transpose(glm::inverse(transform)));
 			glm::vec3 velocity = bullet.transform.direction() * BULLET_SPEED;
-			trailshader.uniformFloat("time", bullet.time);
-			trailshader.uniformVec3("velocity", velocity);
-			trailshader.uniformMat4x4("transform", transform);
-			trailshader.uniformMat3x3("normalmat", normal);	
-			VAOS->drawInstanced(32);
-		}	
+			addInstance(
+				queue,
+				transform,
+				getNormalMat(transform, bullet.transform.scale),
+				glm::vec4(velocity, bullet.time)
+			);
+		}
+		DrawPacket packet = makePacket("trail", "bullet", "bullet");
+		packet.uniforms = specularFactor(1.0f);
+		submitInstances(queue, packet, first, TRAIL_LENGTH);
 	}
 
 	void displayMiniMapBackground()
@@ -432,7 +606,7 @@ namespace gfx {
 	}
 
 	void displayEnemyMarkers(
-		const std::vector<gameobjects::Enemy> &enemies,
+		const gameobjects::EnemyColumns &enemies,
 		const game::Transform &playertransform
 	) {
 		State* state = State::get();
@@ -447,11 +621,13 @@ namespace gfx {
 		SHADERS->use("textured2d");
 		TEXTURES->bindTexture("enemy_marker", GL_TEXTURE0);
 		ShaderProgram& texture2dshader = SHADERS->getShader("textured2d");
+		static const Uniform<glm::mat4>
+			transformuniform = texture2dshader.getUniform<glm::mat4>("transform");
 		texture2dshader.uniformMat4x4("screen", screenMat);
 		glm::vec2 center(playertransform.position.x, playertransform.position.z);
-		for(const auto &enemy : enemies) {
+		for(const auto &enemy : enemies.transforms) {
 			//Calculate distance to player
-			glm::vec2 enemypos(enemy.transform.position.x, enemy.transform.position.z);
+			glm::vec2 enemypos(enemy.position.x, enemy.position.z);
 			glm::vec2 diff = enemypos - center;
 			float dist = glm::length(diff);
 
@@ -476,7 +652,7 @@ namespace gfx {
 			transform = glm::translate(transform, glm::vec3(-float(w) / 2.0f, -float(h) / 2.0f, 0.0f));
 			transform = glm::scale(transform, glm::vec3(8.0f, 8.0f, 0.0f));
 			transform = glm::rotate(transform, glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-			texture2dshader.uniformMat4x4("transform", transform);
+			texture2dshader.uniformMat4x4(transformuniform, transform);
 			VAOS->draw();
 		}
 	}
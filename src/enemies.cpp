@@ -6,113 +6,130 @@
 namespace gobjs = gameobjects;
 
 namespace gameobjects {
-	Enemy::Enemy(glm::vec3 position, int hp, unsigned int scoreval)
+	size_t EnemyColumns::size() const
 	{
+		return transforms.size();
+	}
+
+	bool EnemyColumns::empty() const
+	{
+		return transforms.empty();
+	}
+
+	void EnemyColumns::add(const glm::vec3 &position, int hp, unsigned int scoreval)
+	{
+		game::Transform transform;
 		transform.position = position;
 		transform.scale = glm::vec3(1.0f);
 		transform.rotation = glm::vec3(0.0f);
-		hitpoints = hp;
-		scorevalue = scoreval;
-	}	
+		transforms.push_back(transform);
+		hitpoints.push_back(hp);
+		scorevalues.push_back(scoreval);
+		destroyed.push_back(false);
+	}
 
-	float Enemy::getVal(const std::string &key) const
+	void EnemyColumns::move(size_t from, size_t to)
 	{
-		if(!values.count(key))
-			return 0.0f;
-		return values.at(key);
+		transforms[to] = transforms[from];
+		hitpoints[to] = hitpoints[from];
+		scorevalues[to] = scorevalues[from];
+		destroyed[to] = destroyed[from];
 	}
 
-	void Enemy::setVal(const std::string &key, float v)
+	void EnemyColumns::resize(size_t count)
 	{
-		values[key] = v;
-	}	
+		transforms.resize(count);
+		hitpoints.resize(count);
+		scorevalues.resize(count);
+		destroyed.resize(count);
+	}
 }
 
 namespace game {
 	void destroyEnemies(
 		gobjs::Player &player,
-		std::vector<gobjs::Enemy> &enemies,
+		gobjs::EnemyColumns &enemies,
 		std::vector<gobjs::Explosion> &explosions,
 		float explosionscale,
 		float crashdist,
 		unsigned int &score
 	) {
-		if(enemies.empty())
-			return;
-
-		enemies.erase(std::remove_if(
-			enemies.begin(),
-			enemies.end(),
-			[&player, &explosions, &crashdist, &score, &explosionscale](gobjs::Enemy &enemy) {
-				if(enemy.hitpoints <= 0) {
-					SNDSRC->playid("explosion", enemy.transform.position);
-					explosions.push_back(gobjs::Explosion(enemy.transform.position, explosionscale));
-					score += enemy.scorevalue;
-					return true;
-				}
+		//The enemies are only marked here, they are removed by calling
+		//`removeDestroyed` on the store
+		for(size_t i = 0; i < enemies.size(); i++) {
+			if(enemies.destroyed[i])
+				continue;
 
-				glm::vec3 diff = enemy.transform.position - player.transform.position;
-
-				if(glm::length(diff) < crashdist && !player.crashed) {
-					SNDSRC->playid(
-						"explosion",
-						enemy.transform.position,
-						explosionscale
-					);
-					player.crashed = true;
-					explosions.push_back(gobjs::Explosion(enemy.transform.position, explosionscale));
-					return true;
-				}
+			glm::vec3 position = enemies.transforms[i].position;
+			if(enemies.hitpoints[i] <= 0) {
+				SNDSRC->playid("explosion", position);
+				explosions.push_back(gobjs::Explosion(position, explosionscale));
+				score += enemies.scorevalues[i];
+				enemies.destroyed[i] = true;
+				continue;
+			}
 
-				return glm::length(diff) > CHUNK_SZ * 32.0f;
+			glm::vec3 diff = position - player.transform.position;
+
+			if(glm::length(diff) < crashdist && !player.crashed) {
+				SNDSRC->playid(
+					"explosion",
+					position,
+					explosionscale
+				);
+				player.crashed = true;
+				explosions.push_back(gobjs::Explosion(position, explosionscale));
+				enemies.destroyed[i] = true;
+				continue;
 			}
-		), enemies.end());
+
+			enemies.destroyed[i] = glm::length(diff) > CHUNK_SZ * 32.0f;
+		}
 	}
 
 	void checkForCollision(
 		gameobjects::Player &player,
-		std::vector<gobjs::Enemy> &enemies,
+		gobjs::EnemyColumns &enemies,
 		std::vector<gobjs::Explosion> &explosions,
 		float explosionscale,
 		const glm::vec3 &extents
 	) {
-		if(enemies.empty())
-			return;
-
-		enemies.erase(std::remove_if(
-			enemies.begin(),
-			enemies.end(),
-			[&player, &explosions, &extents, &explosionscale](gobjs::Enemy &enemy) {
-				glm::vec3 diff = player.transform.position - enemy.transform.position;
-				diff = enemy.transform.invRotate(diff);
-
-				if(std::abs(diff.x) < extents.x && 
-					std::abs(diff.y) < extents.y &&
-					std::abs(diff.z) < extents.z) {
-					player.crashed = true;
-					explosions.push_back(gobjs::Explosion(enemy.transform.position, explosionscale));
-					return true;
-				}
+		for(size_t i = 0; i < enemies.size(); i++) {
+			if(enemies.destroyed[i])
+				continue;
 
-				return false;
+			const game::Transform &transform = enemies.transforms[i];
+			glm::vec3 diff = player.transform.position - transform.position;
+			diff = transform.invRotate(diff);
+
+			if(std::abs(diff.x) < extents.x && 
+				std::abs(diff.y) < extents.y &&
+				std::abs(diff.z) < extents.z) {
+				player.crashed = true;
+				explosions.push_back(gobjs::Explosion(transform.position, explosionscale));
+				enemies.destroyed[i] = true;
 			}
-		), enemies.end());
+		}
 	}
 
-	void checkForCollision(std::vector<gameobjects::Enemy> &enemies, float hitdist)
+	void checkForCollision(gameobjects::EnemyColumns &enemies, float hitdist)
 	{
-		for(int i = 0; i < enemies.size(); i++) {
-			for(int j = i + 1; j < enemies.size(); j++) {
+		for(size_t i = 0; i < enemies.size(); i++) {
+			if(enemies.destroyed[i])
+				continue;
+			for(size_t j = i + 1; j < enemies.size(); j++) {
+				if(enemies.destroyed[j])
+					continue;
 				glm::vec3
-					p1 = enemies.at(i).transform.position,
-					p2 = enemies.at(j).transform.position;
+					p1 = enemies.transforms[i].position,
+					p2 = enemies.transforms[j].position;
 				float dist = glm::length(p1 - p2);
 
 				if(dist < hitdist) {
-					enemies.at(i).scorevalue = 0;
-					enemies.at(i).hitpoints = 0;
-					enemies.at(j).scorevalue = 0;
-					enemies.at(j).hitpoints = 0;
+					enemies.scorevalues[i] = 0;
+					enemies.hitpoints[i] = 0;
+					enemies.scorevalues[j] = 0;
+					enemies.hitpoints[j] = 0;
 				}
 			}
 		}
@@ -13,11 +13,12 @@ namespace game {
 		std::random_device rd;
 		int randSeed = rd();
 		infworld::worldseed permutations = infworld::makePermutations(randSeed, 9);
+		infworld::HeightCache heights(permutations);
 		infworld::ChunkTable chunktables[MAX_LOD];
-		generateChunks(permutations, chunktables, RANGE);
-		infworld::DecorationTable decorations = infworld::DecorationTable(14, CHUNK_SZ);
+		generateChunks(heights, chunktables, RANGE);
+		infworld::DecorationTable decorations = infworld::DecorationTable(DECORATION_RANGE, CHUNK_SZ);
 		decorations.genDecorations(permutations);
-		gfx::generateDecorationOffsets(decorations);
+		infworld::HorizonMap horizon;
 		
 		std::minstd_rand0 lcg;
 		lcg.seed(randSeed);
@@ -34,13 +35,17 @@ namespace game {
 		//Gameobjects
 		gobjs::Player player(glm::vec3(0.0f, HEIGHT * SCALE * 0.5f, 0.0f));
 		std::vector<gobjs::Explosion> explosions;
-		std::vector<gobjs::Enemy> balloons, blimps, ufos, planes;
+		gobjs::Balloons balloons;
+		gobjs::Blimps blimps;
+		gobjs::Ufos ufos;
+		gobjs::Planes planes;
 		std::vector<gobjs::Bullet> bullets, enemybullets;
 
 		unsigned int fps = 0;
 		float dt = 0.0f;
 		float totalTime = 0.0f;
 		unsigned int chunksPerSecond = 0; //Number of chunks drawn per second	
+		gfx::RenderQueue renderqueue;
 		updateCamera(player);
 		while(!glfwWindowShouldClose(state->getWindow()) && !stop) {
 			float start = glfwGetTime();
@@ -56,33 +61,34 @@ namespace game {
 			nk_glfw3_new_frame(state->getNkGlfw());
 			//Update perspective matrix
 			state->updatePerspectiveMat(FOVY, ZNEAR, ZFAR);
+			gfx::updateFrameData();
 
 			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 			//Draw terrain
-			unsigned int drawCount = gfx::displayTerrain(chunktables, MAX_LOD, LOD_SCALE);
-			chunksPerSecond += drawCount;
+			gfx::displayTerrain(renderqueue, chunktables, MAX_LOD, chunksPerSecond, &horizon);
 			//Display trees	
-			gfx::displayDecorations(decorations, totalTime);	
+			gfx::displayDecorations(renderqueue, decorations, totalTime);	
 			//Display plane
 			if(!player.crashed)
-				gfx::displayPlayerPlane(totalTime, player.transform);
+				gfx::displayPlayerPlane(renderqueue, totalTime, player.transform);
 			//Display balloons
-			gfx::displayBalloons(balloons);
+			gfx::displayBalloons(renderqueue, balloons);
 			//Display blimps
-			gfx::displayBlimps(blimps);
+			gfx::displayBlimps(renderqueue, blimps);
 			//Display ufos
-			gfx::displayUfos(ufos);
+			gfx::displayUfos(renderqueue, ufos);
 			//Display enemy planes
-			gfx::displayPlanes(totalTime, planes);
+			gfx::displayPlanes(renderqueue, totalTime, planes);
 			//Display bullets
-			gfx::displayBullets(bullets);
-			gfx::displayBullets(enemybullets);
+			gfx::displayBullets(renderqueue, bullets);
+			gfx::displayBullets(renderqueue, enemybullets);
 			//Display water
-			gfx::displayWater(totalTime);
+			gfx::displayWater(renderqueue, totalTime);
 			//Draw skybox
-			gfx::displaySkybox();
+			gfx::displaySkybox(renderqueue);
 			//Display explosions
-			gfx::displayExplosions(explosions);
+			gfx::displayExplosions(renderqueue, explosions);
+			renderqueue.execute();
 			//User Interface
 			gui::displayFPSCounter(fps);
 			gui::displayHUD(score, player.speed, player.hpPercent());
@@ -151,7 +157,7 @@ namespace game {
 				//Update bullets
 				checkBulletDist(bullets, player);
 				updateBullets(bullets, dt);
-				checkForBulletTerrainCollision(bullets, permutations);
+				checkForBulletTerrainCollision(bullets, heights);
 				checkForHit(bullets, balloons, 24.0f);
 				checkForHit(bullets, blimps, 32.0f);
 				checkForHit(bullets, ufos, 14.0f);
@@ -159,33 +165,29 @@ namespace game {
 				//Update enemy bullets
 				checkBulletDist(enemybullets, player);
 				updateBullets(enemybullets, dt);
-				checkForBulletTerrainCollision(enemybullets, permutations);
+				checkForBulletTerrainCollision(enemybullets, heights);
 				checkForHit(enemybullets, player, 14.0f);
 				//Spawn balloons
 				if(timers.getTimer("spawn_balloon"))
-					spawnBalloons(player, balloons, lcg, permutations);	
+					spawnBalloons(player, balloons, lcg, heights);	
 				if(timers.getTimer("spawn_blimp"))
 					spawnBlimps(player, blimps, lcg);
 				if(timers.getTimer("spawn_ufo"))
-					spawnUfos(player, ufos, lcg, permutations);
+					spawnUfos(player, ufos, lcg, heights);
 				if(timers.getTimer("spawn_plane"))
-					spawnPlanes(player, planes, lcg, permutations, totalTime);
+					spawnPlanes(player, planes, lcg, heights, totalTime);
 				//Update balloons
-				for(auto &balloon : balloons)
-					balloon.updateBalloon(dt);
+				gobjs::updateBalloons(balloons, dt);
 				//Update blimps
-				for(auto &blimp : blimps)
-					blimp.updateBlimp(dt);
+				gobjs::updateBlimps(blimps, dt);
 				//Update ufos
-				for(auto &ufo : ufos)
-					ufo.updateUfo(dt, permutations);
+				gobjs::updateUfos(ufos, dt, heights);
 				//Update enemy planes
-				for(auto &plane : planes)
-					plane.updatePlane(dt, player, enemybullets, permutations);
+				gobjs::updatePlanes(planes, dt, player, enemybullets, heights);
 				//Update plane
 				player.update(dt);
 				bool justcrashed = player.crashed;
-				player.checkIfCrashed(dt, permutations);
+				player.checkIfCrashed(dt, heights);
 				//Check if any planes have collided with each other
 				checkForCollision(planes, 16.0f);
 				//Destroy any enemies that are too far away or have run out of health
@@ -194,6 +196,10 @@ namespace game {
 				destroyEnemies(player, ufos, explosions, 1.0f, 14.0f, score);
 				destroyEnemies(player, planes, explosions, 1.0f, 18.0f, score);
 				checkForCollision(player, blimps, explosions, 2.5f, glm::vec3(26.0f, 26.0f, 72.0f));
+				balloons.removeDestroyed();
+				blimps.removeDestroyed();
+				ufos.removeDestroyed();
+				planes.removeDestroyed();
 				justcrashed = player.crashed ^ justcrashed;
 				//Update explosions
 				if(justcrashed) {
@@ -203,7 +209,8 @@ namespace game {
 				updateExplosions(explosions, player.transform.position, dt);
 				//Update camera
 				updateCamera(player, dt);
-				generateNewChunks(permutations, chunktables, decorations);
+				generateNewChunks(heights, chunktables, decorations);
+				updateOcclusion(chunktables, horizon, decorations);
 
 				totalTime += dt;
 				timers.reset();
@@ -225,6 +232,7 @@ namespace game {
 		SNDSRC->stopAll();
 		for(int i = 0; i < MAX_LOD; i++)
 			chunktables[i].clearBuffers();
+		decorations.clearBuffers();
 
 		return score;
 	}
@@ -66,11 +66,17 @@ namespace game {
 	{
 		//Vaos
 		VAOS->genSimple();
-		VAOS->add("pinetree", plants::createPineTreeModel(8));
-		VAOS->add("pinetreelowdetail", plants::createPineTreeModel(4));
-		VAOS->add("tree", plants::createTreeModel(6));
-		VAOS->add("treelowdetail", plants::createTreeModel(3));
+		mesh::ModelCache cache(modelCachePath);
+		VAOS->add("pinetree", plants::createTreeVao(plants::createPineTree(cache, 8)));
+		VAOS->add("pinetreelowdetail", plants::createTreeVao(plants::createPineTree(cache, 4)));
+		VAOS->add("tree", plants::createTreeVao(plants::createTree(cache, 6)));
+		VAOS->add("treelowdetail", plants::createTreeVao(plants::createTree(cache, 3)));
+		cache.save();
 		VAOS->importFromFile("assets/models.impfile");
+		//These models are drawn with instancing
+		for(const char *name : { "plane", "propeller", "balloon", "blimp", "ufo" })
+			gfx::addInstanceBuffer(VAOS->getVao(name));
+		gfx::addInstanceBuffer(VAOS->getVao("bullet"), TRAIL_LENGTH);
 		//Textures
 		TEXTURES->importFromFile("assets/textures.impfile");
 		//Shaders
@@ -82,30 +88,61 @@ namespace game {
 	}
 
 	void generateChunks(
-		const infworld::worldseed &permutations,
+		infworld::HeightCache &heights,
 		infworld::ChunkTable *chunktables,
 		unsigned int range
 	) {
-		float sz = CHUNK_SZ;
-		for(int i = 0; i < MAX_LOD; i++) {
-			chunktables[i] = 
-				infworld::buildWorld(range, permutations, HEIGHT, sz);
-			sz *= LOD_SCALE;
-		}
+		std::shared_ptr<infworld::GPUChunkGenerator> generator = nullptr;
+		if(GlobalSettings::get()->values.gpuTerrain)
+			generator = std::make_shared<infworld::GPUChunkGenerator>(heights.seed());
+		infworld::buildWorlds(
+			chunktables,
+			MAX_LOD,
+			LOD_SCALE,
+			range,
+			heights,
+			HEIGHT,
+			CHUNK_SZ,
+			generator
+		);
 	}
 
 	void generateNewChunks(
-		const infworld::worldseed &permutations,
+		infworld::HeightCache &heights,
 		infworld::ChunkTable *chunktables,
 		infworld::DecorationTable &decorations
 	) {
 		Camera& cam = State::get()->getCamera();
-		for(int i = 0; i < MAX_LOD; i++)
-			chunktables[i].generateNewChunks(cam.position.x, cam.position.z, permutations);
+		unsigned int budget = CHUNK_UPLOAD_BUDGET;
+		for(int i = 0; i < MAX_LOD; i++) {
+			chunktables[i].generateNewChunks(cam.position.x, cam.position.z, heights);
+			budget -= chunktables[i].uploadChunks(budget);
+		}
 		//If we generate new terrain, we must generate new decorations as well
-		bool generated = decorations.genNewDecorations(cam.position.x, cam.position.z, permutations);
-		if(generated)
-			gfx::generateDecorationOffsets(decorations);
+		decorations.genNewDecorations(
+			cam.position.x,
+			cam.position.z,
+			heights.seed()
+		);
+		decorations.integrateDecorations(DECORATION_BUDGET);
+	}
+
+	void updateOcclusion(
+		infworld::ChunkTable *chunktables,
+		infworld::HorizonMap &horizon,
+		infworld::DecorationTable &decorations
+	) {
+		if(!GlobalSettings::get()->values.occlusionCulling) {
+			if(horizon.isBuilt()) {
+				horizon.clear();
+				decorations.updateOcclusion(horizon);
+			}
+			return;
+		}
+
+		Camera& cam = State::get()->getCamera();
+		if(horizon.update(chunktables, MAX_LOD, cam.position, ZFAR))
+			decorations.updateOcclusion(horizon);
 	}
 
 	//This initializes the uniform block of values that should be shared across
@@ -131,6 +168,7 @@ namespace game {
 		glBindBuffer(GL_UNIFORM_BUFFER, 0);
 		SHADERS->getShader("water").setBinding("GlobalVals", 0);
 		SHADERS->getShader("tree").setBinding("GlobalVals", 0);
+		SHADERS->getShader("impostor").setBinding("GlobalVals", 0);
 		SHADERS->getShader("terrain").setBinding("GlobalVals", 0);
 		glBindBufferBase(GL_UNIFORM_BUFFER, 0, globalShaderValsUbo);
 	}
@@ -138,9 +176,18 @@ namespace game {
 	void initUniforms()
 	{
 		initGlobalValUniformBlock();
+		gfx::initFrameData();
 		SHADERS->use("terrain");
 		SHADERS->getShader("terrain").uniformFloat("maxheight", HEIGHT);
 		SHADERS->getShader("terrain").uniformInt("prec", PREC);
+		SHADERS->getShader("terrain").uniformInt("terraintexture", 0);
+		SHADERS->use("water");
+		SHADERS->getShader("water").uniformInt("watermaps", 0);
+		SHADERS->use("skybox");
+		SHADERS->getShader("skybox").uniformInt("skybox", 0);
+		//The impostors are drawn with the tree shader which uses the
+		//uniform blocks
+		gfx::bakeTreeImpostors();
 	}
 
 	void TimerManager::addTimer(const std::string &name, float maxtime)
@@ -10,6 +10,16 @@ constexpr float ACCELERATION = 12.0f;
 constexpr float BULLET_SPEED = 384.0f;
 constexpr unsigned int MAX_LOD = 5;
 constexpr float LOD_SCALE = 2.0f;
+//Terrain morphing (see gfx::displayTerrain) relies on each level of detail
+//having half the resolution of the previous one
+static_assert(LOD_SCALE == 2.0f, "LOD_SCALE must be 2");
+//Maximum number of chunks that are uploaded to the GPU each frame
+constexpr unsigned int CHUNK_UPLOAD_BUDGET = 4;
+//Maximum number of decoration cells that are integrated each frame
+constexpr unsigned int DECORATION_BUDGET = 8;
+//Number of decoration cells on each side of the camera, the far ones are
+//drawn as impostors
+constexpr unsigned int DECORATION_RANGE = 20;
 
 constexpr float FOVY = glm::radians(75.0f);
 constexpr float ZNEAR = 2.0f;
@@ -17,8 +27,16 @@ constexpr float ZFAR = 20000.0f;
 
 constexpr int RANGE = 4;
 
+//Number of instances that each bullet trail is drawn with, this must be the
+//same as TRAIL_LENGTH in trailvert.glsl
+constexpr unsigned int TRAIL_LENGTH = 32;
+
 const glm::vec3 LIGHT = glm::normalize(glm::vec3(-1.0f));
 
+//Generated models are saved here so that they do not need to be generated
+//again on the next launch
+const char modelCachePath[] = "modelcache";
+
 namespace game {
 	enum GameMode {
 		CASUAL,
@@ -66,13 +84,20 @@ namespace game {
 	//Initializes the shader uniforms
 	void initUniforms();
 	void generateChunks(
-		const infworld::worldseed &permutations,
+		infworld::HeightCache &heights,
 		infworld::ChunkTable *chunktables,
 		unsigned int range
 	);
 	void generateNewChunks(
-		const infworld::worldseed &permutations,
+		infworld::HeightCache &heights,
+		infworld::ChunkTable *chunktables,
+		infworld::DecorationTable &decorations
+	);
+	//Finds the terrain and trees that are hidden behind hills, the
+	//horizon map is cleared if occlusion culling is turned off
+	void updateOcclusion(
 		infworld::ChunkTable *chunktables,
+		infworld::HorizonMap &horizon,
 		infworld::DecorationTable &decorations
 	);
 
@@ -128,7 +153,7 @@ namespace gameobjects {
 		void rotateWithMouse(float dt);
 		void update(float dt);
 		void resetShootTimer();
-		void checkIfCrashed(float dt, const infworld::worldseed &permutations);
+		void checkIfCrashed(float dt, infworld::HeightCache &heights);
 	};
 
 	struct Explosion {
@@ -152,38 +177,115 @@ namespace gameobjects {
 		void update(float dt);
 	};
 
-	struct Enemy {
+	//State that is only used by balloons, they float up and down between
+	//`miny` and `maxy`
+	struct BalloonState {
+		float miny, maxy;
+		float direction;
+	};
+
+	struct UfoState {
+		float rotationspeed;
+		float rotationtimer;
+	};
+
+	struct PlaneState {
+		//Negative if the plane is turning away from the player
+		float rotationdirection;
+		float rotationtimer;
+		float shoottimer;
+	};
+
+	//Blimps fly in a straight line so they do not have any state of their own
+	struct BlimpState {};
+
+	//Components that every type of enemy has, each component is kept in its
+	//own array and an enemy has the same index in all of them
+	struct EnemyColumns {
+		std::vector<game::Transform> transforms;
+		std::vector<int> hitpoints;
 		//How many points the player gets if they kill the enemy
-		unsigned int scorevalue;
-		game::Transform transform;
-		std::unordered_map<std::string, float> values;
-		int hitpoints;
-		Enemy(glm::vec3 position, int hp, unsigned int scoreval);
-		void updateBalloon(float dt);
-		void updateBlimp(float dt);
-		void updateUfo(float dt, const infworld::worldseed &permutations);
-		void updatePlane(
-			float dt,
-			const Player &player,
-			std::vector<Bullet> &bullets,
-			const infworld::worldseed &permutations
-		);
-		void checkIfPlaneCrashed(const infworld::worldseed &permutations);
-		float getVal(const std::string &key) const;
-		void setVal(const std::string &key, float v);
+		std::vector<unsigned int> scorevalues;
+		//Set for enemies that should be removed by `removeDestroyed`
+		std::vector<char> destroyed;
+		size_t size() const;
+		bool empty() const;
+		void add(const glm::vec3 &position, int hp, unsigned int scoreval);
+	protected:
+		//Copies the components of enemy `from` to enemy `to`
+		void move(size_t from, size_t to);
+		void resize(size_t count);
+	};
+
+	//Each type of enemy is kept in its own store which also has a column
+	//for the state that is only used by that type
+	template<typename State>
+	struct EnemyStore : EnemyColumns {
+		std::vector<State> states;
+
+		void add(
+			const glm::vec3 &position,
+			int hp,
+			unsigned int scoreval,
+			const State &state
+		) {
+			EnemyColumns::add(position, hp, scoreval);
+			states.push_back(state);
+		}
+
+		//Removes the enemies that are marked as destroyed, the rest are
+		//moved forward to fill in the gaps and keep their order
+		void removeDestroyed()
+		{
+			size_t count = 0;
+			for(size_t i = 0; i < size(); i++) {
+				if(destroyed[i])
+					continue;
+				if(count != i) {
+					move(i, count);
+					states[count] = states[i];
+				}
+				count++;
+			}
+			resize(count);
+			states.resize(count);
+		}
 	};
 
-	Enemy spawnBalloon(const glm::vec3 &position, const infworld::worldseed &permutations);
-	Enemy spawnBlimp(const glm::vec3 &position, float rotation);
-	Enemy spawnUfo(
+	typedef EnemyStore<BalloonState> Balloons;
+	typedef EnemyStore<BlimpState> Blimps;
+	typedef EnemyStore<UfoState> Ufos;
+	typedef EnemyStore<PlaneState> Planes;
+
+	//Each update goes over every enemy in a store
+	void updateBalloons(Balloons &balloons, float dt);
+	void updateBlimps(Blimps &blimps, float dt);
+	void updateUfos(Ufos &ufos, float dt, infworld::HeightCache &heights);
+	void updatePlanes(
+		Planes &planes,
+		float dt,
+		const Player &player,
+		std::vector<Bullet> &bullets,
+		infworld::HeightCache &heights
+	);
+
+	void spawnBalloon(
+		Balloons &balloons,
+		const glm::vec3 &position,
+		infworld::HeightCache &heights
+	);
+	void spawnBlimp(Blimps &blimps, const glm::vec3 &position, float rotation);
+	void spawnUfo(
+		Ufos &ufos,
 		const glm::vec3 &position,
 		float rotation,
-		const infworld::worldseed &permutations
+		infworld::HeightCache &heights
 	);
-	Enemy spawnPlane(
+	void spawnPlane(
+		Planes &planes,
 		const glm::vec3 &position,
 		float rotation,
-		const infworld::worldseed &permutations
+		infworld::HeightCache &heights
 	);
 }
 
@@ -191,34 +293,34 @@ namespace game {
 	//Spawns balloons around the player
 	void spawnBalloons(
 		gameobjects::Player &player,
-		std::vector<gameobjects::Enemy> &balloons,
+		gameobjects::Balloons &balloons,
 		std::minstd_rand0 &lcg,
-		const infworld::worldseed &permutations
+		infworld::HeightCache &heights
 	);
 	//Spawns blimps around the player
 	void spawnBlimps(
 		gameobjects::Player &player,
-		std::vector<gameobjects::Enemy> &blimps,
+		gameobjects::Blimps &blimps,
 		std::minstd_rand0 &lcg
 	);
 	//Spawn ufos around the player
 	void spawnUfos(
 		gameobjects::Player &player,
-		std::vector<gameobjects::Enemy> &ufos,
+		gameobjects::Ufos &ufos,
 		std::minstd_rand0 &lcg,
-		const infworld::worldseed &permutations
+		infworld::HeightCache &heights
 	);
 	//Spawn planes around the player
 	void spawnPlanes(
 		gameobjects::Player &player,
-		std::vector<gameobjects::Enemy> &planes,
+		gameobjects::Planes &planes,
 		std::minstd_rand0 &lcg,
-		const infworld::worldseed &permutations,
+		infworld::HeightCache &heights,
 		float totalTime
 	);
 	void destroyEnemies(
 		gameobjects::Player &player,
-		std::vector<gameobjects::Enemy> &enemies,
+		gameobjects::EnemyColumns &enemies,
 		std::vector<gameobjects::Explosion> &explosions,
 		float explosionscale,
 		float crashdist,
@@ -226,13 +328,13 @@ namespace game {
 	);
 	void checkForCollision(
 		gameobjects::Player &player,
-		std::vector<gameobjects::Enemy> &enemies,
+		gameobjects::EnemyColumns &enemies,
 		std::vector<gameobjects::Explosion> &explosions,
 		float explosionscale,
 		const glm::vec3 &extents
 	);
 	//Check for collision among enemies
-	void checkForCollision(std::vector<gameobjects::Enemy> &enemies, float hitdist);
+	void checkForCollision(gameobjects::EnemyColumns &enemies, float hitdist);
 	//Returns the position the camera should be following
 	glm::vec3 getCameraFollowPos(const Transform &playertransform);
 	//Have the camera follow the player	
@@ -254,7 +356,7 @@ namespace game {
 	void updateBullets(std::vector<gameobjects::Bullet> &bullets, float dt);
 	void checkForHit(
 		std::vector<gameobjects::Bullet> &bullets,
-		std::vector<gameobjects::Enemy> &enemies,
+		gameobjects::EnemyColumns &enemies,
 		float hitdist
 	);
 	void checkForHit(
@@ -264,26 +366,78 @@ namespace game {
 	);
 	void checkForBulletTerrainCollision(
 		std::vector<gameobjects::Bullet> &bullets,
-		infworld::worldseed &permutations
+		infworld::HeightCache &heights
 	);
 }
 
 namespace gfx {
-	void displaySkybox();
-	void displayWater(float totalTime);
-	void displayDecorations(infworld::DecorationTable &decorations, float totalTime);
-	unsigned int displayTerrain(infworld::ChunkTable *chunktables, int maxlod, float lodscale);	
+	//Creates the FrameData uniform block which holds the camera and the
+	//lighting that are read by all of the scene shaders
+	void initFrameData();
+	//Writes the current camera into the FrameData uniform block, this is
+	//called once per frame before the scene is drawn
+	void updateFrameData();
+	void updateFrameData(
+		const glm::mat4 &persp,
+		const glm::mat4 &view,
+		const glm::vec3 &camerapos
+	);
+	//The scene is drawn by submitting it to a render queue which is then
+	//executed once everything has been submitted
+	void displaySkybox(RenderQueue &queue);
+	void displayWater(RenderQueue &queue, float totalTime);
+	void displayDecorations(
+		RenderQueue &queue,
+		infworld::DecorationTable &decorations,
+		float totalTime
+	);
+	//The number of chunks drawn is added to 'drawcount' when the queue
+	//is executed
+	void displayTerrain(
+		RenderQueue &queue,
+		infworld::ChunkTable *chunktables,
+		int maxlod,
+		unsigned int &drawcount,
+		const infworld::HorizonMap *horizon = nullptr
+	);
+	//Culls the trees, this is called by displayDecorations each frame
 	void generateDecorationOffsets(infworld::DecorationTable &decorations);
-	void displayPlayerPlane(float totalTime, const game::Transform &transform);
-	void displayExplosions(const std::vector<gameobjects::Explosion> &explosions);
-	void displayBalloons(const std::vector<gameobjects::Enemy> &balloons);
-	void displayBlimps(const std::vector<gameobjects::Enemy> &blimps);
-	void displayUfos(const std::vector<gameobjects::Enemy> &ufos);
-	void displayPlanes(float totalTime, const std::vector<gameobjects::Enemy> &planes);
-	void displayBullets(const std::vector<gameobjects::Bullet> &bullets);
+	//Renders the trees into the "treeimpostors" atlas and creates the
+	//"pinetreeimpostor" and "treeimpostor" vaos
+	void bakeTreeImpostors();
+	void displayPlayerPlane(
+		RenderQueue &queue,
+		float totalTime,
+		const game::Transform &transform
+	);
+	void displayExplosions(
+		RenderQueue &queue,
+		const std::vector<gameobjects::Explosion> &explosions
+	);
+	void displayBalloons(
+		RenderQueue &queue,
+		const gameobjects::Balloons &balloons
+	);
+	void displayBlimps(
+		RenderQueue &queue,
+		const gameobjects::Blimps &blimps
+	);
+	void displayUfos(
+		RenderQueue &queue,
+		const gameobjects::Ufos &ufos
+	);
+	void displayPlanes(
+		RenderQueue &queue,
+		float totalTime,
+		const gameobjects::Planes &planes
+	);
+	void displayBullets(
+		RenderQueue &queue,
+		const std::vector<gameobjects::Bullet> &bullets
+	);
 	void displayMiniMapBackground();
 	void displayEnemyMarkers(
-		const std::vector<gameobjects::Enemy> &enemies,
+		const gameobjects::EnemyColumns &enemies,
 		const game::Transform &playertransform
 	);
 	void displayCrosshair(const game::Transform &playertransform);
@@ -1,4 +1,9 @@
 #include "geometry.hpp"
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 namespace geo {
 	Plane::Plane(float dist, glm::vec3 normal)
@@ -46,4 +51,193 @@ namespace geo {
 			inFront(frustum.top, aabb) &&
 			inFront(frustum.bottom, aabb);
 	}
+
+	PackedFrustum packFrustum(const Frustum &frustum)
+	{
+		const Plane *planes[] = {
+			&frustum.back,
+			&frustum.front,
+			&frustum.top,
+			&frustum.bottom,
+			&frustum.left,
+			&frustum.right,
+		};
+		PackedFrustum packed;
+		for(int i = 0; i < 8; i++) {
+			//Padding, the signed distance of every point is 1.0
+			if(i >= 6) {
+				packed.normx[i] = packed.normy[i] = packed.normz[i] = 0.0f;
+				packed.d[i] = -1.0f;
+				continue;
+			}
+			packed.normx[i] = planes[i]->norm.x;
+			packed.normy[i] = planes[i]->norm.y;
+			packed.normz[i] = planes[i]->norm.z;
+			packed.d[i] = planes[i]->d;
+		}
+		return packed;
+	}
+
+	FrustumTest testFrustum(const PackedFrustum &frustum, const AABB &aabb)
+	{
+		glm::vec3 extent = aabb.dimensions / 2.0f;
+		//For each plane the signed distance of the center of the box is
+		//compared to how far the box extends towards the plane
+#if defined(__AVX__)
+		__m256
+			x = _mm256_set1_ps(aabb.pos.x),
+			y = _mm256_set1_ps(aabb.pos.y),
+			z = _mm256_set1_ps(aabb.pos.z),
+			ex = _mm256_set1_ps(extent.x),
+			ey = _mm256_set1_ps(extent.y),
+			ez = _mm256_set1_ps(extent.z),
+			signmask = _mm256_set1_ps(-0.0f);
+		__m256
+			nx = _mm256_load_ps(frustum.normx),
+			ny = _mm256_load_ps(frustum.normy),
+			nz = _mm256_load_ps(frustum.normz);
+		__m256 dist = _mm256_add_ps(_mm256_mul_ps(x, nx), _mm256_mul_ps(y, ny));
+		dist = _mm256_add_ps(dist, _mm256_mul_ps(z, nz));
+		dist = _mm256_sub_ps(dist, _mm256_load_ps(frustum.d));
+		__m256 r = _mm256_add_ps(
+			_mm256_mul_ps(_mm256_andnot_ps(signmask, nx), ex),
+			_mm256_mul_ps(_mm256_andnot_ps(signmask, ny), ey)
+		);
+		r = _mm256_add_ps(r, _mm256_mul_ps(_mm256_andnot_ps(signmask, nz), ez));
+		__m256 negr = _mm256_xor_ps(r, signmask);
+		if(_mm256_movemask_ps(_mm256_cmp_ps(dist, negr, _CMP_LT_OQ)))
+			return OUTSIDE;
+		if(_mm256_movemask_ps(_mm256_cmp_ps(dist, r, _CMP_LT_OQ)))
+			return INTERSECTS;
+		return INSIDE;
+#elif defined(__SSE2__)
+		__m128
+			x = _mm_set1_ps(aabb.pos.x),
+			y = _mm_set1_ps(aabb.pos.y),
+			z = _mm_set1_ps(aabb.pos.z),
+			ex = _mm_set1_ps(extent.x),
+			ey = _mm_set1_ps(extent.y),
+			ez = _mm_set1_ps(extent.z),
+			signmask = _mm_set1_ps(-0.0f);
+		int outside = 0, intersects = 0;
+		for(int i = 0; i < 8; i += 4) {
+			__m128
+				nx = _mm_load_ps(frustum.normx + i),
+				ny = _mm_load_ps(frustum.normy + i),
+				nz = _mm_load_ps(frustum.normz + i);
+			__m128 dist = _mm_add_ps(_mm_mul_ps(x, nx), _mm_mul_ps(y, ny));
+			dist = _mm_add_ps(dist, _mm_mul_ps(z, nz));
+			dist = _mm_sub_ps(dist, _mm_load_ps(frustum.d + i));
+			__m128 r = _mm_add_ps(
+				_mm_mul_ps(_mm_andnot_ps(signmask, nx), ex),
+				_mm_mul_ps(_mm_andnot_ps(signmask, ny), ey)
+			);
+			r = _mm_add_ps(r, _mm_mul_ps(_mm_andnot_ps(signmask, nz), ez));
+			__m128 negr = _mm_xor_ps(r, signmask);
+			outside |= _mm_movemask_ps(_mm_cmplt_ps(dist, negr));
+			intersects |= _mm_movemask_ps(_mm_cmplt_ps(dist, r));
+		}
+		if(outside)
+			return OUTSIDE;
+		if(intersects)
+			return INTERSECTS;
+		return INSIDE;
+#else
+		FrustumTest result = INSIDE;
+		for(int i = 0; i < 8; i++) {
+			glm::vec3 norm(frustum.normx[i], frustum.normy[i], frustum.normz[i]);
+			float dist = glm::dot(aabb.pos, norm) - frustum.d[i];
+			float r = glm::dot(glm::abs(norm), extent);
+			if(dist < -r)
+				return OUTSIDE;
+			if(dist < r)
+				result = INTERSECTS;
+		}
+		return result;
+#endif
+	}
+
+	bool intersectsFrustum(const PackedFrustum &frustum, const AABB &aabb)
+	{
+		return testFrustum(frustum, aabb) != OUTSIDE;
+	}
+
+	//Scalar version of cullSpheres for a single sphere
+	inline bool sphereVisible(
+		const PackedFrustum &frustum,
+		const glm::vec3 &center,
+		float radius,
+		const glm::vec3 &pos,
+		float mindist2,
+		float maxdist2
+	) {
+		glm::vec3 diff = center - pos;
+		float dist2 = glm::dot(diff, diff);
+		if(dist2 < mindist2 || dist2 >= maxdist2)
+			return false;
+		for(int i = 0; i < 6; i++) {
+			glm::vec3 norm(frustum.normx[i], frustum.normy[i], frustum.normz[i]);
+			if(glm::dot(center, norm) - frustum.d[i] < -radius)
+				return false;
+		}
+		return true;
+	}
+
+	size_t cullSpheres(
+		const PackedFrustum &frustum,
+		const float *xs,
+		const float *ys,
+		const float *zs,
+		size_t count,
+		float radius,
+		const glm::vec3 &pos,
+		float mindist,
+		float maxdist,
+		unsigned int *indices
+	) {
+		float mindist2 = mindist * mindist, maxdist2 = maxdist * maxdist;
+		size_t visible = 0;
+		size_t i = 0;
+#if defined(__SSE2__)
+		__m128
+			px = _mm_set1_ps(pos.x),
+			py = _mm_set1_ps(pos.y),
+			pz = _mm_set1_ps(pos.z),
+			minsq = _mm_set1_ps(mindist2),
+			maxsq = _mm_set1_ps(maxdist2),
+			negr = _mm_set1_ps(-radius);
+		for(; i + 4 <= count; i += 4) {
+			__m128
+				x = _mm_loadu_ps(xs + i),
+				y = _mm_loadu_ps(ys + i),
+				z = _mm_loadu_ps(zs + i);
+			__m128
+				dx = _mm_sub_ps(x, px),
+				dy = _mm_sub_ps(y, py),
+				dz = _mm_sub_ps(z, pz);
+			__m128 dist2 = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+			dist2 = _mm_add_ps(dist2, _mm_mul_ps(dz, dz));
+			__m128 pass = _mm_and_ps(_mm_cmpge_ps(dist2, minsq), _mm_cmplt_ps(dist2, maxsq));
+			for(int j = 0; j < 6; j++) {
+				__m128 dist = _mm_add_ps(
+					_mm_mul_ps(x, _mm_set1_ps(frustum.normx[j])),
+					_mm_mul_ps(y, _mm_set1_ps(frustum.normy[j]))
+				);
+				dist = _mm_add_ps(dist, _mm_mul_ps(z, _mm_set1_ps(frustum.normz[j])));
+				dist = _mm_sub_ps(dist, _mm_set1_ps(frustum.d[j]));
+				pass = _mm_and_ps(pass, _mm_cmpge_ps(dist, negr));
+			}
+			int mask = _mm_movemask_ps(pass);
+			for(int j = 0; j < 4; j++)
+				if(mask & (1 << j))
+					indices[visible++] = i + j;
+		}
+#endif
+		for(; i < count; i++) {
+			glm::vec3 center(xs[i], ys[i], zs[i]);
+			if(sphereVisible(frustum, center, radius, pos, mindist2, maxdist2))
+				indices[visible++] = i;
+		}
+		return visible;
+	}
 }
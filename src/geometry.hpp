@@ -26,8 +26,47 @@ namespace geo {
 			right;
 	};
 
+	//The planes of a frustum stored as arrays so that a box can be tested
+	//against all of them at once, the last 2 planes always pass
+	struct PackedFrustum {
+		alignas(32) float normx[8];
+		alignas(32) float normy[8];
+		alignas(32) float normz[8];
+		alignas(32) float d[8];
+	};
+
+	enum FrustumTest {
+		OUTSIDE,
+		INTERSECTS,
+		INSIDE,
+	};
+
 	float signedDist(const Plane &p, const glm::vec3 &pos);
 	bool inFront(const Plane &p, const glm::vec3 &pos);
 	bool inFront(const Plane &p, const AABB &aabb);
 	bool intersectsFrustum(const Frustum &frustum, const AABB &aabb);
+	PackedFrustum packFrustum(const Frustum &frustum);
+	//Tests the box against every plane at once with SSE/AVX when they are
+	//available, OUTSIDE is returned in exactly the cases where
+	//intersectsFrustum returns false and INSIDE is returned if the box is
+	//entirely inside of the frustum
+	FrustumTest testFrustum(const PackedFrustum &frustum, const AABB &aabb);
+	bool intersectsFrustum(const PackedFrustum &frustum, const AABB &aabb);
+	//Tests spheres of the same radius centered at (xs[i], ys[i], zs[i])
+	//against the frustum and checks that the distance from their centers
+	//to `pos` is in [mindist, maxdist). The indices of the spheres that
+	//pass are written to `indices` in order and the number of them is
+	//returned. Uses SSE when it is available.
+	size_t cullSpheres(
+		const PackedFrustum &frustum,
+		const float *xs,
+		const float *ys,
+		const float *zs,
+		size_t count,
+		float radius,
+		const glm::vec3 &pos,
+		float mindist,
+		float maxdist,
+		unsigned int *indices
+	);
 };
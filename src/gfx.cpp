@@ -5,6 +5,7 @@
 #include <stb_image/stb_image.h>
 #include <fast_obj/fast_obj.h>
 #include <assert.h>
+#include <stddef.h>
 #include <unordered_map>
 #include <sstream>
 
@@ -262,26 +263,26 @@ namespace mesh {
 
 	Model mergeModels(const Model &model1, const Model &model2)
 	{
-		Model merged;
-
 		//Copy model data into merged model
-		merged.vertices = model1.vertices;
-		merged.normals = model1.normals;
-		merged.texturecoords = model1.texturecoords;
-		merged.indices = model1.indices;
-
-		//Copy model 2's data to the merged model (adjust vertices as needed)
-		for(auto &vert : model2.vertices)
-			merged.vertices.push_back(vert);
-		for(auto &norm : model2.normals)
-			merged.normals.push_back(norm);
-		for(auto &tc : model2.texturecoords)
-			merged.texturecoords.push_back(tc);
+		Model merged = model1;
+		appendModel(merged, model2);
+		return merged;
+	}
+
+	void appendModel(Model &model1, const Model &model2)
+	{
+		//Copy model 2's data to the end of model 1 (adjust vertices as needed)
 		unsigned int startingindex = model1.vertices.size();
+		model1.vertices.insert(model1.vertices.end(), model2.vertices.begin(), model2.vertices.end());
+		model1.normals.insert(model1.normals.end(), model2.normals.begin(), model2.normals.end());
+		model1.texturecoords.insert(
+			model1.texturecoords.end(),
+			model2.texturecoords.begin(),
+			model2.texturecoords.end()
+		);
+		model1.indices.reserve(model1.indices.size() + model2.indices.size());
 		for(auto index : model2.indices)
-			merged.indices.push_back(startingindex + index);
-
-		return merged;
+			model1.indices.push_back(startingindex + index);
 	}
 
 	std::string indicesToStr(unsigned int v, unsigned int t, unsigned int n)
@@ -487,6 +488,47 @@ namespace gfx {
 		return vao;
 	}
 
+	void addInstanceBuffer(Vao &vao, unsigned int divisor)
+	{
+		assert(vao.buffers.size() == 4);
+		vao.bind();
+		unsigned int buffer;
+		glGenBuffers(1, &buffer);
+		vao.buffers.push_back(buffer);
+		glBindBuffer(GL_ARRAY_BUFFER, buffer);
+		const size_t stride = sizeof(InstanceData);
+		//Matrices take up one attribute location for each column
+		for(unsigned int i = 0; i < 4; i++) {
+			size_t offset = offsetof(InstanceData, transform) + i * sizeof(glm::vec4);
+			glVertexAttribPointer(4 + i, 4, GL_FLOAT, false, stride, (void*)offset);
+		}
+		for(unsigned int i = 0; i < 3; i++) {
+			size_t offset = offsetof(InstanceData, normalmat) + i * sizeof(glm::vec3);
+			glVertexAttribPointer(8 + i, 3, GL_FLOAT, false, stride, (void*)offset);
+		}
+		glVertexAttribPointer(11, 4, GL_FLOAT, false, stride, (void*)offsetof(InstanceData, extra));
+		for(unsigned int i = 4; i <= 11; i++) {
+			glEnableVertexAttribArray(i);
+			glVertexAttribDivisor(i, divisor);
+		}
+	}
+
+	void uploadInstances(const Vao &vao, const std::vector<InstanceData> &instances)
+	{
+		uploadInstances(vao, instances.data(), instances.size());
+	}
+
+	void uploadInstances(const Vao &vao, const InstanceData *instances, size_t count)
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, vao.buffers.at(4));
+		glBufferData(
+			GL_ARRAY_BUFFER,
+			count * sizeof(InstanceData),
+			instances,
+			GL_STREAM_DRAW
+		);
+	}
+
 	void destroyVao(Vao &vao) 
 	{
 		glDeleteVertexArrays(1, &vao.vaoid);
@@ -620,4 +662,17 @@ namespace gfx {
 	{
 		return glm::vec2(getAngle(n.x, n.z), asinf(n.y));
 	}
+
+	glm::vec2 octahedralEncode(glm::vec3 n)
+	{
+		n /= std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+		//Fold the lower half of the octahedron over the upper half
+		if(n.y < 0.0f) {
+			return glm::vec2(
+				(1.0f - std::abs(n.z)) * (n.x >= 0.0f ? 1.0f : -1.0f),
+				(1.0f - std::abs(n.x)) * (n.z >= 0.0f ? 1.0f : -1.0f)
+			);
+		}
+		return glm::vec2(n.x, n.z);
+	}
 }
@@ -3,6 +3,10 @@
 #include <vector>
 #include <glm/glm.hpp>
 #include <string>
+#include <functional>
+#include <stdint.h>
+
+class ShaderProgram;
 
 namespace mesh {
 	template<typename T>
@@ -64,8 +68,56 @@ namespace mesh {
 	void transformModelTc(Model &model, const glm::mat4 &transform);
 	//Combines two models, returns the combined model
 	Model mergeModels(const Model &model1, const Model &model2);
+	//Adds model2 to the end of model1, this is the same as mergeModels but
+	//does not copy model1 so it should be used when building a model
+	//piece by piece
+	void appendModel(Model &model1, const Model &model2);
 	//Loads a model from an obj file, uses the fast_obj library as a dependency
 	Model loadObjModel(const char *path);
+
+	//Increase this whenever the layout of the cache file changes
+	constexpr uint32_t MODEL_CACHE_VERSION = 1;
+	//A file of models that were generated by the program so that they do
+	//not need to be generated again on the next launch. Each model is
+	//stored with a key that should be made from everything that was used
+	//to generate it. The file is memory mapped and models are only copied
+	//out of it when they are requested
+	class ModelCache {
+		struct Entry {
+			uint64_t key;
+			uint32_t vertexcount;
+			uint32_t indexcount;
+			uint64_t offset;
+		};
+		std::string path;
+		const unsigned char *data = nullptr;
+		size_t datasize = 0;
+		std::vector<Entry> entries;
+		std::vector<std::pair<uint64_t, Model>> added;
+#ifdef _WIN32
+		void *file = nullptr;
+		void *mapping = nullptr;
+#endif
+		void map();
+		void unmap();
+		//Returns nullptr if the key is not in the file
+		const Entry* find(uint64_t key) const;
+	public:
+		//If the file does not exist or is not a valid cache then the
+		//cache starts out empty
+		ModelCache(const char *cachepath);
+		~ModelCache();
+		ModelCache(const ModelCache &) = delete;
+		ModelCache& operator=(const ModelCache &) = delete;
+		//Returns true and copies the model into 'model' if it is cached
+		bool get(uint64_t key, Model &model) const;
+		void add(uint64_t key, const Model &model);
+		//Writes the cache back to disk if any models were added,
+		//returns false if the file could not be written
+		bool save();
+	};
+	//FNV-1a hash that can be used to make keys for the cache
+	uint64_t hashModelKey(const void *bytes, size_t size, uint64_t hash = 14695981039346656037ull);
 }
 
 namespace gfx {
@@ -84,6 +136,90 @@ namespace gfx {
 	Vao createModelVao(const mesh::Model &model);
 	void destroyVao(Vao &vao);
 
+	//Values for each instance drawn with an instance buffer, 'extra' is
+	//used by the bullet trails for the velocity (xyz) and time (w)
+	struct InstanceData {
+		glm::mat4 transform;
+		glm::mat3 normalmat;
+		glm::vec4 extra;
+	};
+	//Adds an instance buffer to a vao made with createModelVao (index 4),
+	//the InstanceData is read at attribute locations 4 to 11 and advances
+	//once every 'divisor' instances
+	void addInstanceBuffer(Vao &vao, unsigned int divisor = 1);
+	//Replaces the contents of the instance buffer of a vao
+	void uploadInstances(const Vao &vao, const std::vector<InstanceData> &instances);
+	void uploadInstances(const Vao &vao, const InstanceData *instances, size_t count);
+
+	//Fixed function state of a draw, by default back faces are culled and
+	//the depth buffer is written to
+	enum RenderState {
+		STATE_DEFAULT = 0,
+		STATE_NO_CULL = 1 << 0,
+		STATE_CULL_FRONT = 1 << 1,
+		STATE_NO_DEPTH_WRITE = 1 << 2,
+	};
+
+	//The layers are drawn in this order, the draws in a layer are sorted
+	//to have as few state changes as possible
+	enum RenderLayer {
+		LAYER_OPAQUE,
+		//Blended with the opaque scene behind it
+		LAYER_TRANSPARENT,
+		//Only drawn where nothing else has been drawn
+		LAYER_SKY,
+		LAYER_EFFECTS,
+	};
+
+	struct DrawPacket {
+		RenderLayer layer = LAYER_OPAQUE;
+		unsigned int state = STATE_DEFAULT;
+		ShaderProgram *shader = nullptr;
+		//Bound to texture unit 0, nothing is bound if this is 0
+		unsigned int texture = 0;
+		GLenum texturetarget = GL_TEXTURE_2D;
+		//If this is null then `draw` has to bind its own vao
+		const Vao *vao = nullptr;
+		//Number of instances that are drawn
+		unsigned int instancecount = 1;
+		//Instances in the render queue that are uploaded to the instance
+		//buffer of the vao right before it is drawn
+		unsigned int firstinstance = 0;
+		unsigned int uploadcount = 0;
+		//Sets the uniforms of the draw
+		std::function<void(ShaderProgram&)> uniforms;
+		//Replaces the default draw call
+		std::function<void(ShaderProgram&)> draw;
+	};
+
+	//Draws are submitted to the queue while the scene is being built and
+	//then sorted by their program, texture and vao so that when the queue
+	//is executed it can skip binding state that is already bound
+	class RenderQueue {
+		struct SortKey {
+			uint64_t key;
+			unsigned int index;
+		};
+		std::vector<DrawPacket> packets;
+		std::vector<SortKey> keys;
+		std::vector<InstanceData> instances;
+		//Currently bound state, ~0 means unknown
+		unsigned int state = ~0u;
+		unsigned int program = ~0u;
+		unsigned int texture = ~0u;
+		unsigned int vao = ~0u;
+		void setState(unsigned int newstate);
+	public:
+		//Adds an instance to the queue, returns its index
+		unsigned int addInstance(const InstanceData &instance);
+		const InstanceData& getInstance(unsigned int index) const;
+		unsigned int instanceCount() const;
+		void submit(const DrawPacket &packet);
+		//Sorts and draws everything that was submitted and then empties the
+		//queue, the fixed function state is reset to STATE_DEFAULT
+		void execute();
+	};
+
 	//Outputs opengl errors
 	void outputErrors();
 	//Converts channels to image format
@@ -102,4 +238,7 @@ namespace gfx {
 	//has magnitude of 1). This can allow for a smaller amount of data to
 	//be used in the mesh and improve performance
 	glm::vec2 compressNormal(glm::vec3 n);
+	//Octahedral encoding of a normal vector, the y axis points towards
+	//the top of the octahedron and both components are in [-1, 1]
+	glm::vec2 octahedralEncode(glm::vec3 n);
 }
@@ -0,0 +1,294 @@
+#include "infworld.hpp"
+#include "jobsystem.hpp"
+#include <math.h>
+
+namespace infworld {
+	//Rounds the result of the division towards negative infinity
+	int floordiv(int a, int b)
+	{
+		int q = a / b;
+		if((a % b != 0) && ((a < 0) != (b < 0)))
+			q--;
+		return q;
+	}
+
+	uint64_t tileKey(unsigned int level, int x, int z)
+	{
+		return
+			(uint64_t(level) << 56) |
+			(uint64_t(uint32_t(x) & 0x0fffffff) << 28) |
+			uint64_t(uint32_t(z) & 0x0fffffff);
+	}
+
+	float tileScale(unsigned int level)
+	{
+		return CHUNK_SZ * float(1 << level);
+	}
+
+	int tileLevel(float chunkscale)
+	{
+		for(int level = 0; level < 24; level++)
+			if(tileScale(level) == chunkscale)
+				return level;
+		return -1;
+	}
+
+	HeightCache::HeightCache(const worldseed &seed, size_t memorybudget) :
+		permutations(seed)
+	{
+		budget = memorybudget;
+	}
+
+	std::shared_ptr<const HeightTile> HeightCache::sampleTile(
+		unsigned int level,
+		int x,
+		int z
+	) {
+		std::shared_ptr<HeightTile> tile = std::make_shared<HeightTile>();
+
+		//Each sample of this tile is sample (2i, 2j) of the lattice one
+		//level below it, this tile covers the area of 3x3 tiles on that level
+		std::shared_ptr<const HeightTile> finer[3][3];
+		bool reuse = false;
+		for(int i = 0; i < 3 && level > 0; i++) {
+			for(int j = 0; j < 3; j++) {
+				finer[i][j] = findTile(level - 1, 2 * x - 1 + i, 2 * z - 1 + j);
+				reuse = reuse || finer[i][j];
+			}
+		}
+
+		if(!reuse) {
+			sampleChunkHeights(*tile, x, z, tileScale(level), permutations);
+			return tile;
+		}
+
+		const int HALF = int(PREC / 2);
+		float spacing = tileScale(level) * 2.0f / float(PREC);
+		std::vector<unsigned int> missing;
+		std::vector<float> xs, zs;
+		for(int i = 0; i < int(TILE_SZ); i++) {
+			for(int j = 0; j < int(TILE_SZ); j++) {
+				int
+					gx = x * int(PREC) - HALF + i,
+					gz = z * int(PREC) - HALF + j;
+				int
+					tx = floordiv(2 * gx + HALF, PREC),
+					tz = floordiv(2 * gz + HALF, PREC);
+				unsigned int index = i * TILE_SZ + j;
+				const HeightTile *src = finer[tx - 2 * x + 1][tz - 2 * z + 1].get();
+				if(!src) {
+					missing.push_back(index);
+					xs.push_back(float(gx) * spacing);
+					zs.push_back(float(gz) * spacing);
+					continue;
+				}
+
+				unsigned int srcindex =
+					(2 * gx - (tx * int(PREC) - HALF)) * TILE_SZ +
+					(2 * gz - (tz * int(PREC) - HALF));
+				tile->heights[index] = src->heights[srcindex];
+				tile->dxs[index] = src->dxs[srcindex];
+				tile->dzs[index] = src->dzs[srcindex];
+			}
+		}
+
+		if(missing.empty())
+			return tile;
+
+		std::vector<float>
+			heights(missing.size()),
+			dxs(missing.size()),
+			dzs(missing.size());
+		getHeightsWithDerivative(
+			xs.data(),
+			zs.data(),
+			heights.data(),
+			dxs.data(),
+			dzs.data(),
+			missing.size(),
+			permutations
+		);
+		for(size_t i = 0; i < missing.size(); i++) {
+			tile->heights[missing[i]] = heights[i];
+			tile->dxs[missing[i]] = dxs[i];
+			tile->dzs[missing[i]] = dzs[i];
+		}
+
+		return tile;
+	}
+
+	void HeightCache::evict()
+	{
+		while(!lru.empty() && tiles.size() * sizeof(HeightTile) > budget) {
+			tiles.erase(lru.back());
+			lru.pop_back();
+		}
+	}
+
+	std::shared_ptr<const HeightTile> HeightCache::findTile(
+		unsigned int level,
+		int x,
+		int z
+	) {
+		std::lock_guard<std::mutex> lock(mutex);
+		auto it = tiles.find(tileKey(level, x, z));
+		if(it == tiles.end())
+			return nullptr;
+		lru.splice(lru.begin(), lru, it->second.lru);
+		return it->second.tile;
+	}
+
+	std::shared_ptr<const HeightTile> HeightCache::getTile(
+		unsigned int level,
+		int x,
+		int z
+	) {
+		std::shared_ptr<const HeightTile> tile = findTile(level, x, z);
+		if(tile)
+			return tile;
+
+		//Sample outside of the lock so that multiple threads can sample
+		//different tiles at the same time
+		tile = sampleTile(level, x, z);
+
+		std::lock_guard<std::mutex> lock(mutex);
+		uint64_t key = tileKey(level, x, z);
+		//Another thread might have added the tile in the meantime
+		auto it = tiles.find(key);
+		if(it != tiles.end())
+			return it->second.tile;
+		lru.push_front(key);
+		tiles[key] = { tile, lru.begin() };
+		evict();
+		return tile;
+	}
+
+	float HeightCache::getHeight(float x, float z)
+	{
+		float height;
+		getHeights(&x, &z, &height, 1);
+		return height;
+	}
+
+	void HeightCache::getHeights(
+		const float *xs,
+		const float *zs,
+		float *heights,
+		size_t count
+	) {
+		const int HALF = int(PREC / 2);
+		float spacing = tileScale(0) * 2.0f / float(PREC);
+
+		//Points that are close together usually fall in the same tile so
+		//hold on to the last one to avoid looking it up again
+		std::shared_ptr<const HeightTile> tile;
+		int lasttx = 0, lasttz = 0;
+		std::vector<size_t> missing;
+		for(size_t k = 0; k < count; k++) {
+			float gx = xs[k] / spacing, gz = zs[k] / spacing;
+			int
+				ix = int(floorf(gx)),
+				iz = int(floorf(gz));
+			int
+				tx = floordiv(ix + HALF, PREC),
+				tz = floordiv(iz + HALF, PREC);
+
+			if(k == 0 || tx != lasttx || tz != lasttz) {
+				tile = findTile(0, tx, tz);
+				lasttx = tx;
+				lasttz = tz;
+			}
+
+			if(!tile) {
+				missing.push_back(k);
+				continue;
+			}
+
+			unsigned int
+				i = ix - (tx * int(PREC) - HALF),
+				j = iz - (tz * int(PREC) - HALF);
+			float
+				fx = gx - float(ix),
+				fz = gz - float(iz);
+			const float *h = tile->heights;
+			float
+				h0 = h[i * TILE_SZ + j] * (1.0f - fz) + h[i * TILE_SZ + j + 1] * fz,
+				h1 = h[(i + 1) * TILE_SZ + j] * (1.0f - fz) + h[(i + 1) * TILE_SZ + j + 1] * fz;
+			heights[k] = h0 * (1.0f - fx) + h1 * fx;
+		}
+
+		if(missing.empty())
+			return;
+
+		//Evaluate the noise for everything that was not cached at once
+		std::vector<float>
+			missingx(missing.size()),
+			missingz(missing.size()),
+			missingheights(missing.size());
+		for(size_t k = 0; k < missing.size(); k++) {
+			missingx[k] = xs[missing[k]];
+			missingz[k] = zs[missing[k]];
+		}
+		infworld::getHeights(
+			missingx.data(),
+			missingz.data(),
+			missingheights.data(),
+			missing.size(),
+			permutations
+		);
+		for(size_t k = 0; k < missing.size(); k++)
+			heights[missing[k]] = missingheights[k];
+	}
+
+	const worldseed& HeightCache::seed() const
+	{
+		return permutations;
+	}
+
+	void HeightCache::setBudget(size_t memorybudget)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		budget = memorybudget;
+		evict();
+	}
+
+	size_t HeightCache::memoryUsed()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return tiles.size() * sizeof(HeightTile);
+	}
+
+	glm::vec2 worldToTerrain(const glm::vec3 &position)
+	{
+		return glm::vec2(
+			position.z / SCALE * float(PREC + 1) / float(PREC),
+			position.x / SCALE * float(PREC + 1) / float(PREC)
+		);
+	}
+
+	float getGroundHeight(HeightCache &heights, const glm::vec3 &position)
+	{
+		glm::vec2 pos = worldToTerrain(position);
+		return heights.getHeight(pos.x, pos.y) * HEIGHT * SCALE;
+	}
+
+	void getGroundHeights(
+		HeightCache &heights,
+		const glm::vec3 *positions,
+		float *groundheights,
+		size_t count
+	) {
+		const size_t BATCH_SZ = 1024;
+		JOBS->parallelFor(count, BATCH_SZ, [&](size_t begin, size_t end) {
+			float xs[BATCH_SZ], zs[BATCH_SZ];
+			for(size_t i = begin; i < end; i++) {
+				glm::vec2 pos = worldToTerrain(positions[i]);
+				xs[i - begin] = pos.x;
+				zs[i - begin] = pos.y;
+			}
+			heights.getHeights(xs, zs, groundheights + begin, end - begin);
+			for(size_t i = begin; i < end; i++)
+				groundheights[i] *= HEIGHT * SCALE;
+		});
+	}
+}
@@ -0,0 +1,225 @@
+#include "infworld.hpp"
+#include <math.h>
+#include <limits>
+#include <algorithm>
+
+//Closest distance that is sampled, terrain closer than this never hides
+//anything. This is kept well above the distance the camera can move
+//before the map is rebuilt.
+constexpr float HORIZON_NEAR = 4.0f * infworld::HORIZON_REBUILD_DISTANCE;
+
+namespace {
+	//Returns the bounding rectangle (x and z) of the part of a ring
+	//between two distances and two angles around the origin
+	void sectorBounds(
+		float angle0,
+		float angle1,
+		float dist0,
+		float dist1,
+		glm::vec2 &lower,
+		glm::vec2 &upper
+	) {
+		glm::vec2 dir0(cosf(angle0), sinf(angle0)), dir1(cosf(angle1), sinf(angle1));
+		lower = glm::min(glm::min(dir0 * dist0, dir0 * dist1), glm::min(dir1 * dist0, dir1 * dist1));
+		upper = glm::max(glm::max(dir0 * dist0, dir0 * dist1), glm::max(dir1 * dist0, dir1 * dist1));
+		//The arc bulges out past the corners where it crosses an axis
+		for(int i = 0; i < 4; i++) {
+			float axisangle = float(i) * 0.5f * float(M_PI);
+			if(axisangle < angle0 || axisangle > angle1)
+				continue;
+			glm::vec2 dir(cosf(axisangle), sinf(axisangle));
+			lower = glm::min(lower, dir * dist1);
+			upper = glm::max(upper, dir * dist1);
+		}
+	}
+
+	//Distance along x or z from the origin to the closest and farthest
+	//points of a rectangle
+	void rectRange(const glm::vec2 &lower, const glm::vec2 &upper, float &mindist, float &maxdist)
+	{
+		glm::vec2 closest = glm::max(glm::max(lower, -upper), glm::vec2(0.0f));
+		glm::vec2 farthest = glm::max(glm::abs(lower), glm::abs(upper));
+		mindist = std::max(closest.x, closest.y);
+		maxdist = std::max(farthest.x, farthest.y);
+	}
+}
+
+namespace infworld {
+	void HorizonMap::build(
+		ChunkTable *chunktables,
+		unsigned int count,
+		const glm::vec3 &camera,
+		float maxdist
+	) {
+		buildpos = camera;
+		glm::vec3 position = camera + glm::vec3(0.0f, HORIZON_REBUILD_DISTANCE, 0.0f);
+		camerapos = position;
+		growth = powf(maxdist / HORIZON_NEAR, 1.0f / float(HORIZON_STEPS));
+		float d = HORIZON_NEAR;
+		for(unsigned int j = 0; j < HORIZON_STEPS; j++) {
+			d *= growth;
+			distances[j] = d;
+		}
+
+		//Each level of detail is drawn in a ring around the camera (see
+		//gfx::displayTerrain), the rings are widened by the distance the
+		//camera can move before the map is rebuilt
+		const float infinity = std::numeric_limits<float>::infinity();
+		std::vector<float> ringstart(count), ringend(count);
+		versions.resize(count);
+		float start = 0.0f;
+		for(unsigned int i = 0; i < count; i++) {
+			float end = i < count - 1 ? chunktables[i].lodRange() : infinity;
+			ringstart[i] = start - HORIZON_REBUILD_DISTANCE;
+			ringend[i] = end + HORIZON_REBUILD_DISTANCE;
+			versions[i] = chunktables[i].version();
+			start = end;
+		}
+
+		horizon.resize(HORIZON_DIRECTIONS * HORIZON_STEPS);
+		glm::vec2 center(position.x, position.z);
+		float wedge = (2.0f * float(M_PI)) / float(HORIZON_DIRECTIONS);
+		for(unsigned int i = 0; i < HORIZON_DIRECTIONS; i++) {
+			float highest = -infinity;
+			for(unsigned int j = 0; j < HORIZON_STEPS; j++) {
+				float dist0 = j > 0 ? distances[j - 1] : HORIZON_NEAR, dist1 = distances[j];
+				glm::vec2 lower, upper;
+				sectorBounds(float(i) * wedge, float(i + 1) * wedge, dist0, dist1, lower, upper);
+				//Moving the camera sideways is the same as moving the terrain
+				//the other way so use the lowest terrain nearby
+				lower -= glm::vec2(HORIZON_REBUILD_DISTANCE);
+				upper += glm::vec2(HORIZON_REBUILD_DISTANCE);
+				float closest, farthest;
+				rectRange(lower, upper, closest, farthest);
+
+				//Only the levels of detail that can be drawn in the sector
+				//are used, if none of them are then nothing is drawn there
+				float lowest = infinity;
+				for(unsigned int k = 0; k < count; k++) {
+					if(farthest < ringstart[k] || closest >= ringend[k])
+						continue;
+					glm::vec2
+						cliplower = glm::max(lower, -glm::vec2(ringend[k])),
+						clipupper = glm::min(upper, glm::vec2(ringend[k]));
+					lowest = std::min(
+						lowest,
+						chunktables[k].lowestHeight(cliplower + center, clipupper + center)
+					);
+				}
+				if(lowest == infinity)
+					lowest = -infinity;
+
+				//The lowest slope of that height anywhere in the sector
+				float height = lowest - position.y;
+				float slope = height > 0.0f ? height / dist1 : height / dist0;
+				highest = std::max(highest, slope);
+				horizon[i * HORIZON_STEPS + j] = highest;
+			}
+		}
+
+		built = true;
+	}
+
+	bool HorizonMap::update(
+		ChunkTable *chunktables,
+		unsigned int count,
+		const glm::vec3 &position,
+		float maxdist
+	) {
+		bool changed = !built || versions.size() != count;
+		for(unsigned int i = 0; i < count && !changed; i++)
+			changed = versions[i] != chunktables[i].version();
+		if(!changed && glm::length(position - buildpos) < HORIZON_REBUILD_DISTANCE)
+			return false;
+		build(chunktables, count, position, maxdist);
+		return true;
+	}
+
+	//Returns the slope of the horizon in a wedge from terrain that is
+	//closer than `distance`
+	float HorizonMap::maxSlope(unsigned int direction, float distance) const
+	{
+		if(distance <= distances[0])
+			return -std::numeric_limits<float>::infinity();
+		//Last step that is closer than the distance
+		int step = int(ceilf(logf(distance / HORIZON_NEAR) / logf(growth))) - 2;
+		step = std::min(std::max(step, 0), int(HORIZON_STEPS) - 1);
+		//Correct for rounding errors in the logarithm
+		while(step > 0 && distances[step] >= distance)
+			step--;
+		while(step < int(HORIZON_STEPS) - 1 && distances[step + 1] < distance)
+			step++;
+		if(distances[step] >= distance)
+			return -std::numeric_limits<float>::infinity();
+		return horizon[direction * HORIZON_STEPS + step];
+	}
+
+	bool HorizonMap::isBuilt() const
+	{
+		return built;
+	}
+
+	void HorizonMap::clear()
+	{
+		built = false;
+		horizon.clear();
+		versions.clear();
+	}
+
+	bool HorizonMap::occluded(const glm::vec3 &lower, const glm::vec3 &upper) const
+	{
+		if(!built)
+			return false;
+
+		//The box is widened by the distance the camera can move before the
+		//map is rebuilt, the same as the occluders
+		glm::vec2
+			boxlower = glm::vec2(lower.x, lower.z) - glm::vec2(camerapos.x, camerapos.z),
+			boxupper = glm::vec2(upper.x, upper.z) - glm::vec2(camerapos.x, camerapos.z);
+		boxlower -= glm::vec2(HORIZON_REBUILD_DISTANCE);
+		boxupper += glm::vec2(HORIZON_REBUILD_DISTANCE);
+		//The camera is above or below the box
+		if(boxlower.x <= 0.0f && boxupper.x >= 0.0f && boxlower.y <= 0.0f && boxupper.y >= 0.0f)
+			return false;
+
+		glm::vec2 closest = glm::max(glm::max(boxlower, -boxupper), glm::vec2(0.0f));
+		glm::vec2 farthest = glm::max(glm::abs(boxlower), glm::abs(boxupper));
+		float mindist = glm::length(closest), maxdist = glm::length(farthest);
+		//The slope of the highest point of the box as seen from the camera
+		float height = upper.y - camerapos.y;
+		float slope = height > 0.0f ? height / mindist : height / maxdist;
+
+		//Find the directions that the box covers, the box does not contain
+		//the camera so it covers less than half of the circle
+		glm::vec2 center = (boxlower + boxupper) * 0.5f;
+		float centerangle = atan2f(center.y, center.x);
+		float minangle = 0.0f, maxangle = 0.0f;
+		glm::vec2 corners[] = {
+			boxlower,
+			glm::vec2(boxupper.x, boxlower.y),
+			glm::vec2(boxlower.x, boxupper.y),
+			boxupper,
+		};
+		for(const glm::vec2 &corner : corners) {
+			float angle = atan2f(corner.y, corner.x) - centerangle;
+			if(angle > float(M_PI))
+				angle -= (2.0f * float(M_PI));
+			else if(angle < -float(M_PI))
+				angle += (2.0f * float(M_PI));
+			minangle = std::min(minangle, angle);
+			maxangle = std::max(maxangle, angle);
+		}
+
+		float wedge = (2.0f * float(M_PI)) / float(HORIZON_DIRECTIONS);
+		int first = int(floorf((centerangle + minangle) / wedge));
+		int last = int(floorf((centerangle + maxangle) / wedge));
+		for(int i = first; i <= last; i++) {
+			int direction = i % int(HORIZON_DIRECTIONS);
+			if(direction < 0)
+				direction += HORIZON_DIRECTIONS;
+			if(maxSlope(direction, mindist) <= slope)
+				return false;
+		}
+		return true;
+	}
+}
@@ -2,7 +2,10 @@
 #include <random>
 #include <glad/glad.h>
 #include <chrono>
-#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "jobsystem.hpp"
+#include <algorithm>
 
 namespace infworld {
 	worldseed makePermutations(int seed, unsigned int count)
@@ -26,6 +29,33 @@ namespace infworld {
 		return (x - lowerx) / (upperx - lowerx) * (b - a) + a;
 	}
 
+	//Maps the raw sum of the noise octaves to the final terrain height
+	float remapHeight(float height)
+	{
+		if(height < -0.1f)
+			height = interpolate(height, -1.0f, -0.1f, -1.0f, 0.003f);
+		else if(height >= -0.1f && height < 0.0f)
+			height = interpolate(height, -0.1f, 0.0f, 0.003f, 0.03f);
+		else if(height >= 0.0f && height < 0.15f)
+			height = interpolate(height, 0.0f, 0.15f, 0.03f, 0.12f);
+		else if(height >= 0.1f)
+			height = interpolate(height, 0.15f, 1.0f, 0.12f, 1.0f);
+
+		return height; //normalized to be between -1.0 and 1.0
+	}
+
+	//Returns the slope of the section of remapHeight that `height` falls in
+	float remapHeightSlope(float height)
+	{
+		if(height < -0.1f)
+			return (0.003f - -1.0f) / (-0.1f - -1.0f);
+		else if(height >= -0.1f && height < 0.0f)
+			return (0.03f - 0.003f) / (0.0f - -0.1f);
+		else if(height >= 0.0f && height < 0.15f)
+			return (0.12f - 0.03f) / (0.15f - 0.0f);
+		return (1.0f - 0.12f) / (1.0f - 0.15f);
+	}
+
 	float getHeight(float x, float z, const worldseed &permutations) 
 	{
 		float height = 0.0f;
@@ -39,16 +69,183 @@ namespace infworld {
 			amplitude /= 2.0f;
 		}
 
-		if(height < -0.1f)
-			height = interpolate(height, -1.0f, -0.1f, -1.0f, 0.003f);
-		else if(height >= -0.1f && height < 0.0f)
-			height = interpolate(height, -0.1f, 0.0f, 0.003f, 0.03f);
-		else if(height >= 0.0f && height < 0.15f)
-			height = interpolate(height, 0.0f, 0.15f, 0.03f, 0.12f);
-		else if(height >= 0.1f)
-			height = interpolate(height, 0.15f, 1.0f, 0.12f, 1.0f);
+		return remapHeight(height);
+	}
 
-		return height; //normalized to be between -1.0 and 1.0
+	void getHeights(
+		const float *xs,
+		const float *zs,
+		float *heights,
+		size_t count,
+		const worldseed &permutations
+	) {
+		//Work on small blocks so that the scaled coordinates stay in cache
+		const size_t BLOCK_SZ = 256;
+		float scaledx[BLOCK_SZ], scaledz[BLOCK_SZ], octave[BLOCK_SZ];
+
+		for(size_t start = 0; start < count; start += BLOCK_SZ) {
+			size_t n = std::min(BLOCK_SZ, count - start);
+			float *height = heights + start;
+			for(size_t i = 0; i < n; i++)
+				height[i] = 0.0f;
+
+			float freq = FREQUENCY;
+			float amplitude = 1.0f;
+			for(int i = 0; i < permutations.size(); i++) {
+				for(size_t j = 0; j < n; j++) {
+					scaledx[j] = xs[start + j] / freq;
+					scaledz[j] = zs[start + j] / freq;
+				}
+				perlin::noise(scaledx, scaledz, octave, n, permutations[i]);
+				for(size_t j = 0; j < n; j++)
+					height[j] += octave[j] * amplitude;
+				freq /= 2.0f;
+				amplitude /= 2.0f;
+			}
+
+			for(size_t i = 0; i < n; i++)
+				height[i] = remapHeight(height[i]);
+		}
+	}
+
+	glm::vec3 getHeightWithDerivative(float x, float z, const worldseed &permutations)
+	{
+		float height = 0.0f;
+		glm::vec2 derivative(0.0f);
+		float freq = FREQUENCY;
+		float amplitude = 1.0f;
+
+		for(int i = 0; i < permutations.size(); i++) {
+			glm::vec3 n = perlin::noiseWithDerivative(x / freq, z / freq, permutations[i]);
+			height += n.x * amplitude;
+			derivative += glm::vec2(n.y, n.z) * (amplitude / freq);
+			freq /= 2.0f;
+			amplitude /= 2.0f;
+		}
+
+		derivative *= remapHeightSlope(height);
+		return glm::vec3(remapHeight(height), derivative.x, derivative.y);
+	}
+
+	void getHeightsWithDerivative(
+		const float *xs,
+		const float *zs,
+		float *heights,
+		float *dxs,
+		float *dzs,
+		size_t count,
+		const worldseed &permutations
+	) {
+		const size_t BLOCK_SZ = 256;
+		float scaledx[BLOCK_SZ], scaledz[BLOCK_SZ];
+		float octave[BLOCK_SZ], octavedx[BLOCK_SZ], octavedz[BLOCK_SZ];
+
+		for(size_t start = 0; start < count; start += BLOCK_SZ) {
+			size_t n = std::min(BLOCK_SZ, count - start);
+			float 
+				*height = heights + start,
+				*dx = dxs + start,
+				*dz = dzs + start;
+			for(size_t i = 0; i < n; i++) {
+				height[i] = 0.0f;
+				dx[i] = 0.0f;
+				dz[i] = 0.0f;
+			}
+
+			float freq = FREQUENCY;
+			float amplitude = 1.0f;
+			for(int i = 0; i < permutations.size(); i++) {
+				for(size_t j = 0; j < n; j++) {
+					scaledx[j] = xs[start + j] / freq;
+					scaledz[j] = zs[start + j] / freq;
+				}
+				perlin::noiseWithDerivative(
+					scaledx,
+					scaledz,
+					octave,
+					octavedx,
+					octavedz,
+					n,
+					permutations[i]
+				);
+				//Chain rule: we sampled the noise at x / freq
+				float derivativescale = amplitude / freq;
+				for(size_t j = 0; j < n; j++) {
+					height[j] += octave[j] * amplitude;
+					dx[j] += octavedx[j] * derivativescale;
+					dz[j] += octavedz[j] * derivativescale;
+				}
+				freq /= 2.0f;
+				amplitude /= 2.0f;
+			}
+
+			for(size_t i = 0; i < n; i++) {
+				float slope = remapHeightSlope(height[i]);
+				dx[i] *= slope;
+				dz[i] *= slope;
+				height[i] = remapHeight(height[i]);
+			}
+		}
+	}
+
+	void getHeightGrid(
+		const float *xs,
+		size_t xcount,
+		const float *zs,
+		size_t zcount,
+		float *heights,
+		const worldseed &permutations
+	) {
+		//Lay the grid out as rows along z so that neighbouring samples
+		//are next to each other for the batched noise function
+		std::vector<float> gridx(xcount * zcount), gridz(xcount * zcount);
+		for(size_t i = 0; i < xcount; i++) {
+			for(size_t j = 0; j < zcount; j++) {
+				gridx[i * zcount + j] = xs[i];
+				gridz[i * zcount + j] = zs[j];
+			}
+		}
+		getHeights(gridx.data(), gridz.data(), heights, xcount * zcount, permutations);
+	}
+
+	void getHeightGridWithDerivative(
+		const float *xs,
+		size_t xcount,
+		const float *zs,
+		size_t zcount,
+		float *heights,
+		float *dxs,
+		float *dzs,
+		const worldseed &permutations
+	) {
+		std::vector<float> gridx(xcount * zcount), gridz(xcount * zcount);
+		for(size_t i = 0; i < xcount; i++) {
+			for(size_t j = 0; j < zcount; j++) {
+				gridx[i * zcount + j] = xs[i];
+				gridz[i * zcount + j] = zs[j];
+			}
+		}
+		getHeightsWithDerivative(
+			gridx.data(),
+			gridz.data(),
+			heights,
+			dxs,
+			dzs,
+			xcount * zcount,
+			permutations
+		);
+	}
+
+	//Scales a normalized height by maxheight and pushes it slightly away
+	//from 0.0 so that the terrain does not z-fight with the water
+	float terrainHeight(float h, float maxheight)
+	{
+		h *= maxheight;
+		if(h <= 0.0f)
+			h = std::min(-0.007f, h);
+		else if(h >= 0.0f)
+			h = std::max(0.007f, h);
+		return h;
 	}
 
 	glm::vec3 getTerrainVertex(
@@ -57,49 +254,95 @@ namespace infworld {
 		const worldseed &permutations,
 		float maxheight
 	) {
-		float h = getHeight(x, z, permutations) * maxheight;
-		if(h <= 0.0f)
-			h = std::min(-0.007f, h);
-		else if(h >= 0.0f)
-			h = std::max(0.007f, h);
+		float h = terrainHeight(getHeight(x, z, permutations), maxheight);
 		return glm::vec3(x, h, z);
 	}
 
-	mesh::ElementArrayBuffer<float> createChunkElementArray(
-		const worldseed &permutations,
+	void sampleChunkHeights(
+		HeightTile &tile,
 		int chunkx,
 		int chunkz,
-		float maxheight,
-		float chunkscale
+		float chunkscale,
+		const worldseed &permutations
 	) {
-		mesh::ElementArrayBuffer<float> worldarraybuffer;
+		//Samples lie on a lattice that is shared by every chunk with the same
+		//scale so that the edges of neighbouring chunks match exactly
+		float spacing = chunkscale * 2.0f / float(PREC);
+		float xs[TILE_SZ], zs[TILE_SZ];
+		for(int i = 0; i < int(TILE_SZ); i++) {
+			xs[i] = float(chunkx * int(PREC) - int(PREC / 2) + i) * spacing;
+			zs[i] = float(chunkz * int(PREC) - int(PREC / 2) + i) * spacing;
+		}
 
-		worldarraybuffer.mesh.vertices.reserve(PREC * PREC * 3 * 2);
+		getHeightGridWithDerivative(
+			xs,
+			TILE_SZ,
+			zs,
+			TILE_SZ,
+			tile.heights,
+			tile.dxs,
+			tile.dzs,
+			permutations
+		);
+	}
 
-		for(unsigned int i = 0; i <= PREC; i++) {
-			for(unsigned int j = 0; j <= PREC; j++) {
-				float x = -chunkscale + float(i) / float(PREC) * chunkscale * 2.0f;
-				float z = -chunkscale + float(j) / float(PREC) * chunkscale * 2.0f;
-				float tx = x + float(chunkx) * chunkscale * 2.0f;
-				float tz = z + float(chunkz) * chunkscale * 2.0f;
+	ChunkVertex packChunkVertex(float height, glm::vec3 normal)
+	{
+		int16_t h = int16_t(std::round(std::min(std::max(height, -1.0f), 1.0f) * 32767.0f));
+		glm::vec2 n = gfx::octahedralEncode(normal) * 0.5f + 0.5f;
+		uint32_t nx = uint32_t(std::round(n.x * 255.0f));
+		uint32_t nz = uint32_t(std::round(n.y * 255.0f));
+		return uint32_t(uint16_t(h)) | (nx << 16) | (nz << 24);
+	}
 
-				glm::vec3 vertex = getTerrainVertex(tx, tz, permutations, maxheight);
+	mesh::ElementArrayBuffer<ChunkVertex> createChunkElementArray(
+		const HeightTile &tile,
+		float maxheight
+	) {
+		mesh::ElementArrayBuffer<ChunkVertex> worldarraybuffer;
 
-				glm::vec3
-					v1 = getTerrainVertex(tx + 0.01f, tz, permutations, maxheight),
-					v2 = getTerrainVertex(tx, tz + 0.01f, permutations, maxheight),
-					norm = glm::normalize(glm::cross(v2 - vertex, v1 - vertex));
-				glm::vec2 n = gfx::compressNormal(norm);
+		worldarraybuffer.mesh.vertices.reserve(TILE_SZ * TILE_SZ);
 
-				worldarraybuffer.mesh.vertices.push_back(vertex.y / maxheight);	
-				worldarraybuffer.mesh.vertices.push_back(n.x);
-				worldarraybuffer.mesh.vertices.push_back(n.y);
-			}
+		for(unsigned int i = 0; i < TILE_SZ * TILE_SZ; i++) {
+			float h = terrainHeight(tile.heights[i], maxheight);
+			//Terrain that gets pushed away from the water level is flat
+			glm::vec2 slope = glm::vec2(tile.dxs[i], tile.dzs[i]) * maxheight;
+			if(h != tile.heights[i] * maxheight)
+				slope = glm::vec2(0.0f);
+			glm::vec3 norm = glm::normalize(glm::vec3(-slope.x, 1.0f, -slope.y));
+			worldarraybuffer.mesh.vertices.push_back(packChunkVertex(h / maxheight, norm));
 		}
 
 		return worldarraybuffer;
 	}
 
+	mesh::ElementArrayBuffer<ChunkVertex> createChunkElementArray(
+		const worldseed &permutations,
+		int chunkx,
+		int chunkz,
+		float maxheight,
+		float chunkscale
+	) {
+		std::unique_ptr<HeightTile> tile = std::make_unique<HeightTile>();
+		sampleChunkHeights(*tile, chunkx, chunkz, chunkscale, permutations);
+		return createChunkElementArray(*tile, maxheight);
+	}
+
+	//Records the height range of the vertices for culling
+	void findHeightBounds(ChunkData &chunk)
+	{
+		int16_t lowest = INT16_MAX, highest = INT16_MIN;
+		for(ChunkVertex v : chunk.chunkmesh.mesh.vertices) {
+			int16_t h = int16_t(v & 0xffff);
+			lowest = std::min(lowest, h);
+			highest = std::max(highest, h);
+		}
+		if(lowest > highest)
+			return;
+		chunk.minheight = float(lowest) / 32767.0f;
+		chunk.maxheight = float(highest) / 32767.0f;
+	}
+
 	ChunkData buildChunk(
 		const infworld::worldseed &permutations,
 		int x,
@@ -107,68 +350,155 @@ namespace infworld {
 		float maxheight,
 		float chunkscale
 	) {
-		return {
+		ChunkData chunk = {
 			infworld::createChunkElementArray(permutations, x, z, maxheight, chunkscale),
 			{ x, z }
 		};
+		findHeightBounds(chunk);
+		return chunk;
 	}
 
-	inline unsigned int joinBuilderThreads(
-		std::vector<std::thread> &builders,
-		const std::vector<ChunkData> &builtchunks,
-		ChunkTable &chunks,
-		unsigned int ind,
-		unsigned int maxsz
+	ChunkData buildChunk(
+		HeightCache &heights,
+		int x,
+		int z,
+		float maxheight,
+		float chunkscale
 	) {
-		if(builders.size() < maxsz)
-			return 0;
-		for(auto &th : builders)
-			th.join();
-		for(int i = 0; i < builders.size(); i++)
-			chunks.addChunk(ind + i, builtchunks.at(i));
-		unsigned int sz = builders.size();
-		builders.clear();
-		return sz;
+		int level = tileLevel(chunkscale);
+		if(level < 0)
+			return buildChunk(heights.seed(), x, z, maxheight, chunkscale);
+		std::shared_ptr<const HeightTile> tile = heights.getTile(level, x, z);
+		ChunkData chunk = { createChunkElementArray(*tile, maxheight), { x, z } };
+		findHeightBounds(chunk);
+		return chunk;
 	}
 
-	ChunkTable buildWorld(
+	void buildChunks(
 		unsigned int range,
-		const infworld::worldseed &permutations,
+		HeightCache &heights,
 		float maxheight,
-		float chunkscale 
+		float chunkscale,
+		unsigned int lodcount,
+		float lodscale,
+		const ChunkBuiltCallback &onbuilt
 	) {
-		auto starttime = std::chrono::steady_clock::now();
-		unsigned int threadcount = 
-			std::max<unsigned int>(std::thread::hardware_concurrency(), 4);
-	
-		std::vector<ChunkData> builtchunks(threadcount);
-		ChunkTable chunks(range, chunkscale, maxheight);
-		chunks.genBuffers();
-		auto build = 
-			[&builtchunks, &permutations, &maxheight, &chunkscale]
-			(int x, int z, int i) {
-				builtchunks[i] = buildChunk(permutations, x, z, maxheight, chunkscale);
-			};
-		
-		//Multithreading to speed up terrain generation/building
-		std::vector<std::thread> builders; 
-		int ind = 0;
-		for(int x = -int(range); x <= int(range); x++) {
-			for(int z = -int(range); z <= int(range); z++) {
-				builders.push_back(std::thread(build, x, z, builders.size()));
-				unsigned int sz = 	
-					joinBuilderThreads(builders, builtchunks, chunks, ind, threadcount);
-				ind += sz;
+		struct BuiltChunk {
+			unsigned int lod, index;
+			ChunkData chunk;
+		};
+
+		//Finished chunks are passed back to the calling thread through this
+		//queue so that they can be handed to onbuilt as soon as possible
+		std::mutex mutex;
+		std::condition_variable finished;
+		std::vector<BuiltChunk> built;
+
+		unsigned int size = 2 * range + 1;
+		unsigned int total = size * size * lodcount;
+		float scale = chunkscale;
+		for(unsigned int lod = 0; lod < lodcount; lod++) {
+			unsigned int index = 0;
+			for(int x = -int(range); x <= int(range); x++) {
+				for(int z = -int(range); z <= int(range); z++) {
+					JOBS->submit([&, lod, index, x, z, scale]() {
+						ChunkData chunk = buildChunk(heights, x, z, maxheight, scale);
+						std::lock_guard<std::mutex> lock(mutex);
+						built.push_back({ lod, index, std::move(chunk) });
+						finished.notify_one();
+					});
+					index++;
+				}
 			}
+			scale *= lodscale;
 		}
 
-		joinBuilderThreads(builders, builtchunks, chunks, ind, 0);
+		std::vector<BuiltChunk> ready;
+		unsigned int received = 0;
+		while(received < total) {
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				//Help out with building chunks if nothing is ready yet
+				while(built.empty()) {
+					lock.unlock();
+					bool ran = JOBS->runPendingJob();
+					lock.lock();
+					if(!ran)
+						finished.wait(lock, [&built]() { return !built.empty(); });
+				}
+				ready.swap(built);
+			}
+
+			for(const auto &chunk : ready)
+				onbuilt(chunk.lod, chunk.index, chunk.chunk);
+			received += ready.size();
+			ready.clear();
+		}
+	}
+
+	void buildWorlds(
+		ChunkTable *chunktables,
+		unsigned int lodcount,
+		float lodscale,
+		unsigned int range,
+		HeightCache &heights,
+		float maxheight,
+		float chunkscale,
+		std::shared_ptr<GPUChunkGenerator> generator
+	) {
+		auto starttime = std::chrono::steady_clock::now();
+
+		float scale = chunkscale;
+		for(unsigned int i = 0; i < lodcount; i++) {
+			chunktables[i] = ChunkTable(
+				range,
+				scale,
+				maxheight,
+				std::make_shared<GLChunkBackend>(generator)
+			);
+			chunktables[i].genBuffers();
+			scale *= lodscale;
+		}
+
+		if(generator) {
+			//Slots are laid out in the same order as in buildChunks
+			for(unsigned int lod = 0; lod < lodcount; lod++) {
+				unsigned int index = 0;
+				for(int x = -int(range); x <= int(range); x++)
+					for(int z = -int(range); z <= int(range); z++)
+						chunktables[lod].generateChunk(index++, { x, z });
+			}
+			glFinish();
+		}
+		else {
+			buildChunks(
+				range,
+				heights,
+				maxheight,
+				chunkscale,
+				lodcount,
+				lodscale,
+				[chunktables](unsigned int lod, unsigned int index, const ChunkData &chunk) {
+					chunktables[lod].addChunk(index, chunk);
+				}
+			);
+		}
 
 		auto endtime = std::chrono::steady_clock::now();
 		std::chrono::duration<double> duration = endtime - starttime;
 		double time = duration.count();
 		printf("Time to generate world: %f\n", time);
-	
+	}
+
+	ChunkTable buildWorld(
+		unsigned int range,
+		const infworld::worldseed &permutations,
+		float maxheight,
+		float chunkscale 
+	) {
+		ChunkTable chunks;
+		HeightCache heights(permutations);
+		buildWorlds(&chunks, 1, 1.0f, range, heights, maxheight, chunkscale);
 		return chunks;
 	}
 
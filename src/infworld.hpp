@@ -4,6 +4,11 @@
 #include <glm/glm.hpp>
 #include <random>
 #include <unordered_map>
+#include <list>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
 #include "noise.hpp"
 #include "gfx.hpp"
 #include "geometry.hpp"
@@ -14,14 +19,14 @@ constexpr float CHUNK_SZ = 64.0f;
 constexpr float HEIGHT = 270.0f;
 constexpr float SCALE = 2.5f;
 constexpr float FREQUENCY = 720.0f;
-constexpr size_t CHUNK_VERT_SZ = 3;
-constexpr size_t CHUNK_VERT_SZ_BYTES = CHUNK_VERT_SZ * sizeof(float);
 constexpr unsigned int CHUNK_VERT_COUNT = PREC * PREC * 6;
-//2 buffers per chunk:
-//0 -> position
-//1 -> normals
-//2 -> indices
-constexpr unsigned int BUFFER_PER_CHUNK = 3;
+//Number of vertices in a chunk
+constexpr unsigned int CHUNK_VERTICES = (PREC + 1) * (PREC + 1);
+//Number of height samples along each side of a chunk
+constexpr unsigned int TILE_SZ = PREC + 1;
+//Default amount of memory used to cache heights (in bytes)
+constexpr size_t HEIGHT_CACHE_BUDGET = 32 * 1024 * 1024;
+static_assert(PREC % 2 == 0, "chunks are centered on a lattice point");
 
 namespace infworld {
 	//We will use a seed value (an integer) to generate multiple
@@ -33,22 +38,181 @@ namespace infworld {
 		int x = 0, z = 0;
 	};
 
+	//Terrain vertices are packed into 32 bits, the lower 16 bits are the
+	//height divided by the max height as a signed integer scaled by 32767
+	//and the upper 16 bits are the octahedral encoded normal with 8 bits
+	//for each component
+	typedef uint32_t ChunkVertex;
+	constexpr size_t CHUNK_VERT_SZ_BYTES = sizeof(ChunkVertex);
+
 	struct ChunkData {
-		mesh::ElementArrayBuffer<float> chunkmesh;
+		mesh::ElementArrayBuffer<ChunkVertex> chunkmesh;
 		ChunkPos position;
+		//Lowest and highest vertex of the chunk divided by the max height,
+		//used for culling
+		float minheight = -1.0f, maxheight = 1.0f;
+	};
+
+	//Heights and slopes of a chunk sampled at its vertices,
+	//heights[i * TILE_SZ + j] is the height of vertex (i, j)
+	struct HeightTile {
+		float heights[TILE_SZ * TILE_SZ];
+		float dxs[TILE_SZ * TILE_SZ];
+		float dzs[TILE_SZ * TILE_SZ];
 	};
 
+	//Cache of sampled chunk heights that is shared by chunk building and
+	//gameplay height queries. Tile (level, x, z) covers the same area as
+	//chunk (x, z) with a scale of CHUNK_SZ * 2^level, every sample of a tile
+	//is also a sample of the tiles one level below it so those are reused
+	//when they are cached. Tiles are evicted in least recently used order
+	//once the memory budget is exceeded, the cache is thread safe.
+	class HeightCache {
+		struct CachedTile {
+			std::shared_ptr<const HeightTile> tile;
+			std::list<uint64_t>::iterator lru;
+		};
+
+		//The permutations must outlive the cache
+		const worldseed &permutations;
+		size_t budget;
+		std::mutex mutex;
+		//Most recently used tiles are at the front
+		std::list<uint64_t> lru;
+		std::unordered_map<uint64_t, CachedTile> tiles;
+
+		std::shared_ptr<const HeightTile> sampleTile(unsigned int level, int x, int z);
+		void evict();
+	public:
+		HeightCache(const worldseed &seed, size_t memorybudget = HEIGHT_CACHE_BUDGET);
+		//Returns the tile, it is sampled if it is not in the cache
+		std::shared_ptr<const HeightTile> getTile(unsigned int level, int x, int z);
+		//Returns nullptr if the tile is not in the cache
+		std::shared_ptr<const HeightTile> findTile(unsigned int level, int x, int z);
+		//Same as infworld::getHeight, if the finest tile containing (x, z)
+		//is cached the height is bilinearly interpolated from its samples
+		//otherwise the noise is evaluated
+		float getHeight(float x, float z);
+		//Batched version of getHeight
+		void getHeights(const float *xs, const float *zs, float *heights, size_t count);
+		const worldseed& seed() const;
+		void setBudget(size_t memorybudget);
+		size_t memoryUsed();
+	};
+
+	//Converts a position in world space to the coordinates that are passed
+	//to getHeight (the terrain is scaled by SCALE and the x and z axes are
+	//swapped)
+	glm::vec2 worldToTerrain(const glm::vec3 &position);
+	//Returns the height of the ground below a position in world space
+	float getGroundHeight(HeightCache &heights, const glm::vec3 &position);
+	//Sets groundheights[i] to the height of the ground below positions[i],
+	//large batches are split up between the threads of the job system
+	void getGroundHeights(
+		HeightCache &heights,
+		const glm::vec3 *positions,
+		float *groundheights,
+		size_t count
+	);
+
+	//Number of directions and distances sampled by HorizonMap
+	constexpr unsigned int HORIZON_DIRECTIONS = 128;
+	constexpr unsigned int HORIZON_STEPS = 64;
+	//The horizon map is only rebuilt once the camera moves this far
+	constexpr float HORIZON_REBUILD_DISTANCE = 8.0f;
+
+	class ChunkTable;
+
+	//For each direction around the camera this stores how high the
+	//terrain rises above the camera (as a slope) up to each distance, a
+	//box that stays below that slope is hidden behind terrain. The terrain
+	//is divided into sectors (a wedge between two directions and two
+	//distances) and each sector only uses the lowest vertex of the chunks
+	//that can be drawn in it so the test never hides something that is
+	//visible. The map is built from a point HORIZON_REBUILD_DISTANCE above
+	//the camera and the occluders and boxes are widened by the same amount
+	//so that it stays valid until the camera has moved that far.
+	class HorizonMap {
+		glm::vec3 camerapos = glm::vec3(0.0f);
+		//Where the camera was when the map was built
+		glm::vec3 buildpos = glm::vec3(0.0f);
+		bool built = false;
+		//Distance to the far edge of each step, these grow geometrically
+		float distances[HORIZON_STEPS];
+		float growth = 1.0f;
+		//horizon[i * HORIZON_STEPS + j] is the lowest slope that the terrain
+		//is guaranteed to reach in the wedge between direction i and i + 1
+		//at distances up to distances[j]
+		std::vector<float> horizon;
+		//Versions of the chunk tables the map was built from
+		std::vector<unsigned int> versions;
+		float maxSlope(unsigned int direction, float distance) const;
+	public:
+		//Finds the occluders around the camera up to `maxdist` from the
+		//chunks in `chunktables` (one table for each level of detail)
+		void build(
+			ChunkTable *chunktables,
+			unsigned int count,
+			const glm::vec3 &camera,
+			float maxdist
+		);
+		//Rebuilds the map if the camera has moved too far since it was
+		//built or if any of the chunks changed, returns true if it was
+		//rebuilt. Call this each frame after the chunks are uploaded.
+		bool update(
+			ChunkTable *chunktables,
+			unsigned int count,
+			const glm::vec3 &position,
+			float maxdist
+		);
+		//Returns true if the box (in world space) is entirely behind terrain,
+		//nothing is occluded until the map is built
+		bool occluded(const glm::vec3 &lower, const glm::vec3 &upper) const;
+		bool isBuilt() const;
+		void clear();
+	};
+
+	//Upper bound on the size of a decoration model (in the same units as
+	//Decoration::position) from the position of the decoration
+	constexpr float DECORATION_SIZE = 20.0f;
+
 	enum DecorationType {
 		TREE,
 		PINE_TREE,
 	};
+	constexpr unsigned int DECORATION_TYPES = 2;
 
 	struct Decoration {
 		glm::vec3 position;
 		DecorationType type;
 	};
 
+	//Maximum number of decorations of a type in a single cell
+	unsigned int maxDecorations(DecorationType type);
+
 	class DecorationTable {
+		//The instance offsets of a vao are stored in slots, cell i owns the
+		//offsets starting at i * maxDecorations(type). Each frame the
+		//decorations in a cell are culled and the ones that are visible are
+		//written to the start of its slot, this only happens if they are
+		//not the same ones that were visible in the last frame. Each cell is
+		//drawn with its own indirect draw command.
+		struct InstanceBuffer {
+			DecorationType type;
+			//Number of offsets in each slot that are drawn
+			std::vector<unsigned int> counts;
+			//Version of the cell that was last written to each slot
+			std::vector<unsigned int> written;
+			//Hash of the indices of the decorations in each slot
+			std::vector<uint64_t> keys;
+			unsigned int indirectbuffer = 0;
+			unsigned int drawcount = 0;
+		};
+		//Positions of the decorations of one type in a cell in world space
+		struct CellInstances {
+			std::vector<float> xs, ys, zs;
+		};
+
 		unsigned int size;
 		int centerx = 0, centerz = 0;
 		float chunkscale;
@@ -56,88 +220,390 @@ namespace infworld {
 		//as trees (in this case we only have two types of trees)
 		std::vector<std::vector<Decoration>> decorations;
 		std::vector<ChunkPos> positions;
-		std::unordered_map<unsigned int, unsigned int> vaoCount;
+		//Incremented each time a cell is given new decorations
+		std::vector<unsigned int> versions;
+		//instances[i * DECORATION_TYPES + type] are the decorations of a
+		//type in cell i
+		std::vector<CellInstances> instances;
+		//Indexed by vao id
+		std::unordered_map<unsigned int, InstanceBuffer> instancebuffers;
+		//Bounding box of the decorations in each cell in world space
+		std::vector<glm::vec3> lowerbounds, upperbounds;
+		//Cells that are hidden behind terrain are left out of the offsets
+		std::vector<bool> hidden;
 
-		void genDecorations(
-			const worldseed &permutations,
-			DecorationType type,
-			unsigned int n,
-			int x,
-			int z,
-			unsigned int index,
-			std::minstd_rand0 &lcg
-		);	
-		void generate(const worldseed &permutations, unsigned int index);
+		//Decorations for new cells are generated in the background, a cell
+		//is empty until its decorations are integrated
+		struct PendingCell {
+			unsigned int index;
+			unsigned int generation;
+			std::vector<Decoration> decorations;
+		};
+		struct GeneratedCells {
+			std::mutex mutex;
+			std::condition_variable finished;
+			std::vector<PendingCell> cells;
+			unsigned int generating = 0;
+		};
+		//Shared with the jobs that are generating cells for this table
+		std::shared_ptr<GeneratedCells> generated;
+		//Incremented each time a cell is given a new position, cells
+		//generated for an older generation are thrown away
+		std::vector<unsigned int> generation;
+
+		void setDecorations(unsigned int index, std::vector<Decoration> &&cell);
+		void findBounds(unsigned int index);
 	public:
 		DecorationTable(unsigned int sz, float scale);
 		//Draw chunk decorations
 		void drawDecorations(const gfx::Vao &vao);
-		//Generate decorations
+		//Generate decorations for every cell, blocks until they are done
 		void genDecorations(const worldseed &permutations);
-		//Returns true if new decorations needed to be generated
+		//Starts generating the cells that come into range when the camera
+		//moves to a new cell, does not block. Returns true if the camera
+		//moved to a new cell. The permutations must outlive the jobs.
 		bool genNewDecorations(
 			float camerax,
 			float cameraz,
 			const worldseed &permutations
 		);
+		//Integrates at most `budget` cells that have finished generating,
+		//returns the number of cells integrated
+		unsigned int integrateDecorations(unsigned int budget);
+		//Blocks until all cells that are being generated are finished
+		void waitForDecorations();
+		//Marks the cells that are hidden behind terrain, returns true if
+		//that changed for any cell
+		bool updateOcclusion(const HorizonMap &horizon);
+		//Culls the decorations of a type and writes the offsets of the ones
+		//that are in the view frustum and are between minrange - 0.5 and
+		//maxrange - 0.5 cells away from the camera into the instance buffer
+		//of a vao (buffer 4). This should be called each frame.
 		void generateOffsets(
 			DecorationType type,
 			const gfx::Vao &vao,
 			unsigned int minrange,
-			unsigned int maxrange
+			unsigned int maxrange,
+			const glm::vec3 &camerapos,
+			const geo::PackedFrustum &viewfrustum
 		);
 		unsigned int count();
+		//Decorations in the cell at `index`, index must be less than count()
+		const std::vector<Decoration>& getDecorations(unsigned int index) const;
+		//Waits for the cells being generated and deletes the indirect draw
+		//buffers
+		void clearBuffers();
+	};
+
+	//Evaluates the terrain heights on the GPU and writes the chunk vertices
+	//straight into a vertex buffer with transform feedback, the results
+	//match the chunks built on the CPU to within the precision of the
+	//packed vertex format. Requires an OpenGL context.
+	class GPUChunkGenerator {
+		std::unique_ptr<ShaderProgram> shader;
+		Uniform<glm::ivec2> chunkposuniform;
+		Uniform<float> chunkscaleuniform, maxheightuniform;
+		unsigned int vao = 0;
+		unsigned int permutationbuffer = 0;
+		unsigned int permutationtexture = 0;
+		unsigned int octaves = 0;
+	public:
+		//`shaderpath` is the path of assets/shaders/terraingenvert.glsl
+		GPUChunkGenerator(
+			const worldseed &permutations,
+			const char *shaderpath = "assets/shaders/terraingenvert.glsl"
+		);
+		~GPUChunkGenerator();
+		GPUChunkGenerator(const GPUChunkGenerator &) = delete;
+		GPUChunkGenerator& operator=(const GPUChunkGenerator &) = delete;
+		//Writes the CHUNK_VERTICES vertices of the chunk at `pos` into
+		//`buffer` starting at `offset` bytes
+		void generate(
+			unsigned int buffer,
+			size_t offset,
+			ChunkPos pos,
+			float chunkscale,
+			float maxheight
+		);
+	};
+
+	//Everything a ChunkTable does with the GPU goes through a ChunkBackend,
+	//this way the chunk table can also be used without a GL context
+	class ChunkBackend {
+	public:
+		virtual ~ChunkBackend() = default;
+		//Allocates room for `count` chunks
+		virtual void init(unsigned int count) = 0;
+		virtual void destroy() = 0;
+		//Called the first time a slot is given a chunk
+		virtual void addChunk(unsigned int index, const ChunkData &chunk) = 0;
+		//Replaces the chunk in a slot
+		virtual void updateChunk(unsigned int index, const ChunkData &chunk) = 0;
+		//Generates the chunk at `pos` directly into a slot without building
+		//it on the CPU, returns false if the backend is unable to do that
+		virtual bool generateChunk(
+			unsigned int index,
+			ChunkPos pos,
+			float chunkscale,
+			float maxheight
+		) { return false; }
+		//Draws the chunks in the slots listed in `visible`
+		virtual void draw(ShaderProgram &shader, const std::vector<unsigned int> &visible) = 0;
+	};
+
+	//Every chunk in the table is stored in one vertex buffer, chunk i starts
+	//at vertex i * CHUNK_VERTICES and the vertex attributes are interleaved.
+	//All chunk tables share a single element buffer.
+	//The position of the chunk in each slot is kept in a buffer texture so
+	//that all visible chunks can be drawn with a single draw call.
+	//If a GPUChunkGenerator is provided then chunks are generated on the GPU.
+	class GLChunkBackend : public ChunkBackend {
+		unsigned int vao = 0;
+		unsigned int vertexbuffer = 0;
+		unsigned int positionbuffer = 0;
+		unsigned int positiontexture = 0;
+		//The vertex buffer as a buffer texture so that the shader can
+		//read neighbouring vertices when morphing
+		unsigned int vertextexture = 0;
+		std::shared_ptr<GPUChunkGenerator> generator;
+		//Arguments for glMultiDrawElementsBaseVertex, reused each frame
+		std::vector<int> counts;
+		std::vector<void*> offsets;
+		std::vector<int> basevertices;
+		void setPosition(unsigned int index, ChunkPos pos);
+	public:
+		GLChunkBackend(std::shared_ptr<GPUChunkGenerator> chunkgenerator = nullptr);
+		void init(unsigned int count);
+		void destroy();
+		void addChunk(unsigned int index, const ChunkData &chunk);
+		void updateChunk(unsigned int index, const ChunkData &chunk);
+		bool generateChunk(
+			unsigned int index,
+			ChunkPos pos,
+			float chunkscale,
+			float maxheight
+		);
+		void draw(ShaderProgram &shader, const std::vector<unsigned int> &visible);
 	};
 
+	//Throws away all chunks
+	class NullChunkBackend : public ChunkBackend {
+	public:
+		void init(unsigned int count);
+		void destroy();
+		void addChunk(unsigned int index, const ChunkData &chunk);
+		void updateChunk(unsigned int index, const ChunkData &chunk);
+		void draw(ShaderProgram &shader, const std::vector<unsigned int> &visible);
+	};
+
+	//Records which chunks are uploaded and drawn instead of using the GPU
+	class RecordingChunkBackend : public ChunkBackend {
+	public:
+		struct Upload {
+			unsigned int index;
+			ChunkPos position;
+			bool update;
+		};
+		std::vector<Upload> uploads;
+		//Position of the chunk that is in each slot
+		std::vector<ChunkPos> slots;
+		unsigned int drawcalls = 0;
+		size_t chunksdrawn = 0;
+
+		void init(unsigned int count);
+		void destroy();
+		void addChunk(unsigned int index, const ChunkData &chunk);
+		void updateChunk(unsigned int index, const ChunkData &chunk);
+		void draw(ShaderProgram &shader, const std::vector<unsigned int> &visible);
+	};
+
+	//Keeps track of which chunks are loaded around the camera and streams in
+	//new chunks as the camera moves, the chunk meshes are passed on to a
+	//ChunkBackend
 	class ChunkTable {
 		unsigned int chunkcount;
 		unsigned int size;
 		float chunkscale;
 		float height;
-		std::vector<unsigned int> vaoids;
-		std::vector<unsigned int> bufferids; 
+		std::shared_ptr<ChunkBackend> backend;
 		std::vector<ChunkPos> chunkpos;
 		int centerx = 0, centerz = 0;
+		//Reused each frame for the chunks that pass culling
+		std::vector<unsigned int> visible;
 
-		//For generating new chunks
-		std::vector<unsigned int> indices;
-		std::vector<ChunkPos> newChunks;
+		//Height range of the chunk in each slot (see ChunkData)
+		std::vector<float> minheights, maxheights;
+		//Quadtree over the chunks around the center, each node has the
+		//bounding box of the chunks below it so that whole regions can be
+		//rejected at once. Chunks that are not in the square around the
+		//center (they are waiting to be replaced) are tested one by one.
+		struct CullNode {
+			glm::vec3 lower, upper;
+			//-1 if there is no child
+			int children[4];
+			//Slot of the chunk if this is a leaf, otherwise -1
+			int slot;
+		};
+		std::vector<CullNode> cullnodes;
+		std::vector<unsigned int> strayslots;
+		//Lowest point of the chunk in each cell of the square around the
+		//center (in world space), -infinity if the cell has no chunk
+		std::vector<float> gridheights;
+		//Incremented each time the chunks or the center change
+		unsigned int changes = 0;
+		//Set when a chunk changes, the quadtree is rebuilt before culling
+		bool cullnodesdirty = true;
+		void chunkBounds(unsigned int index, glm::vec3 &lower, glm::vec3 &upper);
+		int buildCullNode(const std::vector<int> &grid, int x0, int z0, int x1, int z1);
+		void buildCullNodes();
+		void cullNode(
+			int node,
+			bool inside,
+			float minrange,
+			float maxrange,
+			const glm::vec2 &center,
+			const geo::PackedFrustum &frustum,
+			const HorizonMap *horizon
+		);
+
+		//For generating new chunks, chunks are built in the background and
+		//then uploaded when they are ready, until then the old chunk in the
+		//slot continues to be drawn
+		struct PendingChunk {
+			unsigned int index;
+			unsigned int generation;
+			ChunkData chunk;
+		};
+		struct BuiltChunks {
+			std::mutex mutex;
+			std::condition_variable finished;
+			std::vector<PendingChunk> chunks;
+			unsigned int building = 0;
+		};
+		//Shared with the jobs that are building chunks for this table
+		std::shared_ptr<BuiltChunks> built;
+		//Position that each slot will have once its pending chunk is uploaded
+		std::vector<ChunkPos> targetpos;
+		//Incremented each time a slot is given a new chunk to build, chunks
+		//built for an older generation are thrown away
+		std::vector<unsigned int> generation;
+		void buildInBackground(
+			unsigned int index,
+			ChunkPos pos,
+			HeightCache &heights
+		);
 	public:
-		ChunkTable(unsigned int range, float scale, float h);
+		ChunkTable(
+			unsigned int range,
+			float scale,
+			float h,
+			std::shared_ptr<ChunkBackend> chunkbackend = std::make_shared<GLChunkBackend>()
+		);
 		ChunkTable();
 		void genBuffers();
 		void clearBuffers();
-		void addChunk(
-			unsigned int index,
-			const mesh::ElementArrayBuffer<float> &chunkmesh,
-			int x,
-			int z
-		);
 		void addChunk(unsigned int index, const ChunkData &chunk);
 		void updateChunk(unsigned int index, const ChunkData &chunk);
-		void bindVao(unsigned int index);
+		//Has the backend generate the chunk at `pos` into a slot, returns
+		//false if the backend can not generate chunks
+		bool generateChunk(unsigned int index, ChunkPos pos);
 		ChunkPos getPos(unsigned int index);
 		unsigned int count() const;
 		ChunkPos getCenter();
 		void setCenter(int x, int z);
+		//Starts building the chunks that come into range when the camera
+		//moves to a new chunk, does not block
 		void generateNewChunks(
 			float camerax,
 			float cameraz,
-			const worldseed &permutations
+			HeightCache &heights
+		);
+		//Uploads at most `budget` chunks that have finished building,
+		//returns the number of chunks uploaded
+		unsigned int uploadChunks(unsigned int budget);
+		//Blocks until all chunks that are being built are finished
+		void waitForChunks();
+		//Returns the indices of the chunks that are in the view frustum and
+		//overlap the square ring around `center` (in world space) where
+		//the distance is in [minrange, maxrange), a negative maxrange has
+		//no upper limit. If a horizon map is passed then chunks that are
+		//hidden behind terrain are also skipped.
+		const std::vector<unsigned int>& cull(
+			float minrange,
+			float maxrange,
+			const glm::vec2 &center,
+			const geo::Frustum &viewfrustum,
+			const HorizonMap *horizon = nullptr
 		);
 		//returns the number of chunks drawn
 		unsigned int draw(ShaderProgram &shader, const geo::Frustum &viewfrustum);
 		unsigned int draw(
 			ShaderProgram &shader,
-			unsigned int minrange,
-			const geo::Frustum &viewfrustum
+			float minrange,
+			float maxrange,
+			const glm::vec2 &center,
+			const geo::Frustum &viewfrustum,
+			const HorizonMap *horizon = nullptr
 		);
+		//Returns the lowest point of the chunks that overlap the rectangle
+		//(x and z in world space), returns -infinity if any part of the
+		//rectangle is not covered by a chunk in the square around the center
+		float lowestHeight(const glm::vec2 &lower, const glm::vec2 &upper);
+		//Distance from the camera (along x or z) at which the next level
+		//of detail takes over, unless this is the last level of detail
+		float lodRange() const;
+		unsigned int version() const;
 		float scale() const;
 		unsigned int range() const;	
 	};
 
 	worldseed makePermutations(int seed, unsigned int count);
 	float getHeight(float x, float z, const worldseed &permutations);
+	//Batched version of getHeight, sets heights[i] to the height at
+	//(xs[i], zs[i]) for 0 <= i < count, the results are identical to
+	//calling getHeight on each point
+	void getHeights(
+		const float *xs,
+		const float *zs,
+		float *heights,
+		size_t count,
+		const worldseed &permutations
+	);
+	//Returns the height along with its partial derivatives:
+	//x = getHeight(x, z), y = d/dx, z = d/dz
+	glm::vec3 getHeightWithDerivative(float x, float z, const worldseed &permutations);
+	//Batched version of getHeightWithDerivative, heights[i] is the height
+	//and dxs[i], dzs[i] are the partial derivatives at (xs[i], zs[i])
+	void getHeightsWithDerivative(
+		const float *xs,
+		const float *zs,
+		float *heights,
+		float *dxs,
+		float *dzs,
+		size_t count,
+		const worldseed &permutations
+	);
+	//Samples the heights on a grid, heights[i * zcount + j] is set to the
+	//height at (xs[i], zs[j])
+	void getHeightGrid(
+		const float *xs,
+		size_t xcount,
+		const float *zs,
+		size_t zcount,
+		float *heights,
+		const worldseed &permutations
+	);
+	//Same as getHeightGrid but also outputs the partial derivatives
+	void getHeightGridWithDerivative(
+		const float *xs,
+		size_t xcount,
+		const float *zs,
+		size_t zcount,
+		float *heights,
+		float *dxs,
+		float *dzs,
+		const worldseed &permutations
+	);
 	float interpolate(float x, float lowerx, float upperx, float a, float b);
 	glm::vec3 getTerrainVertex(
 		float x,
@@ -145,7 +611,24 @@ namespace infworld {
 		const worldseed &permutations,
 		float maxheight
 	);
-	mesh::ElementArrayBuffer<float> createChunkElementArray(
+	//Returns the level of the height tiles that line up with chunks of the
+	//given scale, returns -1 if there is no such level
+	int tileLevel(float chunkscale);
+	//Samples the heights and slopes at the vertices of a chunk
+	void sampleChunkHeights(
+		HeightTile &tile,
+		int chunkx,
+		int chunkz,
+		float chunkscale,
+		const worldseed &permutations
+	);
+	//height is normalized to [-1, 1] and normal is a unit vector
+	ChunkVertex packChunkVertex(float height, glm::vec3 normal);
+	mesh::ElementArrayBuffer<ChunkVertex> createChunkElementArray(
+		const HeightTile &tile,
+		float maxheight
+	);
+	mesh::ElementArrayBuffer<ChunkVertex> createChunkElementArray(
 		const worldseed &permutations,
 		int chunkx,
 		int chunkz,
@@ -159,6 +642,42 @@ namespace infworld {
 		float maxheight,
 		float chunkscale
 	);
+	ChunkData buildChunk(
+		HeightCache &heights,
+		int x,
+		int z,
+		float maxheight,
+		float chunkscale
+	);
+	//Called with the level of detail, the index of the chunk in its table
+	//and the chunk that was built
+	typedef std::function<void(unsigned int, unsigned int, const ChunkData&)>
+		ChunkBuiltCallback;
+	//Builds the chunks for `lodcount` levels of detail on the job system,
+	//the chunk scale is multiplied by lodscale for each level. onbuilt is
+	//called on the calling thread as soon as each chunk is finished
+	void buildChunks(
+		unsigned int range,
+		HeightCache &heights,
+		float maxheight,
+		float chunkscale,
+		unsigned int lodcount,
+		float lodscale,
+		const ChunkBuiltCallback &onbuilt
+	);
+	//Builds all of the chunk tables for every level of detail at once,
+	//meshes are uploaded as they are finished. If a generator is passed
+	//then the chunks are generated on the GPU instead.
+	void buildWorlds(
+		ChunkTable *chunktables,
+		unsigned int lodcount,
+		float lodscale,
+		unsigned int range,
+		HeightCache &heights,
+		float maxheight,
+		float chunkscale,
+		std::shared_ptr<GPUChunkGenerator> generator = nullptr
+	);
 	ChunkTable buildWorld(
 		unsigned int range,
 		const infworld::worldseed &permutations,
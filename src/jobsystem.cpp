@@ -0,0 +1,196 @@
+#include "jobsystem.hpp"
+#include <algorithm>
+
+namespace jobs {
+	JobSystem::JobSystem(unsigned int threadcount)
+	{
+		queued = 0;
+		pending = 0;
+		nextqueue = 0;
+		start(threadcount);
+	}
+
+	JobSystem::~JobSystem()
+	{
+		wait();
+		shutdown();
+	}
+
+	JobSystem* JobSystem::get()
+	{
+		static JobSystem jobsystem(std::thread::hardware_concurrency());
+		return &jobsystem;
+	}
+
+	void JobSystem::start(unsigned int threadcount)
+	{
+		threadcount = std::max<unsigned int>(threadcount, 1);
+		stop = false;
+		for(unsigned int i = 0; i < threadcount; i++)
+			queues.push_back(std::make_unique<JobQueue>());
+		for(unsigned int i = 0; i < threadcount; i++)
+			workers.push_back(std::thread(&JobSystem::work, this, i));
+	}
+
+	void JobSystem::shutdown()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stop = true;
+		}
+		wakeup.notify_all();
+		for(auto &worker : workers)
+			worker.join();
+		workers.clear();
+		queues.clear();
+	}
+
+	void JobSystem::submit(const Job &job)
+	{
+		pending++;
+		unsigned int index = nextqueue++ % queues.size();
+		{
+			std::lock_guard<std::mutex> lock(queues.at(index)->mutex);
+			queues.at(index)->jobs.push_back(job);
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			queued++;
+		}
+		wakeup.notify_one();
+	}
+
+	bool JobSystem::takeJob(unsigned int index, Job &job)
+	{
+		//Take the most recently added job from our own queue
+		JobQueue &own = *queues.at(index);
+		{
+			std::lock_guard<std::mutex> lock(own.mutex);
+			if(!own.jobs.empty()) {
+				job = std::move(own.jobs.back());
+				own.jobs.pop_back();
+				queued--;
+				return true;
+			}
+		}
+
+		//Steal the oldest job from one of the other queues
+		for(unsigned int i = 1; i < queues.size(); i++) {
+			JobQueue &other = *queues.at((index + i) % queues.size());
+			std::lock_guard<std::mutex> lock(other.mutex);
+			if(!other.jobs.empty()) {
+				job = std::move(other.jobs.front());
+				other.jobs.pop_front();
+				queued--;
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	void JobSystem::finishJob()
+	{
+		if(--pending == 0) {
+			std::lock_guard<std::mutex> lock(mutex);
+			idle.notify_all();
+		}
+	}
+
+	void JobSystem::work(unsigned int index)
+	{
+		while(true) {
+			Job job;
+			if(takeJob(index, job)) {
+				job();
+				finishJob();
+				continue;
+			}
+
+			std::unique_lock<std::mutex> lock(mutex);
+			wakeup.wait(lock, [this]() { return stop || queued > 0; });
+			if(stop)
+				return;
+		}
+	}
+
+	bool JobSystem::runPendingJob()
+	{
+		Job job;
+		if(!takeJob(nextqueue % queues.size(), job))
+			return false;
+		job();
+		finishJob();
+		return true;
+	}
+
+	void JobSystem::wait()
+	{
+		while(runPendingJob());
+		std::unique_lock<std::mutex> lock(mutex);
+		idle.wait(lock, [this]() { return pending == 0; });
+	}
+
+	void JobSystem::parallelFor(
+		size_t count,
+		size_t grain,
+		const std::function<void(size_t, size_t)> &func
+	) {
+		grain = std::max<size_t>(grain, 1);
+		if(count <= grain) {
+			if(count > 0)
+				func(0, count);
+			return;
+		}
+
+		struct Ranges {
+			std::atomic<size_t> next;
+			std::atomic<unsigned int> running;
+			std::mutex mutex;
+			std::condition_variable finished;
+		};
+		std::shared_ptr<Ranges> ranges = std::make_shared<Ranges>();
+		ranges->next = 0;
+		ranges->running = 0;
+
+		//Helpers that start after all of the ranges have been taken return
+		//without touching func, so func only needs to live until we return
+		const std::function<void(size_t, size_t)> *f = &func;
+		auto help = [ranges, count, grain, f]() {
+			ranges->running++;
+			size_t begin;
+			while((begin = ranges->next.fetch_add(grain)) < count)
+				(*f)(begin, std::min(begin + grain, count));
+			if(--ranges->running == 0) {
+				std::lock_guard<std::mutex> lock(ranges->mutex);
+				ranges->finished.notify_all();
+			}
+		};
+
+		size_t helpers = std::min<size_t>(threadCount(), (count - 1) / grain);
+		for(size_t i = 0; i < helpers; i++)
+			submit(help);
+
+		//The calling thread works through the ranges as well so that it
+		//never has to wait for a helper that has not started yet
+		size_t begin;
+		while((begin = ranges->next.fetch_add(grain)) < count)
+			func(begin, std::min(begin + grain, count));
+
+		std::unique_lock<std::mutex> lock(ranges->mutex);
+		ranges->finished.wait(lock, [&ranges]() { return ranges->running == 0; });
+	}
+
+	unsigned int JobSystem::threadCount() const
+	{
+		return workers.size();
+	}
+
+	void JobSystem::resize(unsigned int threadcount)
+	{
+		wait();
+		shutdown();
+		start(threadcount);
+	}
+}
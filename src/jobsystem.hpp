@@ -0,0 +1,75 @@
+/*
+ * This file contains a simple job system: a pool of long lived worker
+ * threads that work can be submitted to
+ * */
+
+#pragma once
+
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <atomic>
+
+namespace jobs {
+	typedef std::function<void()> Job;
+
+	//Each worker thread has its own queue of jobs, jobs are handed out to the
+	//queues in a round robin fashion and a worker that runs out of jobs will
+	//steal jobs from the other queues
+	class JobSystem {
+		struct JobQueue {
+			std::mutex mutex;
+			std::deque<Job> jobs;
+		};
+
+		std::vector<std::thread> workers;
+		std::vector<std::unique_ptr<JobQueue>> queues;
+		std::mutex mutex;
+		std::condition_variable wakeup;
+		std::condition_variable idle;
+		//Number of jobs that are waiting in a queue
+		std::atomic<unsigned int> queued;
+		//Number of jobs that have been submitted but not finished
+		std::atomic<unsigned int> pending;
+		std::atomic<unsigned int> nextqueue;
+		bool stop = false;
+
+		void start(unsigned int threadcount);
+		void shutdown();
+		//Attempts to take a job, starting with the queue at `index`
+		bool takeJob(unsigned int index, Job &job);
+		void finishJob();
+		void work(unsigned int index);
+	public:
+		JobSystem(unsigned int threadcount);
+		~JobSystem();
+		//Returns the job system shared by the whole program, it has one
+		//worker thread for each hardware thread
+		static JobSystem* get();
+		void submit(const Job &job);
+		//Runs a single queued job on the calling thread, returns false if
+		//there were no jobs in any of the queues
+		bool runPendingJob();
+		//Blocks until every submitted job has finished, the calling thread
+		//helps with the remaining jobs while it waits
+		void wait();
+		//Calls func(begin, end) on ranges of at most `grain` indices that
+		//cover [0, count), the ranges are split between the calling thread
+		//and the worker threads. Returns once every range is finished.
+		void parallelFor(
+			size_t count,
+			size_t grain,
+			const std::function<void(size_t, size_t)> &func
+		);
+		unsigned int threadCount() const;
+		//Waits for all jobs to finish and then restarts the job system
+		//with a different number of worker threads
+		void resize(unsigned int threadcount);
+	};
+}
+
+#define JOBS jobs::JobSystem::get()
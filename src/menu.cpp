@@ -21,6 +21,7 @@ namespace game {
 		
 		float dt = 0.0f;
 		float totalTime = 0.0f;
+		gfx::RenderQueue renderqueue;
 		while(!glfwWindowShouldClose(state->getWindow())) {
 			float start = glfwGetTime();
 
@@ -28,12 +29,14 @@ namespace game {
 
 			//Update perspective matrix
 			state->updatePerspectiveMat(FOVY, ZNEAR, ZFAR);
+			gfx::updateFrameData();
 
 			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-			gfx::displayPlayerPlane(totalTime, player.transform);
+			gfx::displayPlayerPlane(renderqueue, totalTime, player.transform);
 			//Display skybox
-			gfx::displaySkybox();
+			gfx::displaySkybox(renderqueue);
+			renderqueue.execute();
 
 			game::GameMode selected = gui::displayMainMenu();
 			if(showCredits) {
@@ -83,16 +86,19 @@ namespace game {
 		state->getCamera().position = glm::vec3(0.0f);
 
 		bool quit = false;
+		gfx::RenderQueue renderqueue;
 		while(!glfwWindowShouldClose(state->getWindow()) && !quit) {
 			nk_glfw3_new_frame(state->getNkGlfw());
 
 			//Update perspective matrix
 			state->updatePerspectiveMat(FOVY, ZNEAR, ZFAR);
+			gfx::updateFrameData();
 
 			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
 			//Display skybox
-			gfx::displaySkybox();
+			gfx::displaySkybox(renderqueue);
+			renderqueue.execute();
 			//GUI
 			quit = gui::displayHighScores(highscores);
 
@@ -120,16 +126,19 @@ namespace game {
 		state->getCamera().position = glm::vec3(0.0f);
 
 		bool quit = false;
+		gfx::RenderQueue renderqueue;
 		while(!glfwWindowShouldClose(state->getWindow()) && !quit) {
 			nk_glfw3_new_frame(state->getNkGlfw());
 
 			//Update perspective matrix
 			state->updatePerspectiveMat(FOVY, ZNEAR, ZFAR);
+			gfx::updateFrameData();
 
 			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
 			//Display skybox
-			gfx::displaySkybox();
+			gfx::displaySkybox(renderqueue);
+			renderqueue.execute();
 			//Display settings
 			action = gui::displaySettingsMenu(values);
 
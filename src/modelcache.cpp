@@ -0,0 +1,304 @@
+#include "gfx.hpp"
+#include <stdio.h>
+#include <string.h>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+//The vertex data is copied straight into the vectors of the model
+static_assert(sizeof(glm::vec3) == 3 * sizeof(float), "glm::vec3 must be packed");
+static_assert(sizeof(glm::vec2) == 2 * sizeof(float), "glm::vec2 must be packed");
+
+namespace {
+	const char MAGIC[4] = { 'F', 'F', 'M', 'C' };
+
+	//The file starts with this header followed by an entry for each model,
+	//the entries point to the data of the model which is stored as the
+	//vertices, normals, texture coordinates, and then the indices
+	struct Header {
+		char magic[4];
+		uint32_t version;
+		uint32_t count;
+		uint32_t padding;
+	};
+
+	size_t modelSize(uint32_t vertexcount, uint32_t indexcount)
+	{
+		return
+			size_t(vertexcount) * (3 + 3 + 2) * sizeof(float) +
+			size_t(indexcount) * sizeof(uint32_t);
+	}
+
+	template<typename T>
+	void readArray(std::vector<T> &v, const unsigned char *&ptr, size_t count)
+	{
+		v.resize(count);
+		if(count > 0)
+			memcpy(v.data(), ptr, count * sizeof(T));
+		ptr += count * sizeof(T);
+	}
+
+	template<typename T>
+	void writeArray(std::vector<unsigned char> &out, const std::vector<T> &v)
+	{
+		const unsigned char *bytes = reinterpret_cast<const unsigned char*>(v.data());
+		out.insert(out.end(), bytes, bytes + v.size() * sizeof(T));
+	}
+
+	unsigned long processId()
+	{
+#ifdef _WIN32
+		return GetCurrentProcessId();
+#else
+		return getpid();
+#endif
+	}
+
+	//Moves `from` over `to`, replacing it if it already exists
+	bool replaceFile(const std::string &from, const std::string &to)
+	{
+#ifdef _WIN32
+		return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+		return rename(from.c_str(), to.c_str()) == 0;
+#endif
+	}
+}
+
+namespace mesh {
+	uint64_t hashModelKey(const void *bytes, size_t size, uint64_t hash)
+	{
+		const unsigned char *ptr = static_cast<const unsigned char*>(bytes);
+		for(size_t i = 0; i < size; i++) {
+			hash ^= ptr[i];
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+
+	ModelCache::ModelCache(const char *cachepath)
+	{
+		path = cachepath;
+		map();
+	}
+
+	ModelCache::~ModelCache()
+	{
+		unmap();
+	}
+
+	void ModelCache::map()
+	{
+#ifdef _WIN32
+		HANDLE f = CreateFileA(
+			path.c_str(),
+			GENERIC_READ,
+			FILE_SHARE_READ,
+			nullptr,
+			OPEN_EXISTING,
+			FILE_ATTRIBUTE_NORMAL,
+			nullptr
+		);
+		if(f == INVALID_HANDLE_VALUE)
+			return;
+		file = f;
+		LARGE_INTEGER size;
+		if(!GetFileSizeEx(f, &size) || size.QuadPart < LONGLONG(sizeof(Header))) {
+			unmap();
+			return;
+		}
+		mapping = CreateFileMappingA(f, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if(!mapping) {
+			unmap();
+			return;
+		}
+		data = static_cast<const unsigned char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+		datasize = size_t(size.QuadPart);
+#else
+		int fd = open(path.c_str(), O_RDONLY);
+		if(fd < 0)
+			return;
+		struct stat info;
+		if(fstat(fd, &info) == 0 && size_t(info.st_size) >= sizeof(Header)) {
+			void *mapped = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if(mapped != MAP_FAILED) {
+				data = static_cast<const unsigned char*>(mapped);
+				datasize = info.st_size;
+			}
+		}
+		//The mapping stays valid after the file is closed
+		close(fd);
+#endif
+		if(!data) {
+			unmap();
+			return;
+		}
+
+		//Check that the file is a cache that we can read, if it is not then
+		//we just ignore it and it gets replaced the next time we save
+		Header header;
+		memcpy(&header, data, sizeof(Header));
+		size_t entriessize = size_t(header.count) * sizeof(Entry);
+		if(
+			memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 ||
+			header.version != MODEL_CACHE_VERSION ||
+			entriessize > datasize - sizeof(Header)
+		) {
+			fprintf(stderr, "Ignoring invalid model cache: %s\n", path.c_str());
+			unmap();
+			return;
+		}
+		entries.resize(header.count);
+		if(header.count > 0)
+			memcpy(entries.data(), data + sizeof(Header), entriessize);
+		for(const auto &entry : entries) {
+			size_t size = modelSize(entry.vertexcount, entry.indexcount);
+			if(entry.offset > datasize || size > datasize - entry.offset) {
+				fprintf(stderr, "Ignoring invalid model cache: %s\n", path.c_str());
+				unmap();
+				return;
+			}
+		}
+	}
+
+	void ModelCache::unmap()
+	{
+#ifdef _WIN32
+		if(data)
+			UnmapViewOfFile(data);
+		if(mapping)
+			CloseHandle(mapping);
+		if(file)
+			CloseHandle(file);
+		mapping = nullptr;
+		file = nullptr;
+#else
+		if(data)
+			munmap(const_cast<unsigned char*>(data), datasize);
+#endif
+		data = nullptr;
+		datasize = 0;
+		entries.clear();
+	}
+
+	const ModelCache::Entry* ModelCache::find(uint64_t key) const
+	{
+		for(const auto &entry : entries)
+			if(entry.key == key)
+				return &entry;
+		return nullptr;
+	}
+
+	bool ModelCache::get(uint64_t key, Model &model) const
+	{
+		for(const auto &m : added) {
+			if(m.first == key) {
+				model = m.second;
+				return true;
+			}
+		}
+
+		const Entry* entry = find(key);
+		if(!entry)
+			return false;
+		const unsigned char *ptr = data + entry->offset;
+		readArray(model.vertices, ptr, entry->vertexcount);
+		readArray(model.normals, ptr, entry->vertexcount);
+		readArray(model.texturecoords, ptr, entry->vertexcount);
+		readArray(model.indices, ptr, entry->indexcount);
+		return true;
+	}
+
+	void ModelCache::add(uint64_t key, const Model &model)
+	{
+		//Every vertex needs a normal and texture coordinate
+		if(
+			model.normals.size() != model.vertices.size() ||
+			model.texturecoords.size() != model.vertices.size()
+		)
+			return;
+		for(auto &m : added) {
+			if(m.first == key) {
+				m.second = model;
+				return;
+			}
+		}
+		added.push_back({ key, model });
+	}
+
+	bool ModelCache::save()
+	{
+		if(added.empty())
+			return true;
+
+		//Keep the models that are already in the file unless they were
+		//replaced by a new model with the same key
+		std::vector<Entry> newentries;
+		for(const auto &entry : entries) {
+			bool replaced = false;
+			for(const auto &m : added)
+				replaced = replaced || m.first == entry.key;
+			if(!replaced)
+				newentries.push_back(entry);
+		}
+		for(const auto &m : added) {
+			Entry entry;
+			entry.key = m.first;
+			entry.vertexcount = m.second.vertices.size();
+			entry.indexcount = m.second.indices.size();
+			newentries.push_back(entry);
+		}
+
+		Header header;
+		memcpy(header.magic, MAGIC, sizeof(MAGIC));
+		header.version = MODEL_CACHE_VERSION;
+		header.count = newentries.size();
+		header.padding = 0;
+		size_t offset = sizeof(Header) + newentries.size() * sizeof(Entry);
+		for(auto &entry : newentries) {
+			entry.offset = offset;
+			offset += modelSize(entry.vertexcount, entry.indexcount);
+		}
+
+		std::vector<unsigned char> out;
+		out.reserve(offset);
+		const unsigned char *headerbytes = reinterpret_cast<const unsigned char*>(&header);
+		out.insert(out.end(), headerbytes, headerbytes + sizeof(Header));
+		writeArray(out, newentries);
+		for(const auto &entry : newentries) {
+			Model model;
+			get(entry.key, model);
+			writeArray(out, model.vertices);
+			writeArray(out, model.normals);
+			writeArray(out, model.texturecoords);
+			writeArray(out, model.indices);
+		}
+
+		//Write to a temporary file first and then move it over the cache so
+		//that a crash or another instance of the game saving at the same
+		//time never leaves a partially written cache behind
+		std::string tmppath = path + "." + std::to_string(processId()) + ".tmp";
+		FILE *f = fopen(tmppath.c_str(), "wb");
+		bool success = f && fwrite(out.data(), 1, out.size(), f) == out.size();
+		if(f)
+			success = fclose(f) == 0 && success;
+		//The file can not be replaced while it is still mapped on Windows
+		unmap();
+		if(success)
+			success = replaceFile(tmppath, path);
+		if(!success) {
+			fprintf(stderr, "Failed to write model cache: %s\n", path.c_str());
+			remove(tmppath.c_str());
+		}
+		added.clear();
+		map();
+		return success;
+	}
+}
@@ -2,6 +2,12 @@
 #include <glm/glm.hpp>
 #include <math.h>
 #include <random>
+#include <algorithm>
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 constexpr glm::vec2 gradients[4] = {
 	glm::vec2(1.0f, 0.0f),
@@ -83,6 +89,54 @@ namespace perlin {
 		return interpolate(lerpedlower, lerpedupper, y - lowery);
 	}
 
+	//Derivative of the smoothing curve used by interpolate()
+	float interpolateSlope(float x)
+	{
+		return 6.0f * x * (1.0f - x);
+	}
+
+	//Smoothing curve used by interpolate()
+	float smoothstep(float x)
+	{
+		return (3.0f - x * 2.0f) * x * x;
+	}
+
+	glm::vec3 noiseWithDerivative(float x, float y, const rng::permutation256 &p)
+	{
+		int
+			leftx = int(floorf(x)),
+			lowery = int(floorf(y)),
+			rightx = leftx + 1,
+			uppery = lowery + 1;
+		glm::vec2
+			lowerleftgrad = gradient(leftx, lowery, p),
+			lowerrightgrad = gradient(rightx, lowery, p),
+			upperleftgrad = gradient(leftx, uppery, p),
+			upperrightgrad = gradient(rightx, uppery, p);
+		float
+			lowerleft = glm::dot(lowerleftgrad, glm::vec2(x - float(leftx), y - float(lowery))),
+			lowerright = glm::dot(lowerrightgrad, glm::vec2(x - float(rightx), y - float(lowery))),
+			upperleft = glm::dot(upperleftgrad, glm::vec2(x - float(leftx), y - float(uppery))),
+			upperright = glm::dot(upperrightgrad, glm::vec2(x - float(rightx), y - float(uppery)));
+		float u = x - leftx, v = y - lowery;
+		float 
+			lerpedlower = interpolate(lowerleft, lowerright, u),
+			lerpedupper = interpolate(upperleft, upperright, u);
+		float value = interpolate(lerpedlower, lerpedupper, v);
+
+		//Differentiate the interpolation with respect to x and y
+		float su = smoothstep(u), sv = smoothstep(v);
+		glm::vec2
+			lowergrad = lowerleftgrad + (lowerrightgrad - lowerleftgrad) * su,
+			uppergrad = upperleftgrad + (upperrightgrad - upperleftgrad) * su;
+		lowergrad.x += (lowerright - lowerleft) * interpolateSlope(u);
+		uppergrad.x += (upperright - upperleft) * interpolateSlope(u);
+		glm::vec2 grad = lowergrad + (uppergrad - lowergrad) * sv;
+		grad.y += (lerpedupper - lerpedlower) * interpolateSlope(v);
+
+		return glm::vec3(value, grad.x, grad.y);
+	}
+
 	float noise(float x, float y, int repeat, const rng::permutation256 &p)
 	{
 		int
@@ -100,4 +154,277 @@ namespace perlin {
 			lerpedupper = interpolate(upperleft, upperright, x - leftx);
 		return interpolate(lerpedlower, lerpedupper, y - lowery);
 	}
+
+	//Number of samples processed at a time by the batched noise function
+	constexpr size_t NOISE_BATCH = 64;
+
+	//Lattice data for a block of samples, stored as arrays so that the
+	//interpolation step can operate on several samples at once
+	struct NoiseBlock {
+		//Gradients at the corners of each sample's cell
+		//0 = lower left, 1 = lower right, 2 = upper left, 3 = upper right
+		float gradx[4][NOISE_BATCH];
+		float grady[4][NOISE_BATCH];
+		//Offsets of the sample from the left/right and lower/upper edges
+		float leftdx[NOISE_BATCH], rightdx[NOISE_BATCH];
+		float lowerdy[NOISE_BATCH], upperdy[NOISE_BATCH];
+	};
+
+	void fillNoiseBlock(
+		NoiseBlock &block,
+		const float *x,
+		const float *y,
+		size_t count,
+		const rng::permutation256 &p
+	) {
+		int cachedx = 0, cachedy = 0;
+		glm::vec2 corners[4];
+		for(size_t i = 0; i < count; i++) {
+			int
+				leftx = int(floorf(x[i])),
+				lowery = int(floorf(y[i])),
+				rightx = leftx + 1,
+				uppery = lowery + 1;
+
+			//Only look up the gradients if we moved into a different cell
+			if(i == 0 || leftx != cachedx || lowery != cachedy) {
+				corners[0] = gradient(leftx, lowery, p);
+				corners[1] = gradient(rightx, lowery, p);
+				corners[2] = gradient(leftx, uppery, p);
+				corners[3] = gradient(rightx, uppery, p);
+				cachedx = leftx;
+				cachedy = lowery;
+			}
+
+			for(int j = 0; j < 4; j++) {
+				block.gradx[j][i] = corners[j].x;
+				block.grady[j][i] = corners[j].y;
+			}
+			block.leftdx[i] = x[i] - float(leftx);
+			block.rightdx[i] = x[i] - float(rightx);
+			block.lowerdy[i] = y[i] - float(lowery);
+			block.upperdy[i] = y[i] - float(uppery);
+		}
+	}
+
+	//Computes the noise value for sample i of a block, this matches the
+	//scalar noise function operation for operation
+	inline float blockNoise(const NoiseBlock &block, size_t i)
+	{
+		float
+			lowerleft = 
+				block.gradx[0][i] * block.leftdx[i] + block.grady[0][i] * block.lowerdy[i],
+			lowerright = 
+				block.gradx[1][i] * block.rightdx[i] + block.grady[1][i] * block.lowerdy[i],
+			upperleft =
+				block.gradx[2][i] * block.leftdx[i] + block.grady[2][i] * block.upperdy[i],
+			upperright = 
+				block.gradx[3][i] * block.rightdx[i] + block.grady[3][i] * block.upperdy[i];
+		float
+			lerpedlower = interpolate(lowerleft, lowerright, block.leftdx[i]),
+			lerpedupper = interpolate(upperleft, upperright, block.leftdx[i]);
+		return interpolate(lerpedlower, lerpedupper, block.lowerdy[i]);
+	}
+
+#if defined(__AVX__)
+	constexpr size_t NOISE_LANES = 8;
+
+	//interpolate() is evaluated in double precision so we have to do the
+	//same here to get identical results
+	inline __m256d interpolatePd(__m256d a, __m256d diff, __m256d x)
+	{
+		__m256d s = _mm256_sub_pd(_mm256_set1_pd(3.0), _mm256_mul_pd(x, _mm256_set1_pd(2.0)));
+		__m256d r = _mm256_mul_pd(_mm256_mul_pd(_mm256_mul_pd(diff, s), x), x);
+		return _mm256_add_pd(r, a);
+	}
+
+	inline __m256 interpolatePs(__m256 a, __m256 b, __m256 x)
+	{
+		__m256 diff = _mm256_sub_ps(b, a);
+		__m256d 
+			lower = interpolatePd(
+				_mm256_cvtps_pd(_mm256_castps256_ps128(a)),
+				_mm256_cvtps_pd(_mm256_castps256_ps128(diff)),
+				_mm256_cvtps_pd(_mm256_castps256_ps128(x))
+			),
+			upper = interpolatePd(
+				_mm256_cvtps_pd(_mm256_extractf128_ps(a, 1)),
+				_mm256_cvtps_pd(_mm256_extractf128_ps(diff, 1)),
+				_mm256_cvtps_pd(_mm256_extractf128_ps(x, 1))
+			);
+		return _mm256_insertf128_ps(
+			_mm256_castps128_ps256(_mm256_cvtpd_ps(lower)),
+			_mm256_cvtpd_ps(upper),
+			1
+		);
+	}
+
+	inline __m256 dotPs(const float *gx, const float *gy, const float *dx, const float *dy)
+	{
+		return _mm256_add_ps(
+			_mm256_mul_ps(_mm256_loadu_ps(gx), _mm256_loadu_ps(dx)),
+			_mm256_mul_ps(_mm256_loadu_ps(gy), _mm256_loadu_ps(dy))
+		);
+	}
+
+	inline void blockNoiseLanes(const NoiseBlock &block, size_t i, float *out)
+	{
+		__m256
+			lowerleft = dotPs(
+				&block.gradx[0][i], &block.grady[0][i], &block.leftdx[i], &block.lowerdy[i]
+			),
+			lowerright = dotPs(
+				&block.gradx[1][i], &block.grady[1][i], &block.rightdx[i], &block.lowerdy[i]
+			),
+			upperleft = dotPs(
+				&block.gradx[2][i], &block.grady[2][i], &block.leftdx[i], &block.upperdy[i]
+			),
+			upperright = dotPs(
+				&block.gradx[3][i], &block.grady[3][i], &block.rightdx[i], &block.upperdy[i]
+			);
+		__m256 dx = _mm256_loadu_ps(&block.leftdx[i]);
+		__m256
+			lerpedlower = interpolatePs(lowerleft, lowerright, dx),
+			lerpedupper = interpolatePs(upperleft, upperright, dx);
+		__m256 res = interpolatePs(lerpedlower, lerpedupper, _mm256_loadu_ps(&block.lowerdy[i]));
+		_mm256_storeu_ps(out, res);
+	}
+#elif defined(__SSE2__)
+	constexpr size_t NOISE_LANES = 4;
+
+	//interpolate() is evaluated in double precision so we have to do the
+	//same here to get identical results
+	inline __m128d interpolatePd(__m128d a, __m128d diff, __m128d x)
+	{
+		__m128d s = _mm_sub_pd(_mm_set1_pd(3.0), _mm_mul_pd(x, _mm_set1_pd(2.0)));
+		__m128d r = _mm_mul_pd(_mm_mul_pd(_mm_mul_pd(diff, s), x), x);
+		return _mm_add_pd(r, a);
+	}
+
+	inline __m128 interpolatePs(__m128 a, __m128 b, __m128 x)
+	{
+		__m128 diff = _mm_sub_ps(b, a);
+		__m128d 
+			lower = interpolatePd(_mm_cvtps_pd(a), _mm_cvtps_pd(diff), _mm_cvtps_pd(x)),
+			upper = interpolatePd(
+				_mm_cvtps_pd(_mm_movehl_ps(a, a)),
+				_mm_cvtps_pd(_mm_movehl_ps(diff, diff)),
+				_mm_cvtps_pd(_mm_movehl_ps(x, x))
+			);
+		return _mm_movelh_ps(_mm_cvtpd_ps(lower), _mm_cvtpd_ps(upper));
+	}
+
+	inline __m128 dotPs(const float *gx, const float *gy, const float *dx, const float *dy)
+	{
+		return _mm_add_ps(
+			_mm_mul_ps(_mm_loadu_ps(gx), _mm_loadu_ps(dx)),
+			_mm_mul_ps(_mm_loadu_ps(gy), _mm_loadu_ps(dy))
+		);
+	}
+
+	inline void blockNoiseLanes(const NoiseBlock &block, size_t i, float *out)
+	{
+		__m128
+			lowerleft = dotPs(
+				&block.gradx[0][i], &block.grady[0][i], &block.leftdx[i], &block.lowerdy[i]
+			),
+			lowerright = dotPs(
+				&block.gradx[1][i], &block.grady[1][i], &block.rightdx[i], &block.lowerdy[i]
+			),
+			upperleft = dotPs(
+				&block.gradx[2][i], &block.grady[2][i], &block.leftdx[i], &block.upperdy[i]
+			),
+			upperright = dotPs(
+				&block.gradx[3][i], &block.grady[3][i], &block.rightdx[i], &block.upperdy[i]
+			);
+		__m128 dx = _mm_loadu_ps(&block.leftdx[i]);
+		__m128
+			lerpedlower = interpolatePs(lowerleft, lowerright, dx),
+			lerpedupper = interpolatePs(upperleft, upperright, dx);
+		__m128 res = interpolatePs(lerpedlower, lerpedupper, _mm_loadu_ps(&block.lowerdy[i]));
+		_mm_storeu_ps(out, res);
+	}
+#else
+	//No SIMD available, fall back to computing one sample at a time
+	constexpr size_t NOISE_LANES = 1;
+
+	inline void blockNoiseLanes(const NoiseBlock &block, size_t i, float *out)
+	{
+		*out = blockNoise(block, i);
+	}
+#endif
+
+	void noise(
+		const float *x,
+		const float *y,
+		float *out,
+		size_t count,
+		const rng::permutation256 &p
+	) {
+		NoiseBlock block;
+		for(size_t start = 0; start < count; start += NOISE_BATCH) {
+			size_t n = std::min(NOISE_BATCH, count - start);
+			fillNoiseBlock(block, x + start, y + start, n, p);
+
+			size_t i = 0;
+			for(; i + NOISE_LANES <= n; i += NOISE_LANES)
+				blockNoiseLanes(block, i, out + start + i);
+			//Remaining samples that do not fill up a whole register
+			for(; i < n; i++)
+				out[start + i] = blockNoise(block, i);
+		}
+	}
+
+	void noiseWithDerivative(
+		const float *x,
+		const float *y,
+		float *out,
+		float *outdx,
+		float *outdy,
+		size_t count,
+		const rng::permutation256 &p
+	) {
+		NoiseBlock block;
+		for(size_t start = 0; start < count; start += NOISE_BATCH) {
+			size_t n = std::min(NOISE_BATCH, count - start);
+			fillNoiseBlock(block, x + start, y + start, n, p);
+
+			size_t i = 0;
+			for(; i + NOISE_LANES <= n; i += NOISE_LANES)
+				blockNoiseLanes(block, i, out + start + i);
+			for(; i < n; i++)
+				out[start + i] = blockNoise(block, i);
+
+			//Derivatives, same steps as in the scalar noiseWithDerivative
+			for(i = 0; i < n; i++) {
+				float u = block.leftdx[i], v = block.lowerdy[i];
+				float
+					lowerleft = 
+						block.gradx[0][i] * block.leftdx[i] + block.grady[0][i] * block.lowerdy[i],
+					lowerright = 
+						block.gradx[1][i] * block.rightdx[i] + block.grady[1][i] * block.lowerdy[i],
+					upperleft =
+						block.gradx[2][i] * block.leftdx[i] + block.grady[2][i] * block.upperdy[i],
+					upperright = 
+						block.gradx[3][i] * block.rightdx[i] + block.grady[3][i] * block.upperdy[i];
+				float su = smoothstep(u), sv = smoothstep(v);
+				float 
+					lowerdx = 
+						block.gradx[0][i] + (block.gradx[1][i] - block.gradx[0][i]) * su +
+						(lowerright - lowerleft) * interpolateSlope(u),
+					lowerdy = block.grady[0][i] + (block.grady[1][i] - block.grady[0][i]) * su,
+					upperdx = 
+						block.gradx[2][i] + (block.gradx[3][i] - block.gradx[2][i]) * su +
+						(upperright - upperleft) * interpolateSlope(u),
+					upperdy = block.grady[2][i] + (block.grady[3][i] - block.grady[2][i]) * su;
+				float
+					lerpedlower = interpolate(lowerleft, lowerright, u),
+					lerpedupper = interpolate(upperleft, upperright, u);
+				outdx[start + i] = lowerdx + (upperdx - lowerdx) * sv;
+				outdy[start + i] = 
+					lowerdy + (upperdy - lowerdy) * sv + 
+					(lerpedupper - lerpedlower) * interpolateSlope(v);
+			}
+		}
+	}
 }
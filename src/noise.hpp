@@ -1,4 +1,6 @@
 #pragma once
+#include <stddef.h>
+#include <glm/glm.hpp>
 
 namespace rng {	
 	//Array that represents a random permutation of 0 -> 255
@@ -11,4 +13,31 @@ namespace perlin {
 	float interpolate(float a, float b, float x);
 	float noise(float x, float y, const rng::permutation256 &p);
 	float noise(float x, float y, int repeat, const rng::permutation256 &p);	
+	//Returns the noise value along with its partial derivatives,
+	//x = noise(x, y, p), y = d/dx, z = d/dy
+	//The value is identical to the one returned by noise(x, y, p)
+	glm::vec3 noiseWithDerivative(float x, float y, const rng::permutation256 &p);
+	//Batched version of noise(x, y, p), sets out[i] = noise(x[i], y[i], p)
+	//for 0 <= i < count. Uses SSE2/AVX when available and gives results that
+	//are bit-identical to the scalar version. Neighbouring samples that share
+	//a lattice cell share their gradient lookups, so it is fastest when
+	//consecutive samples are close together (such as a row of a chunk)
+	void noise(
+		const float *x,
+		const float *y,
+		float *out,
+		size_t count,
+		const rng::permutation256 &p
+	);
+	//Batched version of noiseWithDerivative, out[i] is the noise value and
+	//outdx[i], outdy[i] are the partial derivatives at (x[i], y[i])
+	void noiseWithDerivative(
+		const float *x,
+		const float *y,
+		float *out,
+		float *outdx,
+		float *outdy,
+		size_t count,
+		const rng::permutation256 &p
+	);
 }
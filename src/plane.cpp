@@ -9,28 +9,26 @@ constexpr float ROTATION_Y = 0.8f;
 constexpr float ROTATION_Z = 0.5f;
 constexpr float MAX_ROTATION_Z = glm::radians(15.0f);
 constexpr float SHOOT_COOLDOWN = 0.5f;
+//Points on the plane that are checked against the terrain
+constexpr int PLANE_CRASH_POINTS = 5;
 
-namespace gameobjects {
-	void Enemy::updatePlane(
+namespace {
+	//Moves a single plane, `y` is the height of the ground below it
+	void updatePlane(
+		game::Transform &transform,
+		gobjs::PlaneState &plane,
+		float y,
 		float dt,
-		const Player &player,
-		std::vector<Bullet> &bullets,
-		const infworld::worldseed &permutations
+		const gobjs::Player &player,
+		std::vector<gobjs::Bullet> &bullets
 	) {
-		float h = infworld::getHeight(
-			transform.position.z / SCALE * float(PREC + 1) / float(PREC),
-			transform.position.x / SCALE * float(PREC + 1) / float(PREC),
-			permutations
-		) * HEIGHT * SCALE;
-		float y = std::max(h, 0.0f);
-
 		float speed = std::min(player.speed + 16.0f, 100.0f);
 		glm::vec3 velocity = transform.direction() * speed;
-		if(values.at("rotationdirection") < 0.0f)
+		if(plane.rotationdirection < 0.0f)
 			velocity *= 1.5f;
 		transform.position += velocity * dt;
-		values.at("rotationtimer") -= dt;
-		values.at("shoottimer") -= dt;
+		plane.rotationtimer -= dt;
+		plane.shoottimer -= dt;
 		//Difference between player position and object position 
 		glm::vec3 diff = player.transform.position - transform.position;
 		float dist = glm::length(diff);
@@ -41,31 +39,31 @@ namespace gameobjects {
 		float dotprod = glm::dot(glm::normalize(diff), dir);
 
 		//Shoot
-		if(values.at("shoottimer") < 0.0f && 
+		if(plane.shoottimer < 0.0f && 
 			dotprod > 0.8f && 
-			values.at("rotationdirection") > 0.0f &&
+			plane.rotationdirection > 0.0f &&
 			dist < CHUNK_SZ * 12.0f &&
 			!player.crashed) {
 			SNDSRC->playid("shoot", transform.position, 2.0f);
-			values.at("shoottimer") = SHOOT_COOLDOWN;
+			plane.shoottimer = SHOOT_COOLDOWN;
 			bullets.push_back(gobjs::Bullet(transform, speed, glm::vec3(-8.5f, -0.75f, 8.5f)));
 			bullets.push_back(gobjs::Bullet(transform, speed, glm::vec3(8.5f, -0.75f, 8.5f)));
 		}
 
-		if(dist < CHUNK_SZ * 2.0f && dotprod > 0.98f && values.at("rotationtimer") < 0.0f
+		if(dist < CHUNK_SZ * 2.0f && dotprod > 0.98f && plane.rotationtimer < 0.0f
 			|| dist < CHUNK_SZ / 2.0f) {
-			values.at("rotationdirection") = -3.0f;
-			values.at("rotationtimer") = 6.0f;
+			plane.rotationdirection = -3.0f;
+			plane.rotationtimer = 6.0f;
 		}
-		else if(values.at("rotationtimer") < -30.0f && dist < CHUNK_SZ * 2.0f) {
-			values.at("rotationdirection") = -3.0f;
-			values.at("rotationtimer") = 6.0f;
+		else if(plane.rotationtimer < -30.0f && dist < CHUNK_SZ * 2.0f) {
+			plane.rotationdirection = -3.0f;
+			plane.rotationtimer = 6.0f;
 		}
-		else if(dotprod < -0.98f && values.at("rotationtimer") < 0.0f)
-			values.at("rotationdirection") = 1.0f;
-		else if(dist > CHUNK_SZ * 12.0f && values.at("rotationtimer") < 0.0f)
-			values.at("rotationdirection") = 1.0f;
-		float rotationdirection = values.at("rotationdirection");
+		else if(dotprod < -0.98f && plane.rotationtimer < 0.0f)
+			plane.rotationdirection = 1.0f;
+		else if(dist > CHUNK_SZ * 12.0f && plane.rotationtimer < 0.0f)
+			plane.rotationdirection = 1.0f;
+		float rotationdirection = plane.rotationdirection;
 
 		float rotationx = transform.rotation.x, rotationy = transform.rotation.y;
 		float dotprod1, dotprod2;	
@@ -112,7 +110,7 @@ namespace gameobjects {
 		
 		if(transform.position.y - y <= 80.0f)
 			transform.rotation.x -= ROTATION_X * 4.0f * dt;
-		else if(values.at("rotationdirection") < 0.0f && dist > CHUNK_SZ) {
+		else if(plane.rotationdirection < 0.0f && dist > CHUNK_SZ) {
 			transform.rotation.x -= transform.rotation.x * dt;
 			if(std::abs(transform.rotation.x) < 0.02f)
 				transform.rotation.x = 0.0f;
@@ -123,84 +121,111 @@ namespace gameobjects {
 			else if(dotprod1 > dotprod2)
 				transform.rotation.x -= ROTATION_X * dt * 2.0f;
 		}
-		else if(dotprod1 <= dotprod2 && values.at("rotationdirection") > 0.0f && dotprod < 0.995f)
+		else if(dotprod1 <= dotprod2 && plane.rotationdirection > 0.0f && dotprod < 0.995f)
 			transform.rotation.x -= ROTATION_X * dt;
-		else if(dotprod1 > dotprod2 && values.at("rotationdirection") > 0.0f && dotprod < 0.995f)
+		else if(dotprod1 > dotprod2 && plane.rotationdirection > 0.0f && dotprod < 0.995f)
 			transform.rotation.x += ROTATION_X * dt;
 
 		transform.rotation.x = std::max(transform.rotation.x, -glm::radians(70.0f));
 		transform.rotation.x = std::min(transform.rotation.x, glm::radians(70.0f));
-
-		checkIfPlaneCrashed(permutations);
 	}
 
-	void Enemy::checkIfPlaneCrashed(const infworld::worldseed &permutations)
+	//Returns true if any part of the plane is too close to the ground
+	bool planeCrashed(const glm::vec3 *positions, const float *groundheights)
 	{
-		glm::vec3 pos = transform.position;
-		float h = infworld::getHeight(
-			pos.z / SCALE * float(PREC + 1) / float(PREC),
-			pos.x / SCALE * float(PREC + 1) / float(PREC),
-			permutations
-		) * HEIGHT * SCALE;
 		//Maximum height difference between
 		const float MAX_HEIGHT_DIFF = 8.0f;
-		if(pos.y - h < MAX_HEIGHT_DIFF || pos.y < MAX_HEIGHT_DIFF / 2.0f) {
-			//Do not give any score if the plane crashes into the terrain
-			scorevalue = 0;
-			hitpoints = 0;
-			return;
+		for(int i = 0; i < PLANE_CRASH_POINTS; i++) {
+			glm::vec3 pos = positions[i];
+			float h = groundheights[i];
+			if(pos.y - h < MAX_HEIGHT_DIFF || pos.y < MAX_HEIGHT_DIFF / 2.0f)
+				return true;
 		}
+		return false;
+	}
+}
+
+namespace gameobjects {
+	void updatePlanes(
+		Planes &planes,
+		float dt,
+		const Player &player,
+		std::vector<Bullet> &bullets,
+		infworld::HeightCache &heights
+	) {
+		if(planes.empty())
+			return;
 
-		glm::vec3 positions[] = {
-			transform.position + transform.rotate(glm::vec3(-9.0f, 0.0f, 0.0f)),
-			transform.position + transform.rotate(glm::vec3(10.0f, 0.0f, 0.0f)),
-			transform.position + transform.rotate(glm::vec3(-13.0f, -5.0f, 0.0f)),
-			transform.position + transform.rotate(glm::vec3(13.0f, -5.0f, 0.0f)),
-		};
+		//The ground heights for every plane are found all at once
+		std::vector<glm::vec3> positions(planes.size() * PLANE_CRASH_POINTS);
+		std::vector<float> groundheights(planes.size() * PLANE_CRASH_POINTS);
+		for(size_t i = 0; i < planes.size(); i++)
+			positions[i] = planes.transforms[i].position;
+		infworld::getGroundHeights(
+			heights,
+			positions.data(),
+			groundheights.data(),
+			planes.size()
+		);
 
-		for(int i = 0; i < 4; i++) {
-			glm::vec3 pos = positions[i];
-			h = infworld::getHeight(
-				pos.z / SCALE * float(PREC + 1) / float(PREC),
-				pos.x / SCALE * float(PREC + 1) / float(PREC),
-				permutations
-			) * HEIGHT * SCALE;
-			if(pos.y - h < MAX_HEIGHT_DIFF || pos.y < MAX_HEIGHT_DIFF / 2.0f) {
-				scorevalue = 0;
-				hitpoints = 0;
-				return;
+		for(size_t i = 0; i < planes.size(); i++) {
+			updatePlane(
+				planes.transforms[i],
+				planes.states[i],
+				std::max(groundheights[i], 0.0f),
+				dt,
+				player,
+				bullets
+			);
+		}
+
+		//Check if any of the planes crashed into the terrain
+		for(size_t i = 0; i < planes.size(); i++) {
+			const game::Transform &transform = planes.transforms[i];
+			glm::vec3 *points = &positions[i * PLANE_CRASH_POINTS];
+			points[0] = transform.position;
+			points[1] = transform.position + transform.rotate(glm::vec3(-9.0f, 0.0f, 0.0f));
+			points[2] = transform.position + transform.rotate(glm::vec3(10.0f, 0.0f, 0.0f));
+			points[3] = transform.position + transform.rotate(glm::vec3(-13.0f, -5.0f, 0.0f));
+			points[4] = transform.position + transform.rotate(glm::vec3(13.0f, -5.0f, 0.0f));
+		}
+		infworld::getGroundHeights(
+			heights,
+			positions.data(),
+			groundheights.data(),
+			positions.size()
+		);
+		for(size_t i = 0; i < planes.size(); i++) {
+			size_t first = i * PLANE_CRASH_POINTS;
+			if(planeCrashed(&positions[first], &groundheights[first])) {
+				//Do not give any score if the plane crashes into the terrain
+				planes.scorevalues[i] = 0;
+				planes.hitpoints[i] = 0;
 			}
 		}
 	}
 
-	Enemy spawnPlane(
+	void spawnPlane(
+		Planes &planes,
 		const glm::vec3 &position,
 		float rotation,
-		const infworld::worldseed &permutations
+		infworld::HeightCache &heights
 	) {
-		float h = infworld::getHeight(
-			position.z / SCALE * float(PREC + 1) / float(PREC),
-			position.x / SCALE * float(PREC + 1) / float(PREC),
-			permutations
-		) * HEIGHT * SCALE;
+		float h = infworld::getGroundHeight(heights, position);
 		float y = std::max(h, 0.0f) + HEIGHT;
 		glm::vec3 pos(position.x, y, position.z);
 
-		Enemy plane = Enemy(pos, 14, 50);
-		plane.setVal("rotationdirection", 1.0f);
-		plane.setVal("rotationtimer", 0.0f);
-		plane.setVal("shoottimer", 0.0f);
-		plane.transform.rotation.y = rotation;
-		return plane;
+		planes.add(pos, 14, 50, PlaneState{ 1.0f, 0.0f, 0.0f });
+		planes.transforms.back().rotation.y = rotation;
 	}
 }
 
 namespace game {
 	void spawnPlanes(
 		gameobjects::Player &player,
-		std::vector<gameobjects::Enemy> &planes,
+		gameobjects::Planes &planes,
 		std::minstd_rand0 &lcg,
-		const infworld::worldseed &permutations,
+		infworld::HeightCache &heights,
 		float totalTime
 	) {
 		if(planes.size() >= 6)
@@ -231,7 +256,7 @@ namespace game {
 			float angle = float(lcg() % 256) / 256.0f * glm::radians(360.0f);
 			glm::vec3 position = center + dist * glm::vec3(cosf(angle), 0.0f, sinf(angle));
 			float rotation = float(lcg() % 256) / 256.0f * glm::radians(360.0f);
-			planes.push_back(gobjs::spawnPlane(position, rotation, permutations));
+			gobjs::spawnPlane(planes, position, rotation, heights);
 		}
 	}
 }
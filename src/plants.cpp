@@ -109,12 +109,32 @@ mesh::Model createBranchEnd(
 			glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
 
 		mesh::transformModel(leaves, transform);
-		endsegment = mesh::mergeModels(endsegment, leaves);
+		mesh::appendModel(endsegment, leaves);
 	}
 
 	return endsegment;
 }
 
+//Looks up a plant in the model cache, the key is made from the name of the
+//plant and the parameters used to generate it
+mesh::Model getCachedPlant(
+	mesh::ModelCache &cache,
+	const std::string &name,
+	unsigned int detail,
+	mesh::Model (*generate)(unsigned int)
+) {
+	uint64_t key = mesh::hashModelKey(name.data(), name.size());
+	key = mesh::hashModelKey(&plants::PLANT_MODEL_VERSION, sizeof(plants::PLANT_MODEL_VERSION), key);
+	key = mesh::hashModelKey(&detail, sizeof(detail), key);
+
+	mesh::Model model;
+	if(cache.get(key, model))
+		return model;
+	model = generate(detail);
+	cache.add(key, model);
+	return model;
+}
+
 namespace plants {
 	std::string lsystem(
 		unsigned int iterations,
@@ -176,7 +196,7 @@ namespace plants {
 					treepart = createBranchSegment(branch, thickness, decreaseAmt, length, detail);
 				branch.position += glm::vec3(branch.transform * glm::vec4(0.0f, length, 0.0f, 1.0f));
 				branch.depth++;
-				plant = mesh::mergeModels(plant, treepart);
+				mesh::appendModel(plant, treepart);
 				break;
 			case '[':
 				branchStack.push(branch);
@@ -193,13 +213,23 @@ namespace plants {
 		return plant;
 	}
 
-	gfx::Vao createPineTreeModel(unsigned int detail)
+	gfx::Vao createTreeVao(const mesh::Model &model)
 	{
-		gfx::Vao pinetree;
+		gfx::Vao tree;
 		//Index 4 is the instance offset array
-		pinetree.genBuffers(5);
-		pinetree.bind();
+		tree.genBuffers(5);
+		tree.bind();
+		tree.vertcount = model.indices.size();
+		model.dataToBuffers(tree.buffers);
+		glBindBuffer(GL_ARRAY_BUFFER, tree.buffers.at(4));
+		glVertexAttribPointer(3, 3, GL_FLOAT, false, 3 * sizeof(float), (void*)0);
+		glEnableVertexAttribArray(3);
+		glVertexAttribDivisor(3, 1);
+		return tree;
+	}
 
+	mesh::Model createPineTree(unsigned int detail)
+	{
 		glm::mat4 transform;
 		glm::mat4 transformtc;
 
@@ -220,7 +250,7 @@ namespace plants {
 			transformtc = glm::translate(transformtc, glm::vec3(0.01f, 0.0f, 0.0f));
 			transformtc = glm::scale(transformtc, glm::vec3(0.48f, 8.0f / 5.0f, 1.0f));
 			mesh::transformModelTc(bottom, transformtc);
-			treemodel = mesh::mergeModels(treemodel, bottom);
+			mesh::appendModel(treemodel, bottom);
 		}
 
 		//Generate rest of the pine tree
@@ -240,27 +270,15 @@ namespace plants {
 			mesh::transformModel(part, transform);	
 			mesh::transformModelTc(part, transformtc);
 			
-			treemodel = mesh::mergeModels(treemodel, part);
+			mesh::appendModel(treemodel, part);
 			top.y -= scale * 0.6f;
 		}	
 
-		pinetree.vertcount = treemodel.indices.size();	
-		treemodel.dataToBuffers(pinetree.buffers);
-		glBindBuffer(GL_ARRAY_BUFFER, pinetree.buffers.at(4));
-		glVertexAttribPointer(3, 3, GL_FLOAT, false, 3 * sizeof(float), (void*)0);
-		glEnableVertexAttribArray(3);
-		glVertexAttribDivisor(3, 1);
-
-		return pinetree;
+		return treemodel;
 	}
 
-	gfx::Vao createTreeModel(unsigned int detail)
+	mesh::Model createTree(unsigned int detail)
 	{
-		gfx::Vao tree;
-		//Index 4 is the instance offset array
-		tree.genBuffers(5);
-		tree.bind();
-
 		const float ANGLE = glm::radians(30.0f);
 		const float LENGTH = 0.8f;
 		const float THICKNESS = 0.15f;
@@ -288,16 +306,99 @@ namespace plants {
 			transformtc = glm::translate(transformtc, glm::vec3(0.01f, 0.0f, 0.0f));
 			transformtc = glm::scale(transformtc, glm::vec3(0.48f, 8.0f / 5.0f, 1.0f));
 			mesh::transformModelTc(bottom, transformtc);
-			treemodel = mesh::mergeModels(treemodel, bottom);
+			mesh::appendModel(treemodel, bottom);
 		}
 
-		tree.vertcount = treemodel.indices.size();
-		treemodel.dataToBuffers(tree.buffers);
-		glBindBuffer(GL_ARRAY_BUFFER, tree.buffers.at(4));
-		glVertexAttribPointer(3, 3, GL_FLOAT, false, 3 * sizeof(float), (void*)0);
-		glEnableVertexAttribArray(3);
-		glVertexAttribDivisor(3, 1);
+		return treemodel;
+	}
 
-		return tree;
+	mesh::Model createPineTree(mesh::ModelCache &cache, unsigned int detail)
+	{
+		return getCachedPlant(cache, "pinetree", detail, createPineTree);
+	}
+
+	mesh::Model createTree(mesh::ModelCache &cache, unsigned int detail)
+	{
+		return getCachedPlant(cache, "tree", detail, createTree);
+	}
+
+	ImpostorBounds findImpostorBounds(const mesh::Model &model)
+	{
+		ImpostorBounds bounds = { 0.0f, 0.0f, 0.0f };
+		if(model.vertices.empty())
+			return bounds;
+		bounds.bottom = bounds.top = model.vertices.at(0).y;
+		for(const auto &v : model.vertices) {
+			bounds.radius = std::max(bounds.radius, glm::length(glm::vec2(v.x, v.z)));
+			bounds.bottom = std::min(bounds.bottom, v.y);
+			bounds.top = std::max(bounds.top, v.y);
+		}
+		//Pad the bounds so that the edges of each view in the atlas are
+		//transparent, otherwise the texels would bleed into the neighbouring
+		//views when sampled
+		float padding = std::max(bounds.radius * 2.0f, bounds.top - bounds.bottom) * IMPOSTOR_PADDING;
+		bounds.radius += padding;
+		bounds.bottom -= padding;
+		bounds.top += padding;
+		return bounds;
+	}
+
+	//The quad for view i faces along this direction
+	glm::vec3 impostorNormal(unsigned int i)
+	{
+		float angle = float(M_PI) * float(i) / float(IMPOSTOR_VIEWS);
+		return glm::vec3(std::sin(angle), 0.0f, std::cos(angle));
+	}
+
+	glm::mat4 impostorProjection(const ImpostorBounds &bounds)
+	{
+		return glm::ortho(
+			-bounds.radius,
+			bounds.radius,
+			bounds.bottom,
+			bounds.top,
+			0.0f,
+			bounds.radius * 4.0f
+		);
+	}
+
+	glm::mat4 impostorView(const ImpostorBounds &bounds, unsigned int i)
+	{
+		return glm::lookAt(
+			impostorNormal(i) * bounds.radius * 2.0f,
+			glm::vec3(0.0f),
+			glm::vec3(0.0f, 1.0f, 0.0f)
+		);
+	}
+
+	gfx::Vao createImpostorModel(
+		const ImpostorBounds &bounds,
+		unsigned int row,
+		unsigned int rows
+	) {
+		mesh::Model impostor;
+		float v0 = float(row) / float(rows), v1 = float(row + 1) / float(rows);
+		for(unsigned int i = 0; i < IMPOSTOR_VIEWS; i++) {
+			glm::vec3 n = impostorNormal(i);
+			//This is the right vector of impostorView(bounds, i) so that
+			//the quad lines up with the baked view
+			glm::vec3 right = glm::vec3(n.z, 0.0f, -n.x) * bounds.radius;
+			float u0 = float(i) / float(IMPOSTOR_VIEWS), u1 = float(i + 1) / float(IMPOSTOR_VIEWS);
+			unsigned int start = impostor.vertices.size();
+			impostor.vertices.push_back(-right + glm::vec3(0.0f, bounds.bottom, 0.0f));
+			impostor.vertices.push_back(right + glm::vec3(0.0f, bounds.bottom, 0.0f));
+			impostor.vertices.push_back(right + glm::vec3(0.0f, bounds.top, 0.0f));
+			impostor.vertices.push_back(-right + glm::vec3(0.0f, bounds.top, 0.0f));
+			impostor.texturecoords.push_back(glm::vec2(u0, v0));
+			impostor.texturecoords.push_back(glm::vec2(u1, v0));
+			impostor.texturecoords.push_back(glm::vec2(u1, v1));
+			impostor.texturecoords.push_back(glm::vec2(u0, v1));
+			for(int j = 0; j < 4; j++)
+				impostor.normals.push_back(n);
+			const unsigned int indices[] = { 0, 1, 2, 2, 3, 0 };
+			for(unsigned int index : indices)
+				impostor.indices.push_back(start + index);
+		}
+		return createTreeVao(impostor);
 	}
 }
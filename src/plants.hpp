@@ -51,6 +51,40 @@ namespace plants {
 		float decreaseAmt,
 		unsigned int detail
 	);
-	gfx::Vao createPineTreeModel(unsigned int detail);	
-	gfx::Vao createTreeModel(unsigned int detail);
+	mesh::Model createPineTree(unsigned int detail);
+	mesh::Model createTree(unsigned int detail);
+	//Increase this whenever the way the plants are generated changes so
+	//that models cached by an older version are not used
+	constexpr uint32_t PLANT_MODEL_VERSION = 1;
+	//These return the model from the cache if it is there, otherwise it is
+	//generated and added to the cache
+	mesh::Model createPineTree(mesh::ModelCache &cache, unsigned int detail);
+	mesh::Model createTree(mesh::ModelCache &cache, unsigned int detail);
+	//Creates a vao for a tree model, index 4 is the instance offset array
+	gfx::Vao createTreeVao(const mesh::Model &model);
+
+	//Far away trees are drawn as impostors: IMPOSTOR_VIEWS vertical quads
+	//that cross at the trunk, each quad shows a picture of the tree taken
+	//from along its normal. The pictures are baked into a texture atlas
+	//that has a row for each kind of tree and a column for each view
+	constexpr unsigned int IMPOSTOR_VIEWS = 3;
+	//Size of each view in the atlas (in pixels)
+	constexpr unsigned int IMPOSTOR_RESOLUTION = 256;
+	//Fraction of the size of the tree that is added around each view
+	constexpr float IMPOSTOR_PADDING = 0.04f;
+	struct ImpostorBounds {
+		float radius; //Largest distance of the tree from the trunk
+		float bottom, top;
+	};
+	ImpostorBounds findImpostorBounds(const mesh::Model &model);
+	//Projection and view matrices for taking the picture for view i
+	glm::mat4 impostorProjection(const ImpostorBounds &bounds);
+	glm::mat4 impostorView(const ImpostorBounds &bounds, unsigned int i);
+	//Creates the impostor of a tree that is in row 'row' of an atlas with
+	//'rows' rows
+	gfx::Vao createImpostorModel(
+		const ImpostorBounds &bounds,
+		unsigned int row,
+		unsigned int rows
+	);
 }
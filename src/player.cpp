@@ -172,7 +172,7 @@ namespace gameobjects {
 		shoottimer = 0.2f;
 	}
 
-	void Player::checkIfCrashed(float dt, const infworld::worldseed &permutations)
+	void Player::checkIfCrashed(float dt, infworld::HeightCache &heights)
 	{
 		if(crashed)
 			return;
@@ -183,33 +183,22 @@ namespace gameobjects {
 			return;
 		}
 
-		glm::vec3 pos = transform.position + transform.direction() * SPEED * dt;
-		float h = infworld::getHeight(
-			pos.z / SCALE * float(PREC + 1) / float(PREC),
-			pos.x / SCALE * float(PREC + 1) / float(PREC),
-			permutations
-		) * HEIGHT * SCALE;
-		//Maximum height difference between
-		const float MAX_HEIGHT_DIFF = 8.0f;
-		if(pos.y - h < MAX_HEIGHT_DIFF || pos.y < MAX_HEIGHT_DIFF / 2.0f) {
-			crashed = true;
-			return;
-		}
-
 		glm::vec3 positions[] = {
+			transform.position + transform.direction() * SPEED * dt,
 			transform.position + transform.rotate(glm::vec3(-9.0f, 0.0f, 0.0f)),
 			transform.position + transform.rotate(glm::vec3(10.0f, 0.0f, 0.0f)),
 			transform.position + transform.rotate(glm::vec3(-13.0f, -5.0f, 0.0f)),
 			transform.position + transform.rotate(glm::vec3(13.0f, -5.0f, 0.0f)),
 		};
 
-		for(int i = 0; i < 4; i++) {
+		float groundheights[5];
+		infworld::getGroundHeights(heights, positions, groundheights, 5);
+
+		//Maximum height difference between
+		const float MAX_HEIGHT_DIFF = 8.0f;
+		for(int i = 0; i < 5; i++) {
 			glm::vec3 pos = positions[i];
-			h = infworld::getHeight(
-				pos.z / SCALE * float(PREC + 1) / float(PREC),
-				pos.x / SCALE * float(PREC + 1) / float(PREC),
-				permutations
-			) * HEIGHT * SCALE;
+			float h = groundheights[i];
 			if(pos.y - h < MAX_HEIGHT_DIFF || pos.y < MAX_HEIGHT_DIFF / 2.0f) {
 				crashed = true;
 				return;
@@ -0,0 +1,125 @@
+#include "gfx.hpp"
+#include "shader.hpp"
+#include <algorithm>
+
+namespace {
+	//From the most significant bits: layer (4 bits), state (4 bits),
+	//program (16 bits), texture (20 bits), vao (20 bits)
+	uint64_t makeSortKey(const gfx::DrawPacket &packet)
+	{
+		uint64_t program = packet.shader->getid() & 0xffff;
+		uint64_t texture = packet.texture & 0xfffff;
+		uint64_t vao = packet.vao ? packet.vao->vaoid & 0xfffff : 0;
+		return
+			(uint64_t(packet.layer & 0xf) << 60) |
+			(uint64_t(packet.state & 0xf) << 56) |
+			(program << 40) |
+			(texture << 20) |
+			vao;
+	}
+}
+
+namespace gfx {
+	unsigned int RenderQueue::addInstance(const InstanceData &instance)
+	{
+		instances.push_back(instance);
+		return instances.size() - 1;
+	}
+
+	const InstanceData& RenderQueue::getInstance(unsigned int index) const
+	{
+		return instances.at(index);
+	}
+
+	unsigned int RenderQueue::instanceCount() const
+	{
+		return instances.size();
+	}
+
+	void RenderQueue::submit(const DrawPacket &packet)
+	{
+		if(!packet.shader)
+			return;
+		keys.push_back({ makeSortKey(packet), (unsigned int)packets.size() });
+		packets.push_back(packet);
+	}
+
+	void RenderQueue::setState(unsigned int newstate)
+	{
+		unsigned int changed = newstate ^ state;
+		if(changed & STATE_NO_CULL) {
+			if(newstate & STATE_NO_CULL)
+				glDisable(GL_CULL_FACE);
+			else
+				glEnable(GL_CULL_FACE);
+		}
+		if(changed & STATE_CULL_FRONT)
+			glCullFace(newstate & STATE_CULL_FRONT ? GL_FRONT : GL_BACK);
+		if(changed & STATE_NO_DEPTH_WRITE)
+			glDepthMask(newstate & STATE_NO_DEPTH_WRITE ? GL_FALSE : GL_TRUE);
+		state = newstate;
+	}
+
+	void RenderQueue::execute()
+	{
+		//Draws with the same key stay in the order they were submitted in
+		std::stable_sort(
+			keys.begin(),
+			keys.end(),
+			[](const SortKey &a, const SortKey &b) { return a.key < b.key; }
+		);
+
+		//Anything could have been bound since the last time
+		state = program = texture = vao = ~0u;
+		for(const auto &key : keys) {
+			DrawPacket &packet = packets.at(key.index);
+			setState(packet.state);
+			if(packet.shader->getid() != program) {
+				packet.shader->use();
+				program = packet.shader->getid();
+			}
+			if(packet.texture && packet.texture != texture) {
+				glActiveTexture(GL_TEXTURE0);
+				glBindTexture(packet.texturetarget, packet.texture);
+				texture = packet.texture;
+			}
+			if(packet.vao && packet.vao->vaoid != vao) {
+				packet.vao->bind();
+				vao = packet.vao->vaoid;
+			}
+			if(packet.vao && packet.uploadcount > 0) {
+				uploadInstances(
+					*packet.vao,
+					&instances.at(packet.firstinstance),
+					packet.uploadcount
+				);
+			}
+
+			if(packet.uniforms)
+				packet.uniforms(*packet.shader);
+			if(packet.draw) {
+				//The draw has to leave texture unit 0 active, it only binds
+				//a vao if the packet does not have one
+				packet.draw(*packet.shader);
+				if(!packet.vao)
+					vao = ~0u;
+			}
+			else if(packet.vao && packet.instancecount == 1)
+				glDrawElements(GL_TRIANGLES, packet.vao->vertcount, GL_UNSIGNED_INT, 0);
+			else if(packet.vao && packet.instancecount > 1) {
+				glDrawElementsInstanced(
+					GL_TRIANGLES,
+					packet.vao->vertcount,
+					GL_UNSIGNED_INT,
+					0,
+					packet.instancecount
+				);
+			}
+		}
+		setState(STATE_DEFAULT);
+
+		packets.clear();
+		keys.clear();
+		instances.clear();
+	}
+}
@@ -13,6 +13,8 @@ GlobalSettings::GlobalSettings()
 	//Inititalize default settings
 	values.volume = 1.0f;
 	values.canDisplayCrosshair = true;
+	values.gpuTerrain = false;
+	values.occlusionCulling = true;
 }
 
 void GlobalSettings::loadFromFile(const char *path)
@@ -29,6 +31,16 @@ void GlobalSettings::loadFromFile(const char *path)
 	else
 		values.canDisplayCrosshair = true;
 
+	if(settings.getVar("gpu_terrain") == "true")
+		values.gpuTerrain = true;
+	else
+		values.gpuTerrain = false;
+
+	if(settings.getVar("occlusion_culling") == "false")
+		values.occlusionCulling = false;
+	else
+		values.occlusionCulling = true;
+
 	std::string volumeStr = settings.getVar("volume");
 	if(volumeStr.empty())
 		values.volume = 1.0f;
@@ -51,6 +63,8 @@ void GlobalSettings::save(const char *path)
 	impfile::Entry entry;
 	entry.name = "settings";
 	impfile::addBoolean(entry, "display_crosshair", values.canDisplayCrosshair);
+	impfile::addBoolean(entry, "gpu_terrain", values.gpuTerrain);
+	impfile::addBoolean(entry, "occlusion_culling", values.occlusionCulling);
 	impfile::addFloat(entry, "volume", values.volume);
 	std::string filecontents = impfile::entryToString(entry);
 
@@ -12,6 +12,10 @@ struct SettingsValues {
 	//From 0.0 to 1.0
 	float volume;
 	bool canDisplayCrosshair;
+	//Generate the terrain on the GPU instead of the CPU
+	bool gpuTerrain;
+	//Skip terrain and trees that are hidden behind hills
+	bool occlusionCulling;
 };
 
 class GlobalSettings {
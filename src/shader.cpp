@@ -78,6 +78,7 @@ ShaderProgram::ShaderProgram(unsigned int vertex, unsigned int fragment)
 
 	glDetachShader(programid, vertex);
 	glDetachShader(programid, fragment);
+	findUniforms();
 }
 
 ShaderProgram::ShaderProgram(const char *vertpath, const char *fragpath)
@@ -107,25 +108,106 @@ ShaderProgram::ShaderProgram(const char *vertpath, const char *fragpath)
 
 	glDetachShader(programid, vertex);
 	glDetachShader(programid, fragment);
+	findUniforms();
 	//Clean up
 	glDeleteShader(vertex);
 	glDeleteShader(fragment);
 }
 
+ShaderProgram::ShaderProgram(const char *vertpath, const std::vector<const char*> &varyings)
+{
+	programid = glCreateProgram();
+
+	unsigned int vertex = createShader(vertpath, GL_VERTEX_SHADER);
+	glAttachShader(programid, vertex);
+	//This has to be set before the program is linked
+	glTransformFeedbackVaryings(
+		programid,
+		varyings.size(),
+		&varyings[0],
+		GL_INTERLEAVED_ATTRIBS
+	);
+	glLinkProgram(programid);
+
+	//Check for linker errors
+	int linkStatus;
+	glGetProgramiv(programid, GL_LINK_STATUS, &linkStatus);
+	//Failed to link
+	if(linkStatus != 1) {
+		//Output linker errors
+		std::cerr << "Failed to link program!\n";
+
+		char message[1024];
+		int len;
+		glGetProgramInfoLog(programid, 1023, &len, message);
+		std::cerr << message << '\n';
+	}
+
+	glDetachShader(programid, vertex);
+	findUniforms();
+	//Clean up
+	glDeleteShader(vertex);
+}
+
 void ShaderProgram::use()
 {
 	glUseProgram(programid);
 }
 
-int ShaderProgram::getUniformLocation(const char *uniformName)
+void ShaderProgram::findUniforms()
 {
-	if(uniformLocations.count(uniformName) == 0) {
-		int location = glGetUniformLocation(programid, uniformName);
-		uniformLocations[uniformName] = location;
-		return location;
+	int count = 0;
+	glGetProgramiv(programid, GL_ACTIVE_UNIFORMS, &count);
+	for(int i = 0; i < count; i++) {
+		char name[256];
+		int len = 0, size;
+		GLenum type;
+		glGetActiveUniform(programid, i, sizeof(name), &len, &size, &type, name);
+		std::string uniformName(name, len);
+		//Uniforms in a uniform block have no location
+		int location = glGetUniformLocation(programid, uniformName.c_str());
+		if(location == -1)
+			continue;
+		//Arrays are listed with the name of their first element
+		if(uniformName.size() > 3 && uniformName.compare(uniformName.size() - 3, 3, "[0]") == 0)
+			uniformName.resize(uniformName.size() - 3);
+		switch(type) {
+		case GL_SAMPLER_2D:
+		case GL_SAMPLER_3D:
+		case GL_SAMPLER_CUBE:
+		case GL_SAMPLER_2D_ARRAY:
+		case GL_SAMPLER_2D_SHADOW:
+		case GL_SAMPLER_BUFFER:
+		case GL_INT_SAMPLER_BUFFER:
+		case GL_UNSIGNED_INT_SAMPLER_BUFFER:
+			//Samplers are set with uniformInt
+			type = GL_INT;
+			break;
+		default:
+			break;
+		}
+		uniforms[uniformName] = { location, type };
 	}
+}
 
-	return uniformLocations[uniformName];
+int ShaderProgram::findUniform(const char *uniformName, GLenum type) const
+{
+	auto uniform = uniforms.find(uniformName);
+	if(uniform == uniforms.end())
+		return -1;
+	if(uniform->second.type != type) {
+		std::cerr << "Uniform " << uniformName << " has the wrong type!\n";
+		return -1;
+	}
+	return uniform->second.location;
+}
+
+int ShaderProgram::getUniformLocation(const char *uniformName) const
+{
+	auto uniform = uniforms.find(uniformName);
+	if(uniform == uniforms.end())
+		return -1;
+	return uniform->second.location;
 }
 
 int ShaderProgram::getUniformBlockIndex(const char *uniformBlockName)
@@ -182,6 +264,52 @@ void ShaderProgram::uniformInt(const char *uniformName, int value)
 	glUniform1i(location, value);
 }
 
+void ShaderProgram::uniformIVec2(const char *uniformName, const glm::ivec2 &vec)
+{
+	int location = getUniformLocation(uniformName);
+	glUniform2i(location, vec.x, vec.y);
+}
+
+void ShaderProgram::uniformMat3x3(Uniform<glm::mat3> uniform, const glm::mat3 &mat)
+{
+	glUniformMatrix3fv(uniform.location, 1, false, glm::value_ptr(mat));
+}
+
+void ShaderProgram::uniformMat4x4(Uniform<glm::mat4> uniform, const glm::mat4 &mat)
+{
+	glUniformMatrix4fv(uniform.location, 1, false, glm::value_ptr(mat));
+}
+
+void ShaderProgram::uniformVec4(Uniform<glm::vec4> uniform, const glm::vec4 &vec)
+{
+	glUniform4f(uniform.location, vec.x, vec.y, vec.z, vec.w);
+}
+
+void ShaderProgram::uniformVec3(Uniform<glm::vec3> uniform, const glm::vec3 &vec)
+{
+	glUniform3f(uniform.location, vec.x, vec.y, vec.z);
+}
+
+void ShaderProgram::uniformVec2(Uniform<glm::vec2> uniform, const glm::vec2 &vec)
+{
+	glUniform2f(uniform.location, vec.x, vec.y);
+}
+
+void ShaderProgram::uniformFloat(Uniform<float> uniform, float value)
+{
+	glUniform1f(uniform.location, value);
+}
+
+void ShaderProgram::uniformInt(Uniform<int> uniform, int value)
+{
+	glUniform1i(uniform.location, value);
+}
+
+void ShaderProgram::uniformIVec2(Uniform<glm::ivec2> uniform, const glm::ivec2 &vec)
+{
+	glUniform2i(uniform.location, vec.x, vec.y);
+}
+
 unsigned int ShaderProgram::getid()
 {
 	return programid;
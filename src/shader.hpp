@@ -4,6 +4,7 @@
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 #include <map>
+#include <vector>
 
 typedef unsigned int ShaderId;
 
@@ -19,9 +20,37 @@ std::string readShaderFile(const char *path);
 //will output any compiler errors to stderr
 unsigned int createShader(const char *path, GLenum shaderType);
 
+//Handle to a uniform in a shader program, these are looked up once with
+//ShaderProgram::getUniform and then used to set the uniform without
+//having to look up the name again
+template<typename T>
+struct Uniform {
+	int location = -1;
+};
+
+//The type of uniform in the shader that each handle type can be used for
+template<typename T> struct UniformType;
+template<> struct UniformType<glm::mat3> { static constexpr GLenum type = GL_FLOAT_MAT3; };
+template<> struct UniformType<glm::mat4> { static constexpr GLenum type = GL_FLOAT_MAT4; };
+template<> struct UniformType<glm::vec4> { static constexpr GLenum type = GL_FLOAT_VEC4; };
+template<> struct UniformType<glm::vec3> { static constexpr GLenum type = GL_FLOAT_VEC3; };
+template<> struct UniformType<glm::vec2> { static constexpr GLenum type = GL_FLOAT_VEC2; };
+template<> struct UniformType<float> { static constexpr GLenum type = GL_FLOAT; };
+//Samplers are also set with integers
+template<> struct UniformType<int> { static constexpr GLenum type = GL_INT; };
+template<> struct UniformType<glm::ivec2> { static constexpr GLenum type = GL_INT_VEC2; };
+
 class ShaderProgram {
-	std::map<std::string, int> uniformLocations;
+	struct UniformInfo {
+		int location;
+		GLenum type;
+	};
+	//Active uniforms in the program, these are found when the program is
+	//linked so that looking up a name does not need to call OpenGL
+	std::map<std::string, UniformInfo, std::less<>> uniforms;
 	unsigned int programid;
+	void findUniforms();
+	int findUniform(const char *uniformName, GLenum type) const;
 public:
 	//creates a shader program by taking in two shader ids,
 	//one that is a vertex shader and the other that is
@@ -30,8 +59,19 @@ public:
 	ShaderProgram(unsigned int vertex, unsigned int fragment);
 	//creates a shader by taking the path of a vertex and fragment shader
 	ShaderProgram(const char *vertpath, const char *fragpath);
+	//creates a shader program with only a vertex shader whose outputs
+	//named in `varyings` are captured with transform feedback, they
+	//are written one after the other into a single buffer
+	ShaderProgram(const char *vertpath, const std::vector<const char*> &varyings);
 	void use();
-	int getUniformLocation(const char *uniformName);
+	int getUniformLocation(const char *uniformName) const;
+	//Returns a handle to the uniform, the handle has a location of -1 if
+	//the uniform does not exist or is of a different type
+	template<typename T>
+	Uniform<T> getUniform(const char *uniformName) const
+	{
+		return Uniform<T>{ findUniform(uniformName, UniformType<T>::type) };
+	}
 	int getUniformBlockIndex(const char *uniformBlockName);
 	void setBinding(const char *uniformBlockName, unsigned int binding);
 	unsigned int getid();
@@ -43,4 +83,16 @@ public:
 	void uniformVec2(const char *uniformName, const glm::vec2 &vec);
 	void uniformFloat(const char *uniformName, float value);
 	void uniformInt(const char *uniformName, int value);
+	void uniformIVec2(const char *uniformName, const glm::ivec2 &vec);
+
+	//These should be used in loops where the same uniforms are set
+	//many times, the program must be in use
+	void uniformMat3x3(Uniform<glm::mat3> uniform, const glm::mat3 &mat);
+	void uniformMat4x4(Uniform<glm::mat4> uniform, const glm::mat4 &mat);
+	void uniformVec4(Uniform<glm::vec4> uniform, const glm::vec4 &vec);
+	void uniformVec3(Uniform<glm::vec3> uniform, const glm::vec3 &vec);
+	void uniformVec2(Uniform<glm::vec2> uniform, const glm::vec2 &vec);
+	void uniformFloat(Uniform<float> uniform, float value);
+	void uniformInt(Uniform<int> uniform, int value);
+	void uniformIVec2(Uniform<glm::ivec2> uniform, const glm::ivec2 &vec);
 };
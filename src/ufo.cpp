@@ -5,55 +5,66 @@ namespace gobjs = gameobjects;
 constexpr float UFO_ROTATION_TIME = 10.0f;
 
 namespace gameobjects {
-	void Enemy::updateUfo(float dt, const infworld::worldseed &permutations)
+	void updateUfos(Ufos &ufos, float dt, infworld::HeightCache &heights)
 	{
-		transform.position += transform.direction() * 144.0f * dt;
-		float h = infworld::getHeight(
-			transform.position.z / SCALE * float(PREC + 1) / float(PREC),
-			transform.position.x / SCALE * float(PREC + 1) / float(PREC),
-			permutations
-		) * HEIGHT * SCALE;
-		float y = std::max(h, 0.0f) + HEIGHT * 1.25f;
-		if(std::abs(transform.position.y - y) > 4.0f)
-			transform.position.y += (y - transform.position.y) * 2.0f * dt;
+		if(ufos.empty())
+			return;
+
+		//Move every ufo first so that the ground heights can be found
+		//all at once
+		std::vector<glm::vec3> positions(ufos.size());
+		std::vector<float> groundheights(ufos.size());
+		for(size_t i = 0; i < ufos.size(); i++) {
+			game::Transform &transform = ufos.transforms[i];
+			transform.position += transform.direction() * 144.0f * dt;
+			positions[i] = transform.position;
+		}
+		infworld::getGroundHeights(
+			heights,
+			positions.data(),
+			groundheights.data(),
+			ufos.size()
+		);
+
+		for(size_t i = 0; i < ufos.size(); i++) {
+			game::Transform &transform = ufos.transforms[i];
+			UfoState &ufo = ufos.states[i];
+			float y = std::max(groundheights[i], 0.0f) + HEIGHT * 1.25f;
+			if(std::abs(transform.position.y - y) > 4.0f)
+				transform.position.y += (y - transform.position.y) * 2.0f * dt;
 
-		values.at("rotationtimer") -= dt;
-		if(values.at("rotationtimer") < 0.0f && values.at("rotationtimer") > -1.0f)
-			transform.rotation.y += values.at("rotationspeed") * dt;
+			ufo.rotationtimer -= dt;
+			if(ufo.rotationtimer < 0.0f && ufo.rotationtimer > -1.0f)
+				transform.rotation.y += ufo.rotationspeed * dt;
 
-		if(values.at("rotationtimer") <= -1.0f) {
-			values.at("rotationspeed") *= -1.0f;
-			values.at("rotationtimer") = UFO_ROTATION_TIME;
+			if(ufo.rotationtimer <= -1.0f) {
+				ufo.rotationspeed *= -1.0f;
+				ufo.rotationtimer = UFO_ROTATION_TIME;
+			}
 		}
 	}
 
-	Enemy spawnUfo(
+	void spawnUfo(
+		Ufos &ufos,
 		const glm::vec3 &position,
 		float rotation,
-		const infworld::worldseed &permutations
+		infworld::HeightCache &heights
 	) {
-		float h = infworld::getHeight(
-			position.z / SCALE * float(PREC + 1) / float(PREC),
-			position.x / SCALE * float(PREC + 1) / float(PREC),
-			permutations
-		) * HEIGHT * SCALE;
+		float h = infworld::getGroundHeight(heights, position);
 		float y = std::max(h, 0.0f) + HEIGHT * 1.25f;
 		glm::vec3 pos(position.x, y, position.z);
 
-		Enemy ufo = Enemy(pos, 8, 500);
-		ufo.transform.rotation.y = rotation;
-		ufo.setVal("rotationspeed", 1.0f);
-		ufo.setVal("rotationtimer", UFO_ROTATION_TIME);
-		return ufo;
+		ufos.add(pos, 8, 500, UfoState{ 1.0f, UFO_ROTATION_TIME });
+		ufos.transforms.back().rotation.y = rotation;
 	}
 }
 
 namespace game {
 	void spawnUfos(
 		gobjs::Player &player,
-		std::vector<gobjs::Enemy> &ufos,
+		gobjs::Ufos &ufos,
 		std::minstd_rand0 &lcg,
-		const infworld::worldseed &permutations
+		infworld::HeightCache &heights
 	) {
 		if(ufos.size() >= 2)
 			return;
@@ -67,6 +78,6 @@ namespace game {
 		float angle = float(lcg() % 256) / 256.0f * glm::radians(360.0f);
 		glm::vec3 position = center + dist * glm::vec3(cosf(angle), 0.0f, sinf(angle));
 		float rotation = float(lcg() % 256) / 256.0f * glm::radians(360.0f);
-		ufos.push_back(gobjs::spawnUfo(position, rotation, permutations));
+		gobjs::spawnUfo(ufos, position, rotation, heights);
 	}
 }
@@ -157,16 +157,16 @@ namespace game {
 
 	void checkForHit(
 		std::vector<gobjs::Bullet> &bullets,
-		std::vector<gobjs::Enemy> &enemies,
+		gobjs::EnemyColumns &enemies,
 		float hitdist
 	) {
 		for(auto &bullet : bullets) {
-			for(auto &enemy : enemies) {
-				glm::vec3 diff = bullet.transform.position - enemy.transform.position;
+			for(size_t i = 0; i < enemies.size(); i++) {
+				glm::vec3 diff = bullet.transform.position - enemies.transforms[i].position;
 				float dist = glm::length(diff);
 				if(dist < hitdist) {
 					bullet.destroyed = true;
-					enemy.hitpoints--;
+					enemies.hitpoints[i]--;
 				}
 			}
 		}
@@ -189,20 +189,29 @@ namespace game {
 
 	void checkForBulletTerrainCollision(
 		std::vector<gobjs::Bullet> &bullets,
-		infworld::worldseed &permutations
+		infworld::HeightCache &heights
 	) {
-		bullets.erase(std::remove_if(
-			bullets.begin(),
-			bullets.end(),
-			[&permutations](gobjs::Bullet &bullet) {
-				glm::vec3 pos = bullet.transform.position;
-				float h = infworld::getHeight(
-					pos.z / SCALE * float(PREC + 1) / float(PREC),
-					pos.x / SCALE * float(PREC + 1) / float(PREC),
-					permutations
-				) * HEIGHT * SCALE;
-				return pos.y < h;
-			}
-		), bullets.end());	
+		std::vector<glm::vec3> positions(bullets.size());
+		std::vector<float> groundheights(bullets.size());
+		for(size_t i = 0; i < bullets.size(); i++)
+			positions[i] = bullets[i].transform.position;
+		infworld::getGroundHeights(
+			heights,
+			positions.data(),
+			groundheights.data(),
+			bullets.size()
+		);
+
+		//Bullets that hit the terrain are removed, the rest are moved
+		//forward to fill in the gaps
+		size_t count = 0;
+		for(size_t i = 0; i < bullets.size(); i++) {
+			if(bullets[i].transform.position.y < groundheights[i])
+				continue;
+			if(count != i)
+				bullets[count] = bullets[i];
+			count++;
+		}
+		bullets.resize(count);
 	}	
 }
@@ -0,0 +1,140 @@
+#include "../src/geometry.hpp"
+#include "test.h"
+#include <random>
+
+//A frustum looking down the z axis with its apex at the origin
+geo::Frustum makeFrustum()
+{
+	return {
+		geo::Plane(glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, 1.0f)),
+		geo::Plane(glm::vec3(0.0f, 0.0f, 500.0f), glm::vec3(0.0f, 0.0f, -1.0f)),
+		geo::Plane(glm::vec3(0.0f), glm::vec3(0.0f, -1.0f, 0.7f)),
+		geo::Plane(glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.7f)),
+		geo::Plane(glm::vec3(0.0f), glm::vec3(1.0f, 0.0f, 0.9f)),
+		geo::Plane(glm::vec3(0.0f), glm::vec3(-1.0f, 0.0f, 0.9f)),
+	};
+}
+
+//Returns true if every corner of the box is in front of every plane
+bool cornersInside(const geo::Frustum &frustum, const geo::AABB &aabb)
+{
+	const geo::Plane *planes[] = {
+		&frustum.back,
+		&frustum.front,
+		&frustum.top,
+		&frustum.bottom,
+		&frustum.left,
+		&frustum.right,
+	};
+	for(int i = 0; i < 8; i++) {
+		glm::vec3 corner = aabb.pos + aabb.dimensions * 0.5f * glm::vec3(
+			i & 1 ? 1.0f : -1.0f,
+			i & 2 ? 1.0f : -1.0f,
+			i & 4 ? 1.0f : -1.0f
+		);
+		for(const geo::Plane *p : planes)
+			if(!geo::inFront(*p, corner))
+				return false;
+	}
+	return true;
+}
+
+//The packed test should agree with the plane by plane test on random boxes
+void test1()
+{
+	geo::Frustum frustum = makeFrustum();
+	geo::PackedFrustum packed = geo::packFrustum(frustum);
+	std::minstd_rand lcg(1);
+	std::uniform_real_distribution<float> pos(-600.0f, 600.0f), size(0.1f, 200.0f);
+	int outside = 0, inside = 0;
+	for(int i = 0; i < 10000; i++) {
+		geo::AABB aabb(
+			glm::vec3(pos(lcg), pos(lcg), pos(lcg)),
+			glm::vec3(size(lcg), size(lcg), size(lcg))
+		);
+		geo::FrustumTest result = geo::testFrustum(packed, aabb);
+		assert((result != geo::OUTSIDE) == geo::intersectsFrustum(frustum, aabb));
+		assert(geo::intersectsFrustum(packed, aabb) == geo::intersectsFrustum(frustum, aabb));
+		assert((result == geo::INSIDE) == cornersInside(frustum, aabb));
+		if(result == geo::OUTSIDE)
+			outside++;
+		if(result == geo::INSIDE)
+			inside++;
+	}
+	//Make sure that every case was actually tested
+	assert(outside > 0 && inside > 0 && outside + inside < 10000);
+}
+
+//Boxes that contain the whole frustum or sit right at its apex
+void test2()
+{
+	geo::PackedFrustum packed = geo::packFrustum(makeFrustum());
+	geo::AABB huge(glm::vec3(0.0f), glm::vec3(5000.0f));
+	assert(geo::testFrustum(packed, huge) == geo::INTERSECTS);
+	geo::AABB behind(glm::vec3(0.0f, 0.0f, -10.0f), glm::vec3(2.0f));
+	assert(geo::testFrustum(packed, behind) == geo::OUTSIDE);
+	geo::AABB ahead(glm::vec3(0.0f, 0.0f, 100.0f), glm::vec3(2.0f));
+	assert(geo::testFrustum(packed, ahead) == geo::INSIDE);
+}
+
+//cullSpheres should keep exactly the spheres that are in range and in
+//front of every plane, this includes counts that do not fill a whole SIMD
+//register
+void test3()
+{
+	geo::Frustum frustum = makeFrustum();
+	geo::PackedFrustum packed = geo::packFrustum(frustum);
+	const geo::Plane *planes[] = {
+		&frustum.back,
+		&frustum.front,
+		&frustum.top,
+		&frustum.bottom,
+		&frustum.left,
+		&frustum.right,
+	};
+	std::minstd_rand lcg(2);
+	std::uniform_real_distribution<float> dist(-600.0f, 600.0f);
+	const size_t COUNT = 1003;
+	float xs[COUNT], ys[COUNT], zs[COUNT];
+	for(size_t i = 0; i < COUNT; i++) {
+		xs[i] = dist(lcg);
+		ys[i] = dist(lcg);
+		zs[i] = dist(lcg);
+	}
+
+	glm::vec3 pos(10.0f, -20.0f, 30.0f);
+	float radius = 15.0f, mindist = 100.0f, maxdist = 450.0f;
+	unsigned int indices[COUNT];
+	size_t visible = geo::cullSpheres(
+		packed,
+		xs,
+		ys,
+		zs,
+		COUNT,
+		radius,
+		pos,
+		mindist,
+		maxdist,
+		indices
+	);
+	size_t expected = 0;
+	for(size_t i = 0; i < COUNT; i++) {
+		glm::vec3 center(xs[i], ys[i], zs[i]);
+		float d = glm::length(center - pos);
+		bool pass = d >= mindist && d < maxdist;
+		for(const geo::Plane *p : planes)
+			pass = pass && geo::signedDist(*p, center) >= -radius;
+		if(!pass)
+			continue;
+		assert(expected < visible && indices[expected] == i);
+		expected++;
+	}
+	assert(expected == visible && visible > 0);
+}
+
+int main()
+{
+	TEST(test1());
+	TEST(test2());
+	TEST(test3());
+}
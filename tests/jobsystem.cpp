@@ -0,0 +1,77 @@
+#include "../src/jobsystem.hpp"
+#include "test.h"
+
+//Every submitted job should run exactly once before wait() returns
+void test1()
+{
+	jobs::JobSystem jobsystem(4);
+	std::atomic<int> counter(0);
+	std::vector<int> ran(1000, 0);
+	for(int i = 0; i < 1000; i++) {
+		jobsystem.submit([&counter, &ran, i]() {
+			ran[i]++;
+			counter++;
+		});
+	}
+	jobsystem.wait();
+	assert(counter == 1000);
+	for(int i = 0; i < 1000; i++)
+		assert(ran[i] == 1);
+}
+
+//Jobs submitted from inside other jobs
+void test2()
+{
+	jobs::JobSystem jobsystem(3);
+	std::atomic<int> counter(0);
+	for(int i = 0; i < 50; i++) {
+		jobsystem.submit([&jobsystem, &counter]() {
+			for(int j = 0; j < 10; j++)
+				jobsystem.submit([&counter]() { counter++; });
+			counter++;
+		});
+	}
+	jobsystem.wait();
+	assert(counter == 550);
+}
+
+//Resizing the job system
+void test3()
+{
+	jobs::JobSystem jobsystem(1);
+	assert(jobsystem.threadCount() == 1);
+	std::atomic<int> counter(0);
+	for(int i = 0; i < 100; i++)
+		jobsystem.submit([&counter]() { counter++; });
+	jobsystem.resize(6);
+	assert(counter == 100);
+	assert(jobsystem.threadCount() == 6);
+	for(int i = 0; i < 100; i++)
+		jobsystem.submit([&counter]() { counter++; });
+	jobsystem.wait();
+	assert(counter == 200);
+}
+
+//Every index should be covered by exactly one range
+void test4()
+{
+	jobs::JobSystem jobsystem(4);
+	for(size_t count : { 0, 1, 63, 64, 65, 1000, 4097 }) {
+		std::vector<int> visited(count, 0);
+		jobsystem.parallelFor(count, 64, [&visited](size_t begin, size_t end) {
+			assert(end - begin <= 64);
+			for(size_t i = begin; i < end; i++)
+				visited[i]++;
+		});
+		for(size_t i = 0; i < count; i++)
+			assert(visited[i] == 1);
+	}
+}
+
+int main()
+{
+	TEST(test1());
+	TEST(test2());
+	TEST(test3());
+	TEST(test4());
+}
@@ -0,0 +1,91 @@
+#include "../src/gfx.hpp"
+#include "test.h"
+
+const char path[] = "modelcache_test";
+
+mesh::Model makeModel(unsigned int n)
+{
+	mesh::Model model;
+	for(unsigned int i = 0; i < n; i++) {
+		model.vertices.push_back(glm::vec3(float(i), float(i) * 2.0f, -float(i)));
+		model.normals.push_back(glm::vec3(0.0f, 1.0f, float(i)));
+		model.texturecoords.push_back(glm::vec2(float(i) * 0.5f, 1.0f));
+		model.indices.push_back(n - i - 1);
+	}
+	return model;
+}
+
+bool sameModel(const mesh::Model &a, const mesh::Model &b)
+{
+	if(
+		a.vertices.size() != b.vertices.size() ||
+		a.normals.size() != b.normals.size() ||
+		a.texturecoords.size() != b.texturecoords.size() ||
+		a.indices != b.indices
+	)
+		return false;
+	for(size_t i = 0; i < a.vertices.size(); i++) {
+		if(
+			!(a.vertices[i] == b.vertices[i]) ||
+			!(a.normals[i] == b.normals[i]) ||
+			!(a.texturecoords[i] == b.texturecoords[i])
+		)
+			return false;
+	}
+	return true;
+}
+
+//Models should be the same after being written and read back
+void test1()
+{
+	remove(path);
+	mesh::Model model;
+	{
+		mesh::ModelCache cache(path);
+		assert(!cache.get(1, model));
+		cache.add(1, makeModel(10));
+		cache.add(2, makeModel(3));
+		assert(cache.get(1, model) && sameModel(model, makeModel(10)));
+		assert(cache.save());
+		assert(cache.get(2, model) && sameModel(model, makeModel(3)));
+	}
+
+	mesh::ModelCache cache(path);
+	assert(cache.get(1, model) && sameModel(model, makeModel(10)));
+	assert(cache.get(2, model) && sameModel(model, makeModel(3)));
+	assert(!cache.get(3, model));
+	//Replace one model and add another
+	cache.add(2, makeModel(5));
+	cache.add(3, makeModel(0));
+	assert(cache.save());
+
+	mesh::ModelCache reopened(path);
+	assert(reopened.get(1, model) && sameModel(model, makeModel(10)));
+	assert(reopened.get(2, model) && sameModel(model, makeModel(5)));
+	assert(reopened.get(3, model) && sameModel(model, makeModel(0)));
+	remove(path);
+}
+
+//A file that is not a valid cache should be ignored
+void test2()
+{
+	FILE *f = fopen(path, "wb");
+	const char garbage[] = "this is not a model cache, it is just some text";
+	fwrite(garbage, 1, sizeof(garbage), f);
+	fclose(f);
+
+	mesh::Model model;
+	mesh::ModelCache cache(path);
+	assert(!cache.get(0, model));
+	cache.add(7, makeModel(4));
+	assert(cache.save());
+	mesh::ModelCache reopened(path);
+	assert(reopened.get(7, model) && sameModel(model, makeModel(4)));
+	remove(path);
+}
+
+int main()
+{
+	TEST(test1());
+	TEST(test2());
+}
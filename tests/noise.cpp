@@ -0,0 +1,119 @@
+#include "../src/noise.hpp"
+#include "test.h"
+#include <random>
+#include <string.h>
+#include <math.h>
+
+//Checks that the batched noise function gives exactly the same result as the
+//scalar version for the points passed in
+void checkBatch(const float *x, const float *y, size_t count, int seed)
+{
+	rng::permutation256 p;
+	rng::createPermutation(p, seed);
+
+	float *batch = new float[count];
+	perlin::noise(x, y, batch, count, p);
+	for(size_t i = 0; i < count; i++) {
+		float expected = perlin::noise(x[i], y[i], p);
+		assert(memcmp(&expected, &batch[i], sizeof(float)) == 0);
+	}
+	delete[] batch;
+}
+
+//Random points
+void test1()
+{
+	const size_t COUNT = 1000;
+	float x[COUNT], y[COUNT];
+	std::minstd_rand lcg(1);
+	std::uniform_real_distribution<float> dist(-1000.0f, 1000.0f);
+	for(size_t i = 0; i < COUNT; i++) {
+		x[i] = dist(lcg);
+		y[i] = dist(lcg);
+	}
+	checkBatch(x, y, COUNT, 1);
+	checkBatch(x, y, COUNT, 42);
+}
+
+//Rows of closely spaced points (like the ones used when building a chunk),
+//this also checks lengths that do not fill up a whole SIMD register
+void test2()
+{
+	const size_t COUNT = 41;
+	float x[COUNT], y[COUNT];
+	for(int row = -5; row <= 5; row++) {
+		for(size_t i = 0; i < COUNT; i++) {
+			x[i] = float(row) * 0.37f;
+			y[i] = -3.0f + float(i) / 40.0f * 6.0f;
+		}
+		for(size_t len = 0; len <= COUNT; len++)
+			checkBatch(x, y, len, row);
+	}
+}
+
+//Points exactly on lattice lines
+void test3()
+{
+	const size_t COUNT = 16;
+	float x[COUNT], y[COUNT];
+	for(size_t i = 0; i < COUNT; i++) {
+		x[i] = float(i) - 8.0f;
+		y[i] = float(i % 4) - 2.0f;
+	}
+	checkBatch(x, y, COUNT, 7);
+}
+
+//Analytic derivatives should match a finite difference approximation and
+//the value should be the same as the one returned by noise()
+void test4()
+{
+	rng::permutation256 p;
+	rng::createPermutation(p, 3);
+
+	std::minstd_rand lcg(3);
+	std::uniform_real_distribution<float> dist(-100.0f, 100.0f);
+	const float h = 1.0f / 512.0f;
+	for(int i = 0; i < 1000; i++) {
+		float x = dist(lcg), y = dist(lcg);
+		glm::vec3 n = perlin::noiseWithDerivative(x, y, p);
+		float value = perlin::noise(x, y, p);
+		assert(memcmp(&value, &n.x, sizeof(float)) == 0);
+
+		float
+			dx = (perlin::noise(x + h, y, p) - perlin::noise(x - h, y, p)) / (2.0f * h),
+			dy = (perlin::noise(x, y + h, p) - perlin::noise(x, y - h, p)) / (2.0f * h);
+		assert(fabsf(dx - n.y) < 0.01f);
+		assert(fabsf(dy - n.z) < 0.01f);
+	}
+}
+
+//Batched derivatives should be the same as the scalar ones
+void test5()
+{
+	rng::permutation256 p;
+	rng::createPermutation(p, 5);
+
+	const size_t COUNT = 203;
+	float x[COUNT], y[COUNT], value[COUNT], dx[COUNT], dy[COUNT];
+	for(size_t i = 0; i < COUNT; i++) {
+		x[i] = 12.5f + float(i) * 0.013f;
+		y[i] = -7.25f - float(i % 17) * 0.21f;
+	}
+
+	perlin::noiseWithDerivative(x, y, value, dx, dy, COUNT, p);
+	for(size_t i = 0; i < COUNT; i++) {
+		glm::vec3 n = perlin::noiseWithDerivative(x[i], y[i], p);
+		assert(memcmp(&n.x, &value[i], sizeof(float)) == 0);
+		assert(memcmp(&n.y, &dx[i], sizeof(float)) == 0);
+		assert(memcmp(&n.z, &dy[i], sizeof(float)) == 0);
+	}
+}
+
+int main()
+{
+	TEST(test1());
+	TEST(test2());
+	TEST(test3());
+	TEST(test4());
+	TEST(test5());
+}